@@ -0,0 +1,113 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd
+ * bench.c - Times libreadexe over a set of files
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Parses every file the way readexe does with nothing selected away
+ * (every NE table, every LE and PE table loaded) but prints nothing, on
+ * one thread so that the numbers are per file rather than per core.
+ * Allocations and system calls are the library's own counts; see
+ * map_file() for what is counted.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <err.h> /* -I. or such for platforms without err.h */
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "readexe.h"
+
+static double now(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_MONOTONIC, &ts)) return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+    return (double) time(NULL);
+}
+
+static void display_help(void) {
+    printf(
+        "readexe-bench: Times libreadexe over a set of files.\n\n"
+        "  Usage: readexe-bench [-n iterations] EXEFILE.EXE...\n\n"
+        "  -n\tParse every file this many times (default 1).\n"
+        "  -h\tDisplay this help.\n"
+    );
+    exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    struct THIS *this;
+    unsigned long files = 0, failed = 0, allocs = 0, syscalls = 0, kinds[EXE_KIND_COUNT] = { 0 };
+    double bytes = 0, start, secs;
+    int option, iterations = 1, n, i;
+
+#ifdef NEED_ERR
+    setprogname(argv[0]);
+#endif
+    while ((option = getopt(argc, argv, "hn:")) != -1) {
+        switch (option) {
+            case 'n':
+                if ((iterations = atoi(optarg)) < 1) errx(1, "Invalid iteration count: %s", optarg);
+                break;
+            default:
+                display_help();
+        }
+    }
+    if (optind >= argc) display_help();
+
+    start = now();
+    for (n = 0; n < iterations; n++) {
+        for (i = optind; i < argc; i++) {
+            if (!(this = init_this())) errx(1, "Cannot allocate memory");
+            this->fname = argv[i];
+            if (map_file(this)) {
+                failed++;
+            } else {
+                read_exe(this);
+                if (this->le) le_load(this, ~0U);
+                if (this->pe) pe_load(this, ~0U);
+                bytes += this->size;
+                kinds[this->kind]++;
+                unmap_file(this);
+            }
+            files++;
+            allocs += this->arena.allocs;
+            syscalls += this->syscalls;
+            destroy_this(this);
+        }
+    }
+    secs = now() - start;
+    if (secs <= 0) secs = 1e-9;
+
+    printf("files:          %lu (%lu MZ, %lu NE, %lu LE, %lu LX, %lu W3, %lu PE, %lu other, %lu unreadable)\n",
+        files, kinds[EXE_MZ], kinds[EXE_NE], kinds[EXE_LE], kinds[EXE_LX], kinds[EXE_W3], kinds[EXE_PE], kinds[EXE_UNKNOWN], failed);
+    printf("bytes:          %.0f\n", bytes);
+    printf("seconds:        %.3f\n", secs);
+    printf("files/sec:      %.1f\n", files / secs);
+    printf("MB/sec:         %.1f\n", bytes / (1024.0 * 1024.0) / secs);
+    if (files) {
+        printf("allocs/file:    %.2f\n", (double) allocs / files);
+        printf("syscalls/file:  %.2f\n", (double) syscalls / files);
+    }
+    return failed ? 1 : 0;
+}
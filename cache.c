@@ -0,0 +1,465 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd
+ * cache.c - On-disk cache of reports for files that have not changed
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * A file is looked up by a stat() alone: if its device, inode, size and
+ * modification time match an entry, the stored report is used and the
+ * file is never opened. The one hole in that is a file changed again in
+ * the same second it was cached, which leaves its mtime alone; such
+ * entries are marked racy when stored and have their fingerprint checked
+ * as well.
+ *
+ * The cache is read-only while a run is going, so any number of threads
+ * and processes can search it at once. New reports are kept per worker
+ * and written out at the end, merged with the old entries, to a new file
+ * that is renamed over the old one. Old entries for files that are gone,
+ * or whose name now leads to another file, are dropped then, so the cache
+ * does not outgrow the files it covers. Readers that still have the old
+ * file open keep seeing it whole; of two runs finishing at once, the last
+ * rename wins.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* Map the cache where we can, as libreadexe does with executables. */
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# define USE_MMAP
+#elif !defined(HAVE_CONFIG_H) && (defined(__unix__) || defined(__APPLE__))
+# define USE_MMAP
+#endif
+
+#ifdef USE_MMAP
+# include <fcntl.h>
+# include <sys/mman.h>
+#endif
+
+#include "cache.h"
+
+#define CACHE_FNV_OFFSET    UINT64_C(0xcbf29ce484222325)
+#define CACHE_FNV_PRIME     UINT64_C(0x100000001b3)
+#define CACHE_FP_SPAN       4096            /* bytes fingerprinted at each end of a file */
+
+/* Reports made by one worker during this run */
+struct cache_worker {
+    struct cache_entry *entries;
+    int count;
+    int cap;
+    char *data;
+    size_t len;
+    size_t cap_data;
+    unsigned long hits;
+};
+
+struct cache {
+    char *path;
+    uint64_t optkey;
+    const uint8_t *base;                    /* the cache file as it was when opened */
+    size_t size;
+    int mapped;
+    const struct cache_entry *index;        /* NULL if there was no usable cache */
+    uint32_t count;
+    uint64_t dataOffset;
+    struct cache_worker *workers;
+    int nworkers;
+};
+
+/* A new entry and where its report is, while writing the cache out */
+struct cache_new {
+    struct cache_entry entry;
+    const char *data;
+};
+
+/* FNV-1a; start with h = 0 for a fresh hash. */
+uint64_t cache_hash(uint64_t h, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    if (!h) h = CACHE_FNV_OFFSET;
+    while (len--) h = (h ^ *p++) * CACHE_FNV_PRIME;
+    return h;
+}
+
+/* The fingerprint of a file already in memory, the same as cache_fingerprint() would make of it */
+static uint64_t cache_fingerprint_image(const uint8_t *p, uint64_t size) {
+    uint64_t h = cache_hash(0, &size, sizeof(size));
+    size_t n;
+
+    h = cache_hash(h, p, size < CACHE_FP_SPAN ? (size_t) size : CACHE_FP_SPAN);
+    if (size > CACHE_FP_SPAN) {
+        n = size - CACHE_FP_SPAN < CACHE_FP_SPAN ? (size_t) (size - CACHE_FP_SPAN) : CACHE_FP_SPAN;
+        h = cache_hash(h, p + size - n, n);
+    }
+    return h;
+}
+
+static uint64_t cache_fingerprint(const char *fname, uint64_t size) {
+    uint8_t buf[CACHE_FP_SPAN];
+    uint64_t h = cache_hash(0, &size, sizeof(size));
+    size_t n;
+    FILE *fp;
+
+    if (!(fp = fopen(fname, "rb"))) return 0;
+    n = fread(buf, 1, sizeof(buf), fp);
+    h = cache_hash(h, buf, n);
+    if (size > CACHE_FP_SPAN) {
+        n = size - CACHE_FP_SPAN < CACHE_FP_SPAN ? (size_t) (size - CACHE_FP_SPAN) : CACHE_FP_SPAN;
+        if (!fseek(fp, -(long) n, SEEK_END)) h = cache_hash(h, buf, fread(buf, 1, n, fp));
+    }
+    fclose(fp);
+    return h;
+}
+
+static int cache_compare(const struct cache_entry *a, const struct cache_entry *b) {
+    if (a->dev != b->dev) return a->dev < b->dev ? -1 : 1;
+    if (a->ino != b->ino) return a->ino < b->ino ? -1 : 1;
+    if (a->path != b->path) return a->path < b->path ? -1 : 1;
+    return 0;
+}
+
+static int compare_new(const void *a, const void *b) {
+    return cache_compare(&((const struct cache_new *) a)->entry, &((const struct cache_new *) b)->entry);
+}
+
+/* Whether the name and report of an entry of the mapped index lie inside the file */
+static int cache_entry_fits(const struct cache *c, const struct cache_entry *e) {
+    uint64_t room = c->size - c->dataOffset;
+
+    return e->offset <= room && e->nameLength <= room - e->offset && e->length <= room - e->offset - e->nameLength;
+}
+
+/*
+ * Whether an old entry still stands for a file: its name can be stat()ed
+ * and leads to the same device and inode. Entries that do not are left
+ * out when the cache is written.
+ */
+static int cache_entry_live(const struct cache *c, const struct cache_entry *e) {
+    struct stat st;
+    char *name;
+    int live;
+
+    if (!cache_entry_fits(c, e) || !(name = malloc(e->nameLength + 1))) return 0;
+    memcpy(name, c->base + c->dataOffset + e->offset, e->nameLength);
+    name[e->nameLength] = '\0';
+    live = !stat(name, &st) && (uint64_t) st.st_dev == e->dev && (uint64_t) st.st_ino == e->ino;
+    free(name);
+    return live;
+}
+
+/* Reads the cache at c->path into c->base; a missing cache is an empty one. */
+static void cache_map(struct cache *c) {
+#ifdef USE_MMAP
+    struct stat st;
+    void *p;
+    int fd;
+
+    if ((fd = open(c->path, O_RDONLY)) == -1) return;
+    if (!fstat(fd, &st) && st.st_size > 0 && (uintmax_t) st.st_size <= SIZE_MAX
+        && (p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED) {
+        c->base = p;
+        c->size = (size_t) st.st_size;
+        c->mapped = 1;
+    }
+    close(fd);
+#else
+    FILE *fp;
+    uint8_t *buf;
+    long len;
+
+    if (!(fp = fopen(c->path, "rb"))) return;
+    if (!fseek(fp, 0, SEEK_END) && (len = ftell(fp)) > 0 && !fseek(fp, 0, SEEK_SET) && (buf = malloc((size_t) len))) {
+        if (fread(buf, 1, (size_t) len, fp) == (size_t) len) {
+            c->base = buf;
+            c->size = (size_t) len;
+        } else free(buf);
+    }
+    fclose(fp);
+#endif
+}
+
+static void cache_unmap(struct cache *c) {
+#ifdef USE_MMAP
+    if (c->mapped) munmap((void *) c->base, c->size);
+#endif
+    if (!c->mapped) free((void *) c->base);
+    c->base = NULL;
+    c->size = 0;
+    c->mapped = 0;
+    c->index = NULL;
+    c->count = 0;
+}
+
+/*
+ * Opens the cache at path for a run whose reports are described by
+ * optkey. A cache made with other options or by another version, or one
+ * that is damaged, is treated as empty and replaced when the run ends.
+ * Returns NULL if out of memory.
+ */
+struct cache *cache_open(const char *path, uint64_t optkey, int nworkers) {
+    const struct cache_header *h;
+    struct cache *c;
+
+    if (!(c = calloc(1, sizeof(struct cache)))
+        || !(c->workers = calloc(nworkers, sizeof(struct cache_worker)))
+        || !(c->path = malloc(strlen(path) + 1))) {
+        if (c) free(c->workers);
+        free(c);
+        return NULL;
+    }
+    strcpy(c->path, path);
+    c->optkey = optkey;
+    c->nworkers = nworkers;
+    cache_map(c);
+    h = (const struct cache_header *) c->base;
+    if (c->size >= sizeof(struct cache_header) && !memcmp(h->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC))
+        && h->version == CACHE_VERSION && h->optkey == optkey && h->fileSize == c->size
+        && h->count <= (c->size - sizeof(struct cache_header)) / sizeof(struct cache_entry)
+        && h->dataOffset >= sizeof(struct cache_header) + (uint64_t) h->count * sizeof(struct cache_entry)
+        && h->dataOffset <= c->size) {
+        c->index = (const struct cache_entry *) (c->base + sizeof(struct cache_header));
+        c->count = h->count;
+        c->dataOffset = h->dataOffset;
+    } else cache_unmap(c);
+    return c;
+}
+
+/*
+ * Looks fname up by stat() alone (plus the fingerprint for racy entries).
+ * Returns the stored report and sets *len and *kind, or returns NULL with
+ * probe filled in for cache_store().
+ */
+const char *cache_lookup(struct cache *c, int worker, const char *fname, struct cache_probe *probe, size_t *len, int *kind) {
+    const struct cache_entry *e = NULL;
+    struct stat st;
+    uint32_t lo = 0, hi = c->count, mid;
+    int cmp;
+
+    memset(probe, 0, sizeof(*probe));
+    probe->when = (int64_t) time(NULL);
+    if (stat(fname, &st)) return NULL;
+    probe->key.dev = (uint64_t) st.st_dev;
+    probe->key.ino = (uint64_t) st.st_ino;
+    probe->key.path = cache_hash(0, fname, strlen(fname));
+    probe->key.size = (uint64_t) st.st_size;
+    probe->key.mtime = (int64_t) st.st_mtime;
+    probe->valid = 1;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (!(cmp = cache_compare(&probe->key, &c->index[mid]))) {
+            e = &c->index[mid];
+            break;
+        }
+        if (cmp < 0) hi = mid; else lo = mid + 1;
+    }
+    if (!e || e->size != probe->key.size || e->mtime != probe->key.mtime) return NULL;
+    if (!cache_entry_fits(c, e)) return NULL;
+    if ((e->flags & CACHE_RACY) && cache_fingerprint(fname, e->size) != e->fingerprint) return NULL;
+    c->workers[worker].hits++;
+    *len = e->length;
+    *kind = e->kind;
+    return (const char *) c->base + c->dataOffset + e->offset + e->nameLength;
+}
+
+/*
+ * Keeps report for the file cache_lookup() could not find, to be written
+ * out by cache_close(). image is the file as it was read, size bytes,
+ * which racy entries are fingerprinted from; if it is not all there, a
+ * racy file is not cached.
+ */
+void cache_store(struct cache *c, int worker, const char *fname, struct cache_probe *probe, const void *image, size_t size, const char *report, size_t len, int kind) {
+    struct cache_worker *w = &c->workers[worker];
+    struct cache_entry *e, *entries;
+    char *data;
+    size_t cap, namelen = strlen(fname);
+    int racy = probe->key.mtime >= probe->when;
+
+    if (!probe->valid || len > UINT32_MAX || namelen > UINT32_MAX) return;
+    if (racy && (!image || size != probe->key.size)) return;
+    /* Out of memory just means the file is not cached this time. */
+    if (w->count == w->cap) {
+        if (!(entries = realloc(w->entries, sizeof(struct cache_entry) * (w->cap ? w->cap * 2 : 64)))) return;
+        w->entries = entries;
+        w->cap = w->cap ? w->cap * 2 : 64;
+    }
+    if (w->len + namelen + len > w->cap_data) {
+        for (cap = w->cap_data ? w->cap_data : 65536; w->len + namelen + len > cap; cap *= 2);
+        if (!(data = realloc(w->data, cap))) return;
+        w->data = data;
+        w->cap_data = cap;
+    }
+    e = &w->entries[w->count++];
+    *e = probe->key;
+    e->fingerprint = racy ? cache_fingerprint_image(image, e->size) : 0;
+    e->offset = w->len;
+    e->length = (uint32_t) len;
+    e->kind = (uint16_t) kind;
+    e->flags = racy ? CACHE_RACY : 0;
+    e->nameLength = (uint32_t) namelen;
+    e->reserved = 0;
+    memcpy(w->data + w->len, fname, namelen);
+    memcpy(w->data + w->len + namelen, report, len);
+    w->len += namelen + len;
+}
+
+void cache_counts(struct cache *c, unsigned long *hits, unsigned long *stored) {
+    int i;
+
+    *hits = *stored = 0;
+    for (i = 0; i < c->nworkers; i++) {
+        *hits += c->workers[i].hits;
+        *stored += c->workers[i].count;
+    }
+}
+
+/*
+ * Writes the merged cache to a new file and renames it into place, less
+ * the old entries cache_entry_live() gives up on. Returns 0 or -1 with
+ * errno set.
+ */
+static int cache_write(struct cache *c, struct cache_new *news, int nnew) {
+    struct cache_header h;
+    struct cache_entry e;
+    char *tmp;
+    uint8_t *live;
+    FILE *fp;
+    uint64_t offset = 0;
+    uint32_t i;
+    int j, pass, saved;
+
+    if (!(live = malloc(c->count + 1))) return -1;
+    for (i = 0; i < c->count; i++)
+        live[i] = (uint8_t) cache_entry_live(c, &c->index[i]);
+    if (!(tmp = malloc(strlen(c->path) + 32))) {
+        free(live);
+        return -1;
+    }
+    sprintf(tmp, "%s.%ld.tmp", c->path, (long) getpid());
+    if (!(fp = fopen(tmp, "wb"))) {
+        free(live);
+        free(tmp);
+        return -1;
+    }
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    h.version = CACHE_VERSION;
+    h.optkey = c->optkey;
+    fwrite(&h, sizeof(h), 1, fp);
+
+    /* Two merges of the old index with the new entries: the first writes the index, the second the reports. */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0, j = 0; i < c->count || j < nnew; ) {
+            if (j < nnew && (i == c->count || cache_compare(&news[j].entry, &c->index[i]) <= 0)) {
+                if (i < c->count && !cache_compare(&news[j].entry, &c->index[i])) i++;
+                e = news[j].entry;
+                if (pass) fwrite(news[j].data, 1, (size_t) e.nameLength + e.length, fp);
+                j++;
+            } else if (!live[i]) {
+                i++;
+                continue;
+            } else {
+                e = c->index[i];
+                if (pass) fwrite(c->base + c->dataOffset + e.offset, 1, (size_t) e.nameLength + e.length, fp);
+                i++;
+            }
+            if (!pass) {
+                e.offset = offset;
+                offset += (uint64_t) e.nameLength + e.length;
+                fwrite(&e, sizeof(e), 1, fp);
+                h.count++;
+            }
+        }
+        if (!pass) h.dataOffset = sizeof(h) + (uint64_t) h.count * sizeof(e);
+    }
+    free(live);
+    h.fileSize = h.dataOffset + offset;
+    if (fseek(fp, 0, SEEK_SET) || fwrite(&h, sizeof(h), 1, fp) != 1 || ferror(fp)) {
+        saved = errno;
+        fclose(fp);
+        remove(tmp);
+        free(tmp);
+        errno = saved;
+        return -1;
+    }
+    if (fclose(fp)) {
+        saved = errno;
+        remove(tmp);
+        free(tmp);
+        errno = saved;
+        return -1;
+    }
+    /* Some systems will not rename over an existing file. */
+    if (rename(tmp, c->path) && (remove(c->path) || rename(tmp, c->path))) {
+        saved = errno;
+        remove(tmp);
+        free(tmp);
+        errno = saved;
+        return -1;
+    }
+    free(tmp);
+    return 0;
+}
+
+/* Writes out the reports stored during the run, if any, and frees c. Returns 0 or -1 with errno set. */
+int cache_close(struct cache *c) {
+    struct cache_new *news = NULL;
+    struct cache_worker *w;
+    unsigned long hits, stored;
+    int i, j, n = 0, ret = 0;
+
+    cache_counts(c, &hits, &stored);
+    if (stored && (news = malloc(sizeof(struct cache_new) * stored))) {
+        for (i = 0; i < c->nworkers; i++) {
+            w = &c->workers[i];
+            for (j = 0; j < w->count; j++) {
+                news[n].entry = w->entries[j];
+                news[n].data = w->data + w->entries[j].offset;
+                n++;
+            }
+        }
+        /* The same file given twice is stored twice; keep one. */
+        qsort(news, n, sizeof(struct cache_new), compare_new);
+        for (i = j = 0; i < n; i++) {
+            if (j && !compare_new(&news[j - 1], &news[i])) j--;
+            news[j++] = news[i];
+        }
+        ret = cache_write(c, news, j);
+    } else if (stored) {
+        errno = ENOMEM;
+        ret = -1;
+    }
+    free(news);
+    cache_unmap(c);
+    for (i = 0; i < c->nworkers; i++) {
+        free(c->workers[i].entries);
+        free(c->workers[i].data);
+    }
+    free(c->workers);
+    free(c->path);
+    free(c);
+    return ret;
+}
@@ -0,0 +1,75 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd
+ * cache.h - On-disk cache of reports for files that have not changed
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_MAGIC     "RXCACHE"
+#define CACHE_VERSION   2
+
+/*
+ * The cache file: a header, the index sorted by (dev, ino, path), then
+ * the reports. Everything is fixed-size and 8-byte aligned so the file
+ * can be searched straight out of an mmap(). Numbers are little-endian,
+ * as everywhere else in readexe.
+ */
+struct cache_header {
+    char        magic[8];                   /* CACHE_MAGIC */
+    uint32_t    version;                    /* CACHE_VERSION */
+    uint32_t    count;                      /* index entries */
+    uint64_t    optkey;                     /* readexe version and the options the reports were made with */
+    uint64_t    dataOffset;                 /* reports, from the start of the file */
+    uint64_t    fileSize;                   /* to catch a cache cut short */
+};
+
+struct cache_entry {
+    uint64_t    dev;
+    uint64_t    ino;
+    uint64_t    path;                       /* hash of the name the file was scanned as; reports include it */
+    uint64_t    size;
+    int64_t     mtime;
+    uint64_t    fingerprint;                /* racy entries: hash of the size and the first and last few K */
+    uint64_t    offset;                     /* name, then report, from dataOffset */
+    uint32_t    length;                     /* of the report */
+    uint16_t    kind;                       /* enum exe_kind */
+    uint16_t    flags;                      /* CACHE_* */
+    uint32_t    nameLength;                 /* the name the file was scanned as, to find it again when merging */
+    uint32_t    reserved;
+};
+
+#define CACHE_RACY      0x0001              /* modified within a second of being cached; check the fingerprint */
+
+/* What cache_lookup() found out about a file, for cache_store() */
+struct cache_probe {
+    struct cache_entry key;
+    int64_t when;                           /* time of the stat() */
+    int valid;                              /* the stat() worked */
+};
+
+struct cache;
+
+uint64_t cache_hash(uint64_t h, const void *data, size_t len);
+struct cache *cache_open(const char *path, uint64_t optkey, int nworkers);
+const char *cache_lookup(struct cache *c, int worker, const char *fname, struct cache_probe *probe, size_t *len, int *kind);
+void cache_store(struct cache *c, int worker, const char *fname, struct cache_probe *probe, const void *image, size_t size, const char *report, size_t len, int kind);
+void cache_counts(struct cache *c, unsigned long *hits, unsigned long *stored);
+int cache_close(struct cache *c);
+
+#endif /* CACHE_H */
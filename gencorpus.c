@@ -0,0 +1,573 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd
+ * gencorpus.c - Writes synthetic MZ, NE, LE, LX and W3 files for benchmarking
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The files are put together from the structures in mz.h, ne.h, le.h
+ * and w3.h and are meant to look like a large archive to the parsers:
+ * well-formed, with every table the parsers read, and sized by the
+ * command line. The code and data in them is all zeroes; nothing here
+ * is meant to run.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <err.h> /* -I. or such for platforms without err.h */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "mz.h"
+#include "ne.h"
+#include "le.h"
+#include "w3.h"
+
+#define GEN_MZ  0x01
+#define GEN_NE  0x02
+#define GEN_LE  0x04
+#define GEN_LX  0x08
+#define GEN_W3  0x10
+
+#define NE_SEGMENT_SIZE 0x1000
+#define LE_PAGE_SIZE    0x1000
+#define LE_PAGE_FIXUPS  (LE_PAGE_SIZE / 4)  /* as many 32-bit fixups as a page has room for */
+#define MZ_STUB_SIZE    0x80                /* MZ header, new header and a few bytes of stub */
+
+struct params {
+    int count;                              /* -c: files of each kind */
+    int relocs;                             /* -r: per MZ relocation table, NE segment and LE page */
+    int segments;                           /* -s: NE segments, LE objects */
+    int imports;                            /* -i: NE imported names, LE imported procedures */
+    int modules;                            /* -m: NE/LE module references, W3 VxDs */
+    unsigned kinds;                         /* -k: GEN_* */
+};
+
+/* A file under construction */
+struct gbuf {
+    uint8_t *p;
+    size_t len;
+    size_t cap;
+};
+
+static uint32_t seed = 0x2545F491;
+
+/* xorshift32; the corpus is the same on every run. */
+static uint32_t rnd(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* Appends n zero bytes and returns their offset. */
+static size_t gb_grow(struct gbuf *b, size_t n) {
+    size_t at = b->len;
+
+    if (b->len + n > b->cap) {
+        while (b->len + n > b->cap) b->cap = b->cap ? b->cap * 2 : 65536;
+        if (!(b->p = realloc(b->p, b->cap))) err(1, "Cannot allocate memory");
+    }
+    memset(b->p + at, 0, n);
+    b->len += n;
+    return at;
+}
+
+static size_t gb_put(struct gbuf *b, const void *data, size_t n) {
+    size_t at = gb_grow(b, n);
+
+    memcpy(b->p + at, data, n);
+    return at;
+}
+
+static void gb_u8(struct gbuf *b, uint8_t v) { gb_put(b, &v, 1); }
+static void gb_u16(struct gbuf *b, uint16_t v) { gb_put(b, &v, 2); }
+static void gb_u32(struct gbuf *b, uint32_t v) { gb_put(b, &v, 4); }
+
+static void gb_align(struct gbuf *b, size_t a) {
+    if (b->len % a) gb_grow(b, a - b->len % a);
+}
+
+/* Length-prefixed name, as used by every NE and LE name table */
+static size_t gb_name(struct gbuf *b, const char *name) {
+    size_t at = b->len;
+
+    gb_u8(b, (uint8_t) strlen(name));
+    gb_put(b, name, strlen(name));
+    return at;
+}
+
+static const char *module_name(int i, char *buf) {
+    static const char *known[] = { "KERNEL", "USER", "GDI", "KEYBOARD", "SOUND", "SHELL", "COMMDLG", "WIN87EM" };
+
+    if (i < (int) (sizeof(known) / sizeof(known[0]))) return known[i];
+    sprintf(buf, "MOD%04d", i);
+    return buf;
+}
+
+/* The DOS header that every file starts with; next is the e_lfanew value, or 0 for a plain DOS program. */
+static void put_mz_stub(struct gbuf *b, uint32_t next) {
+    struct exe_mz_header mz;
+    struct exe_mz_new_header mzx;
+
+    memset(&mz, 0, sizeof(mz));
+    memcpy(mz.magic, "MZ", 2);
+    mz.pageCount = 1;
+    mz.lastPageSize = MZ_STUB_SIZE;
+    mz.hdrSize = 4;
+    mz.maxMemory = 0xFFFF;
+    mz.stackPointer = 0xB8;
+    mz.relocationOffset = 0x40;
+    gb_put(b, &mz, sizeof(mz));
+    memset(&mzx, 0, sizeof(mzx));
+    mzx.nextHeader = next;
+    gb_put(b, &mzx, sizeof(mzx));
+    gb_grow(b, MZ_STUB_SIZE - b->len);
+}
+
+/*
+ * A DOS program with a large relocation table. The header is padded to a
+ * page and the full last page is given as 512, not 0, as some linkers
+ * write it; the table starts with two entries that overlap by a byte,
+ * listed high address first, so only applying them in table order gives
+ * the image DOS loads.
+ */
+static void gen_mz(struct gbuf *b, const struct params *pr) {
+    struct exe_mz_header mz;
+    struct exe_mz_reloc r;
+    uint32_t hdr, image, total, linear;
+    int i, count = pr->relocs > 0xFFFF ? 0xFFFF : pr->relocs;
+
+    hdr = (sizeof(mz) + 4 * (uint32_t) count + 511) & ~511U;
+    image = 0x10000;
+    total = hdr + image;
+    memset(&mz, 0, sizeof(mz));
+    memcpy(mz.magic, "MZ", 2);
+    mz.pageCount = total / 512;
+    mz.lastPageSize = 512;
+    mz.relocationEntries = count;
+    mz.hdrSize = hdr / 16;
+    mz.minMemory = 0x100;
+    mz.maxMemory = 0xFFFF;
+    mz.stackSegment = 0x1000;
+    mz.stackPointer = 0x100;
+    mz.relocationOffset = sizeof(mz);
+    gb_put(b, &mz, sizeof(mz));
+    for (i = 0; i < count; i++) {
+        linear = i < 2 ? 0x101 - (uint32_t) i : rnd() % (image - 2);
+        r.segment = (linear >> 4) & ~0xFU;
+        r.offset = linear - ((uint32_t) r.segment << 4);
+        gb_put(b, &r, sizeof(r));
+    }
+    gb_grow(b, hdr + image - b->len);
+    /* Words whose sum depends on the order the overlapping pair is applied in */
+    b->p[hdr + 0x100] = 0xFF;
+    b->p[hdr + 0x101] = 0xFF;
+    b->p[hdr + 0x102] = 0x00;
+}
+
+/*
+ * A Windows 3.x program: segment table, resident names, module
+ * references, imported names, an empty entry table, non-resident names
+ * and the segments, each followed by its relocations. Imports are named
+ * until the imported names table would outgrow its 16-bit offsets.
+ */
+static void gen_ne(struct gbuf *b, const struct params *pr, int index) {
+    struct exe_ne_header ne;
+    struct exe_ne_segment seg;
+    struct exe_ne_reloc r;
+    size_t nehdr, segtab, p;
+    uint16_t *modoffs, *impoffs;
+    char name[32];
+    int i, j, nimps, nsegs = pr->segments ? pr->segments : 1, nrel;
+    uint32_t type;
+
+    put_mz_stub(b, MZ_STUB_SIZE);
+    nehdr = gb_grow(b, sizeof(ne));
+    memset(&ne, 0, sizeof(ne));
+    memcpy(ne.magic, "NE", 2);
+    ne.linkerMajor = 5;
+    ne.linkerMinor = 10;
+    ne.progFlags = DATA_MULTIPLEDATA;
+    ne.appFlags = APP_WINPM;
+    ne.executable = 1;
+    ne.autoDataSegAddr = nsegs > 1 ? 2 : 0;
+    ne.initHeapSize = 0x400;
+    ne.initStackSize = 0x2000;
+    ne.entryPoint = (uint32_t) 1 << 16;
+    ne.initStackPtr = (uint32_t) (nsegs > 1 ? 2 : 1) << 16;
+    ne.segmentCount = nsegs;
+    ne.modRefCount = pr->modules;
+    ne.offsetShiftCount = 4;
+    ne.targetOS = OS_WINDOWS;
+    ne.windowsVersion = 0x030A;
+
+    ne.segmentTableOffset = b->len - nehdr;
+    segtab = gb_grow(b, sizeof(seg) * nsegs);
+    ne.resourceTableOffset = ne.residentNamesTableOffset = b->len - nehdr;
+    sprintf(name, "SYNTH%04d", index);
+    gb_name(b, name);
+    gb_u16(b, 0);
+    gb_u8(b, 0);
+
+    ne.modulesTableOffset = b->len - nehdr;
+    gb_grow(b, sizeof(uint16_t) * pr->modules);
+    ne.importedNamesTableOffset = b->len - nehdr;
+    if (!(modoffs = malloc(sizeof(uint16_t) * (pr->modules + 1)))
+        || !(impoffs = malloc(sizeof(uint16_t) * (pr->imports + 1)))) err(1, "Cannot allocate memory");
+    gb_u8(b, 0);
+    for (i = 0; i < pr->modules; i++) {
+        modoffs[i] = gb_name(b, module_name(i, name)) - (nehdr + ne.importedNamesTableOffset);
+        memcpy(b->p + nehdr + ne.modulesTableOffset + 2 * i, &modoffs[i], 2);
+    }
+    for (nimps = 0; nimps < pr->imports && b->len - nehdr < 0xFF00; nimps++) {
+        sprintf(name, "ImportedFunction%d", nimps);
+        impoffs[nimps] = gb_name(b, name) - (nehdr + ne.importedNamesTableOffset);
+    }
+    ne.entryTableOffset = b->len - nehdr;
+    gb_u8(b, 0);
+    ne.entryTableSize = 1;
+    ne.nonResidentTableOffset = b->len;
+    sprintf(name, "Synthetic program %d", index);
+    p = b->len;
+    gb_name(b, name);
+    gb_u16(b, 0);
+    gb_u8(b, 0);
+    ne.nonResidentTableSize = b->len - p;
+    memcpy(b->p + nehdr, &ne, sizeof(ne));
+
+    nrel = pr->relocs > 0xFFFF ? 0xFFFF : pr->relocs;
+    for (i = 0; i < nsegs; i++) {
+        gb_align(b, 1 << ne.offsetShiftCount);
+        memset(&seg, 0, sizeof(seg));
+        seg.segmentOffset = b->len >> ne.offsetShiftCount;
+        seg.segmentSize = NE_SEGMENT_SIZE;
+        seg.minimumAllocation = NE_SEGMENT_SIZE;
+        seg.segType = i > 0;
+        seg.relocatable = 1;
+        seg.preload = i < 2;
+        seg.relocations = nrel > 0;
+        memcpy(b->p + segtab + sizeof(seg) * i, &seg, sizeof(seg));
+        gb_grow(b, NE_SEGMENT_SIZE);
+        if (!nrel) continue;
+        gb_u16(b, nrel);
+        for (j = 0; j < nrel; j++) {
+            memset(&r, 0, sizeof(r));
+            r.offset = rnd() % (NE_SEGMENT_SIZE - 4);
+            type = pr->modules ? rnd() % 4 : 0;
+            if (type == 0 || (type == 3 && !nimps)) {
+                r.addressType = RADDR_OFFSET16;
+                r.relocationType = RELTYPE_INTREF | RELFLAG_ADDITIVE;
+                r.segment = 1 + rnd() % nsegs;
+                r.ordinal = rnd() % NE_SEGMENT_SIZE;
+            } else if (type == 3) {
+                r.addressType = RADDR_POINTER32;
+                r.relocationType = RELTYPE_IMPNAME | RELFLAG_ADDITIVE;
+                r.moduleReference = 1 + rnd() % pr->modules;
+                r.importNameOffset = impoffs[rnd() % nimps];
+            } else {
+                r.addressType = RADDR_POINTER32;
+                r.relocationType = RELTYPE_IMPORD | RELFLAG_ADDITIVE;
+                r.moduleReference = 1 + rnd() % pr->modules;
+                r.importOrdinal = 1 + rnd() % 600;
+            }
+            gb_put(b, &r, sizeof(r));
+        }
+    }
+    free(modoffs);
+    free(impoffs);
+}
+
+/*
+ * A linear executable at the end of b. Offsets the format counts from the
+ * start of the file are counted from rel instead, which is 0 for a file
+ * of its own and the module's offset for a VxD inside a W3 file.
+ */
+static void gen_le(struct gbuf *b, const struct params *pr, int index, int islx, size_t rel) {
+    struct exe_le_header le;
+    struct exe_le_object obj;
+    struct exe_le_page_le pgle;
+    struct exe_le_page_lx pglx;
+    size_t hdr, fixpages;
+    uint32_t *procoffs, nrec, rec;
+    char name[32];
+    int i, j, n, nobjs = pr->segments ? pr->segments : 1, nprocs, type;
+    int nfix = pr->relocs > LE_PAGE_FIXUPS ? LE_PAGE_FIXUPS : pr->relocs;
+
+    hdr = gb_grow(b, sizeof(le));
+    memset(&le, 0, sizeof(le));
+    memcpy(le.magic, islx ? "LX" : "LE", 2);
+    le.cpuType = CPU_386;
+    le.osType = islx ? LE_OS_OS2 : LE_OS_WINDOWS;
+    le.moduleType = islx ? LE_MOD_PROGRAM : LE_MOD_VDD;
+    le.pages = nobjs;
+    le.startingObject = 1;
+    le.stackObject = nobjs;
+    le.stackPointer = LE_PAGE_SIZE;
+    le.pageSize = LE_PAGE_SIZE;
+    if (islx) le.pageShift = 12; else le.lastPage = LE_PAGE_SIZE;
+    le.objectCount = nobjs;
+    le.autodataObject = nobjs;
+    le.stackSize = LE_PAGE_SIZE;
+
+    le.objectTableOffset = b->len - hdr;
+    for (i = 0; i < nobjs; i++) {
+        memset(&obj, 0, sizeof(obj));
+        obj.virtualSize = LE_PAGE_SIZE;
+        obj.relocBase = 0x10000 * (i + 1);
+        obj.flags = LE_OBJ_READABLE | LE_OBJ_BIG | (i ? LE_OBJ_WRITABLE : LE_OBJ_EXECUTABLE);
+        obj.pageMapIndex = i + 1;
+        obj.pageMapEntries = 1;
+        gb_put(b, &obj, sizeof(obj));
+    }
+    le.objectMapOffset = b->len - hdr;
+    for (i = 0; i < nobjs; i++) {
+        if (islx) {
+            pglx.dataOffset = i;
+            pglx.dataSize = LE_PAGE_SIZE;
+            pglx.flags = LE_PAGE_LEGAL;
+            gb_put(b, &pglx, sizeof(pglx));
+        } else {
+            pgle.pageNumber[0] = (i + 1) >> 16;
+            pgle.pageNumber[1] = (i + 1) >> 8;
+            pgle.pageNumber[2] = i + 1;
+            pgle.flags = LE_PAGE_LEGAL;
+            gb_put(b, &pgle, sizeof(pgle));
+        }
+    }
+    le.residentNameTableOffset = b->len - hdr;
+    sprintf(name, islx ? "SYNTH%04d" : "SYN%04d", index);
+    gb_name(b, name);
+    gb_u16(b, 0);
+    gb_u8(b, 0);
+
+    /* One exported 32-bit entry point per 16 bytes of the first object, in bundles of up to 255. */
+    le.entryTableOffset = b->len - hdr;
+    for (i = 0, n = nobjs * 16; i < n; i += j) {
+        j = n - i > 255 ? 255 : n - i;
+        gb_u8(b, j);
+        gb_u8(b, LE_BUNDLE_ENTRY32);
+        gb_u16(b, 1);
+        for (type = 0; type < j; type++) {
+            gb_u8(b, LE_ENTRY_EXPORTED);
+            gb_u32(b, (uint32_t) (i + type) * 16);
+        }
+    }
+    gb_u8(b, 0);
+    le.loaderSize = b->len - hdr - le.objectTableOffset;
+
+    /* Fixup section: page table, records, imported modules and imported procedures. */
+    nprocs = pr->imports;
+    if (!(procoffs = malloc(sizeof(uint32_t) * (nprocs + 1)))) err(1, "Cannot allocate memory");
+    le.fixupPageTableOffset = b->len - hdr;
+    fixpages = gb_grow(b, sizeof(uint32_t) * (nobjs + 1));
+    le.fixupRecordTableOffset = b->len - hdr;
+    /* Procedure name offsets are needed by the records, so lay the names out first. */
+    for (i = 0, rec = 1; i < nprocs; i++) {
+        procoffs[i] = rec;
+        rec += 1 + sprintf(name, "ImportedProcedure%d", i);
+    }
+    for (i = 0; i < nobjs; i++) {
+        nrec = b->len - hdr - le.fixupRecordTableOffset;
+        memcpy(b->p + fixpages + 4 * i, &nrec, 4);
+        for (j = 0; j < nfix; j++) {
+            type = pr->modules ? rnd() % 3 : 0;
+            if (type == 2 && !nprocs) type = 1;
+            gb_u8(b, 0x07);                 /* 32-bit offset */
+            switch (type) {
+                case 0:                     /* internal reference */
+                    gb_u8(b, 0x10);
+                    gb_u16(b, rnd() % (LE_PAGE_SIZE - 4));
+                    gb_u8(b, 1 + rnd() % nobjs);
+                    gb_u32(b, rnd() % LE_PAGE_SIZE);
+                    break;
+                case 1:                     /* import by ordinal */
+                    gb_u8(b, 0x01);
+                    gb_u16(b, rnd() % (LE_PAGE_SIZE - 4));
+                    gb_u8(b, 1 + rnd() % pr->modules);
+                    gb_u16(b, 1 + rnd() % 600);
+                    break;
+                default:                    /* import by name */
+                    gb_u8(b, 0x12);
+                    gb_u16(b, rnd() % (LE_PAGE_SIZE - 4));
+                    gb_u8(b, 1 + rnd() % pr->modules);
+                    gb_u32(b, procoffs[rnd() % nprocs]);
+                    break;
+            }
+        }
+    }
+    nrec = b->len - hdr - le.fixupRecordTableOffset;
+    memcpy(b->p + fixpages + 4 * nobjs, &nrec, 4);
+    le.importModuleNameTableOffset = b->len - hdr;
+    le.importModuleNameTableCount = pr->modules;
+    for (i = 0; i < pr->modules; i++)
+        gb_name(b, module_name(i, name));
+    le.importProcNameTableOffset = b->len - hdr;
+    gb_u8(b, 0);
+    for (i = 0; i < nprocs; i++) {
+        sprintf(name, "ImportedProcedure%d", i);
+        gb_name(b, name);
+    }
+    le.fixupSize = b->len - hdr - le.fixupPageTableOffset;
+    free(procoffs);
+
+    le.nonresidentNameTableOffset = b->len - rel;
+    sprintf(name, "Synthetic module %d", index);
+    i = b->len;
+    gb_name(b, name);
+    gb_u16(b, 0);
+    gb_u8(b, 0);
+    le.nonresidentNameTableSize = b->len - i;
+
+    gb_align(b, 16);
+    le.dataPagesOffset = b->len - rel;
+    gb_grow(b, (size_t) LE_PAGE_SIZE * nobjs);
+    memcpy(b->p + hdr, &le, sizeof(le));
+}
+
+/* A WIN386.EXE lookalike: a module table and that many LE VxDs behind it. */
+static void gen_w3(struct gbuf *b, const struct params *pr, int index) {
+    struct exe_w3_header w3;
+    struct exe_w3_modentry mod;
+    size_t hdr, modtab, start;
+    char name[16];
+    int i, n;
+
+    put_mz_stub(b, MZ_STUB_SIZE);
+    hdr = gb_grow(b, sizeof(w3));
+    memset(&w3, 0, sizeof(w3));
+    memcpy(w3.magic, "W3", 2);
+    w3.vmm_version = 0x030A;
+    w3.modcount = pr->modules;
+    memcpy(b->p + hdr, &w3, sizeof(w3));
+    modtab = gb_grow(b, sizeof(mod) * pr->modules);
+    for (i = 0; i < pr->modules; i++) {
+        gb_align(b, 16);
+        start = b->len;
+        gen_le(b, pr, index * 1000 + i, 0, start);
+        memset(&mod, ' ', sizeof(mod.name));
+        n = sprintf(name, i ? "VXD%04d" : "VMM", i);
+        memcpy(mod.name, name, n);
+        mod.offset = start;
+        mod.size = b->len - start;
+        memcpy(b->p + modtab + sizeof(mod) * i, &mod, sizeof(mod));
+    }
+}
+
+static void write_file(const char *dir, const char *name, const struct gbuf *b) {
+    char path[4096];
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (!(fp = fopen(path, "wb"))) err(1, "Cannot create %s", path);
+    if (fwrite(b->p, 1, b->len, fp) != b->len || fclose(fp)) err(1, "Cannot write %s", path);
+}
+
+static void display_help(void) {
+    printf(
+        "gencorpus: Writes synthetic MZ, NE, LE, LX and W3 files for benchmarking.\n\n"
+        "  Usage: gencorpus [-c count] [-r relocs] [-s segments] [-i imports] [-m modules] [-k kinds] DIR\n\n"
+        "  -c\tFiles of each kind (default 100).\n"
+        "  -r\tRelocations per MZ relocation table and NE segment (default 1000).\n"
+            "\tLE/LX pages get as many fixups, up to one per 4 bytes of page.\n"
+        "  -s\tNE segments and LE/LX objects per file (default 8).\n"
+        "  -i\tNE imported names and LE/LX imported procedures per file (default 500).\n"
+        "  -m\tModule references per NE and LE/LX file, and VxDs per W3 file (default 8).\n"
+        "  -k\tKinds of file to write, from mz,ne,le,lx,w3 (default all of them).\n"
+        "  -h\tDisplay this help.\n"
+    );
+    exit(0);
+}
+
+static int number(const char *arg, int max) {
+    char *end;
+    long v = strtol(arg, &end, 0);
+
+    if (*end || v < 0 || v > max) errx(1, "Invalid value: %s", arg);
+    return (int) v;
+}
+
+int main(int argc, char *argv[]) {
+    static const struct { const char *name; unsigned kind; const char *ext; } kinds[] = {
+        { "mz", GEN_MZ, "exe" }, { "ne", GEN_NE, "exe" }, { "le", GEN_LE, "386" }, { "lx", GEN_LX, "dll" }, { "w3", GEN_W3, "exe" }
+    };
+    struct params pr = { 100, 1000, 8, 500, 8, 0 };
+    struct gbuf b = { NULL, 0, 0 };
+    const char *dir, *p;
+    char fname[32];
+    size_t len, total = 0;
+    int option, i, k;
+
+#ifdef NEED_ERR
+    setprogname(argv[0]);
+#endif
+    while ((option = getopt(argc, argv, "hc:r:s:i:m:k:")) != -1) {
+        switch (option) {
+            case 'c': pr.count = number(optarg, 1000000); break;
+            case 'r': pr.relocs = number(optarg, 65535); break;
+            case 's': pr.segments = number(optarg, 255); break;
+            case 'i': pr.imports = number(optarg, 65535); break;
+            case 'm': pr.modules = number(optarg, 255); break;
+            case 'k':
+                for (p = optarg; *p; p += len + (p[len] == ',')) {
+                    len = strcspn(p, ",");
+                    for (k = 0; k < (int) (sizeof(kinds) / sizeof(kinds[0])); k++)
+                        if (strlen(kinds[k].name) == len && !strncmp(kinds[k].name, p, len)) break;
+                    if (k == (int) (sizeof(kinds) / sizeof(kinds[0]))) errx(1, "Unknown kind: %.*s", (int) len, p);
+                    pr.kinds |= kinds[k].kind;
+                }
+                break;
+            default:
+                display_help();
+        }
+    }
+    if (optind != argc - 1) display_help();
+    dir = argv[optind];
+    if (!pr.kinds) pr.kinds = GEN_MZ | GEN_NE | GEN_LE | GEN_LX | GEN_W3;
+    if (mkdir(dir, 0777) && errno != EEXIST) err(1, "Cannot create %s", dir);
+
+    for (k = 0; k < (int) (sizeof(kinds) / sizeof(kinds[0])); k++) {
+        if (!(pr.kinds & kinds[k].kind)) continue;
+        for (i = 0; i < pr.count; i++) {
+            b.len = 0;
+            switch (kinds[k].kind) {
+                case GEN_MZ: gen_mz(&b, &pr); break;
+                case GEN_NE: gen_ne(&b, &pr, i); break;
+                case GEN_LE:
+                    put_mz_stub(&b, MZ_STUB_SIZE);
+                    gen_le(&b, &pr, i, 0, 0);
+                    break;
+                case GEN_LX:
+                    put_mz_stub(&b, MZ_STUB_SIZE);
+                    gen_le(&b, &pr, i, 1, 0);
+                    break;
+                case GEN_W3: gen_w3(&b, &pr, i); break;
+            }
+            sprintf(fname, "%s%05d.%s", kinds[k].name, i, kinds[k].ext);
+            write_file(dir, fname, &b);
+            total += b.len;
+        }
+    }
+    printf("Wrote %lu bytes to %s\n", (unsigned long) total, dir);
+    free(b.p);
+    return 0;
+}
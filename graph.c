@@ -0,0 +1,525 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd
+ * graph.c - Import resolution and dependency graph over a set of files
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Three passes. Every file is parsed on the worker pool and boiled down
+ * to a graph_file: the module name it goes by, its exports sorted by
+ * ordinal and by name, and its imports grouped by module. Only that much
+ * is kept (in an arena of its own), so the files are unmapped as soon as
+ * they are read. The module names then go into one hash table, and the
+ * imports are resolved against it on the pool again, each file writing
+ * only to its own graph_file. Last, the graph is written out in file
+ * order.
+ *
+ * Module names are matched without regard to case and without an
+ * extension, so that KERNEL, KERNEL.EXE and kernel.dll are all the same
+ * module. Imports are resolved name by name and ordinal by ordinal; NE
+ * and LE/LX files list theirs in their relocations and fixups, PE files
+ * in their import directories.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <err.h> /* -I. or such for platforms without err.h */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "readexe.h"
+#include "pool.h"
+#include "graph.h"
+
+/* An export, or one import from a module */
+struct graph_sym {
+    const char *name;                       /* NUL-terminated, or NULL for an ordinal */
+    uint32_t len;
+    uint32_t ordinal;
+    int missing;                            /* an import the module does not export */
+};
+
+/* The imports from one module */
+struct graph_dep {
+    const char *module;                     /* as the importer names it */
+    const char *key;                        /* for graph_lookup() */
+    struct graph_sym *syms;
+    int count;
+    int provider;                           /* index of the file that is the module, or -1 */
+    int unresolved;
+};
+
+struct graph_file {
+    struct arena arena;                     /* everything below */
+    const char *fname;
+    int kind;                               /* enum exe_kind, or -1 if the file could not be read */
+    const char *module;                     /* the name the file goes by */
+    const char *key;
+    struct graph_sym *ordinals;             /* exports, sorted by ordinal */
+    int ordinalCount;
+    struct graph_sym *names;                /* exported names, sorted */
+    int nameCount;
+    struct graph_dep *deps;
+    int depCount;
+};
+
+struct graph {
+    struct graph_file *files;
+    int count;
+    int *table;                             /* module keys: file index + 1, or 0 for an empty slot */
+    uint32_t mask;
+};
+
+static char *graph_strdup(struct arena *arena, const char *s, size_t len) {
+    char *p;
+
+    if (!(p = arena_alloc(arena, len + 1))) err(1, "Cannot allocate memory");
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+/* A module name in upper case, less any directory and extension. */
+static const char *graph_key(struct arena *arena, const char *name) {
+    const char *base = name, *dot, *p;
+    char *key;
+    size_t i, len;
+
+    for (p = name; *p; p++)
+        if (*p == '/' || *p == '\\' || *p == ':') base = p + 1;
+    len = (dot = strrchr(base, '.')) && dot != base ? (size_t) (dot - base) : strlen(base);
+    key = graph_strdup(arena, base, len);
+    for (i = 0; i < len; i++)
+        if (key[i] >= 'a' && key[i] <= 'z') key[i] -= 'a' - 'A';
+    return key;
+}
+
+static uint32_t graph_hash(const char *key) {
+    return (uint32_t) xxh64(key, strlen(key), 0);
+}
+
+static int compare_sym_ordinal(const void *a, const void *b) {
+    const struct graph_sym *sa = a, *sb = b;
+
+    return (sa->ordinal > sb->ordinal) - (sa->ordinal < sb->ordinal);
+}
+
+static int compare_sym_name(const void *a, const void *b) {
+    const struct graph_sym *sa = a, *sb = b;
+    int c = memcmp(sa->name, sb->name, sa->len < sb->len ? sa->len : sb->len);
+
+    return c ? c : (sa->len > sb->len) - (sa->len < sb->len);
+}
+
+/* An LE/LX import, as the fixups refer to it */
+struct graph_leimp {
+    uint16_t module;
+    uint16_t byname;
+    uint32_t value;                         /* ordinal or procedure name offset */
+};
+
+static int compare_leimp(const void *a, const void *b) {
+    const struct graph_leimp *ia = a, *ib = b;
+
+    if (ia->module != ib->module) return (ia->module > ib->module) - (ia->module < ib->module);
+    if (ia->byname != ib->byname) return (ia->byname > ib->byname) - (ia->byname < ib->byname);
+    return (ia->value > ib->value) - (ia->value < ib->value);
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t ua = *(const uint32_t *) a, ub = *(const uint32_t *) b;
+
+    return (ua > ub) - (ua < ub);
+}
+
+static struct graph_sym *graph_syms(struct graph_file *f, int count) {
+    struct graph_sym *syms;
+
+    if (!count) return NULL;
+    if (!(syms = arena_calloc(&f->arena, count, sizeof(struct graph_sym)))) err(1, "Cannot allocate memory");
+    return syms;
+}
+
+static void graph_deps(struct graph_file *f, int count) {
+    if (count && !(f->deps = arena_calloc(&f->arena, count, sizeof(struct graph_dep)))) err(1, "Cannot allocate memory");
+    f->depCount = count;
+}
+
+static void graph_dep(struct graph_file *f, struct graph_dep *dep, const char *module, size_t len) {
+    dep->module = graph_strdup(&f->arena, module, len);
+    dep->key = graph_key(&f->arena, dep->module);
+    dep->provider = -1;
+}
+
+static void graph_ne(struct graph_file *f, struct THIS *this) {
+    const struct exe_ne_import *imp;
+    const struct exe_ne_reloc *r;
+    struct graph_dep *dep;
+    struct graph_sym *sym;
+    uint32_t *keys = NULL;
+    unsigned long n = 0, cap = 0;
+    uint16_t module;
+    int i, j, type;
+
+    if (this->ne_moduleName.size) f->module = graph_strdup(&f->arena, this->ne_moduleName.name, this->ne_moduleName.size);
+    for (i = 0; i < this->ne_exportCount; i++)
+        if (this->neexps[i].segment) f->ordinalCount++;
+    f->ordinals = graph_syms(f, f->ordinalCount);
+    for (i = 0, j = 0; i < this->ne_exportCount; i++)
+        if (this->neexps[i].segment) f->ordinals[j++].ordinal = this->neexps[i].ordinal;
+    f->names = graph_syms(f, this->ne_nameCount);
+    for (i = 0; i < this->ne_nameCount; i++) {
+        f->names[f->nameCount].name = graph_strdup(&f->arena, this->nenames[i].name, this->nenames[i].size);
+        f->names[f->nameCount].len = this->nenames[i].size;
+        f->names[f->nameCount++].ordinal = this->nenames[i].ordinal;
+    }
+
+    /* Every imported name and ordinal the relocations refer to, once each, grouped by module. */
+    for (i = 0; this->nerelocs && i < this->ne->segmentCount; i++) {
+        for (j = 0; j < this->nerelocs[i].count; j++) {
+            r = &this->nerelocs[i].relocs[j];
+            type = r->relocationType & RELTYPE_MASK;
+            if (type != RELTYPE_IMPORD && type != RELTYPE_IMPNAME) continue;
+            if (!r->moduleReference || r->moduleReference > this->ne_moduleCount) continue;
+            if (n == cap) {
+                cap = cap ? cap * 2 : 256;
+                if (!(keys = realloc(keys, sizeof(uint32_t) * cap))) err(1, "Cannot allocate memory");
+            }
+            keys[n++] = NE_IMPORT_KEY(r->moduleReference, type == RELTYPE_IMPNAME, r->importOrdinal);
+        }
+    }
+    if (n) qsort(keys, n, sizeof(uint32_t), compare_u32);
+
+    graph_deps(f, this->ne_moduleCount);
+    for (i = 0; i < this->ne_moduleCount; i++)
+        graph_dep(f, &f->deps[i], this->nemods[i].name, this->nemods[i].size);
+    for (i = 0; (unsigned long) i < n; i = j) {
+        module = NE_IMPORT_KEY_MODULE(keys[i]);
+        dep = &f->deps[module - 1];
+        for (j = i; (unsigned long) j < n && NE_IMPORT_KEY_MODULE(keys[j]) == module; j++)
+            if (j == i || keys[j] != keys[j - 1]) dep->count++;
+        dep->syms = graph_syms(f, dep->count);
+        dep->count = 0;
+        for (j = i; (unsigned long) j < n && NE_IMPORT_KEY_MODULE(keys[j]) == module; j++) {
+            if (j != i && keys[j] == keys[j - 1]) continue;
+            sym = &dep->syms[dep->count++];
+            if (!NE_IMPORT_KEY_BYNAME(keys[j])) sym->ordinal = NE_IMPORT_KEY_VALUE(keys[j]);
+            else if ((imp = get_ne_import(this, NE_IMPORT_KEY_VALUE(keys[j])))) {
+                sym->name = graph_strdup(&f->arena, imp->name, imp->size);
+                sym->len = imp->size;
+            } else {
+                sym->name = "";
+            }
+        }
+    }
+    free(keys);
+}
+
+static void graph_le(struct graph_file *f, struct THIS *this) {
+    const struct le_fixups *fx = &this->lefix;
+    const struct exe_le_name *proc;
+    struct graph_leimp *imps = NULL;
+    struct graph_dep *dep;
+    struct graph_sym *sym;
+    uint32_t k, m, n = 0;
+    int i, j, type;
+
+    le_load(this, LE_HAVE_ENTRIES | LE_HAVE_RESNAMES | LE_HAVE_NONRESNAMES | LE_HAVE_IMPORTS);
+    /* The first resident name is the module's own, with ordinal 0. */
+    if (this->le_resnameCount && !this->leresnames[0].ordinal)
+        f->module = graph_strdup(&f->arena, this->leresnames[0].name, this->leresnames[0].size);
+    f->ordinals = graph_syms(f, this->le_entryCount);
+    for (i = 0; i < this->le_entryCount; i++)
+        if (this->leents[i].type != LE_BUNDLE_FORWARDER) f->ordinals[f->ordinalCount++].ordinal = this->leents[i].ordinal;
+    f->names = graph_syms(f, this->le_resnameCount + this->le_nonresnameCount);
+    for (i = 0; i < this->le_resnameCount + this->le_nonresnameCount; i++) {
+        const struct exe_le_name *name = i < this->le_resnameCount ? &this->leresnames[i] : &this->lenonresnames[i - this->le_resnameCount];
+
+        if (!name->ordinal) continue;
+        f->names[f->nameCount].name = graph_strdup(&f->arena, name->name, name->size);
+        f->names[f->nameCount].len = name->size;
+        f->names[f->nameCount++].ordinal = name->ordinal;
+    }
+    graph_deps(f, this->le_impmodCount);
+    for (j = 0; j < this->le_impmodCount; j++)
+        graph_dep(f, &f->deps[j], this->leimpmods[j].name, this->leimpmods[j].size);
+
+    /* Every imported name and ordinal the fixups refer to, once each, grouped by module. */
+    le_load_fixups(this, 1);
+    for (k = 0; k < fx->count; k++) {
+        type = fx->targetFlags[k] & LE_TARGET_MASK;
+        if ((type == LE_TARGET_IMPORD || type == LE_TARGET_IMPNAME) && fx->target[k] >= 1 && fx->target[k] <= this->le_impmodCount) n++;
+    }
+    if (n && !(imps = malloc(sizeof(struct graph_leimp) * n))) err(1, "Cannot allocate memory");
+    for (k = 0, n = 0; k < fx->count; k++) {
+        type = fx->targetFlags[k] & LE_TARGET_MASK;
+        if ((type != LE_TARGET_IMPORD && type != LE_TARGET_IMPNAME) || !fx->target[k] || fx->target[k] > this->le_impmodCount) continue;
+        imps[n].module = fx->target[k];
+        imps[n].byname = type == LE_TARGET_IMPNAME;
+        imps[n++].value = fx->value[k];
+    }
+    if (n) qsort(imps, n, sizeof(struct graph_leimp), compare_leimp);
+    for (k = 0; k < n; k = m) {
+        dep = &f->deps[imps[k].module - 1];
+        for (m = k; m < n && imps[m].module == imps[k].module; m++)
+            if (m == k || compare_leimp(&imps[m], &imps[m - 1])) dep->count++;
+        dep->syms = graph_syms(f, dep->count);
+        dep->count = 0;
+        for (m = k; m < n && imps[m].module == imps[k].module; m++) {
+            if (m != k && !compare_leimp(&imps[m], &imps[m - 1])) continue;
+            sym = &dep->syms[dep->count++];
+            if (!imps[m].byname) sym->ordinal = imps[m].value;
+            else if ((proc = le_import_proc(this, imps[m].value))) {
+                sym->name = graph_strdup(&f->arena, proc->name, proc->size);
+                sym->len = proc->size;
+            } else {
+                sym->name = "";
+            }
+        }
+    }
+    free(imps);
+}
+
+static void graph_pe(struct graph_file *f, struct THIS *this) {
+    const struct exe_pe_module *mod;
+    const struct exe_pe_import *imp;
+    struct graph_sym *sym;
+    int i, j;
+
+    pe_load(this, PE_HAVE_IMPORTS | PE_HAVE_EXPORTS);
+    if (this->pe_expName) f->module = graph_strdup(&f->arena, this->pe_expName, this->pe_expNameLen);
+    f->ordinals = graph_syms(f, this->pe_exportCount);
+    f->names = graph_syms(f, this->pe_exportCount);
+    for (i = 0; i < this->pe_exportCount; i++) {
+        f->ordinals[f->ordinalCount++].ordinal = this->peexps[i].ordinal;
+        if (!this->peexps[i].name) continue;
+        f->names[f->nameCount].name = graph_strdup(&f->arena, this->peexps[i].name, this->peexps[i].nameLen);
+        f->names[f->nameCount].len = this->peexps[i].nameLen;
+        f->names[f->nameCount++].ordinal = this->peexps[i].ordinal;
+    }
+    graph_deps(f, this->pe_moduleCount);
+    for (i = 0; i < this->pe_moduleCount; i++) {
+        mod = &this->pemods[i];
+        graph_dep(f, &f->deps[i], mod->name, mod->nameLen);
+        f->deps[i].syms = graph_syms(f, mod->count);
+        for (j = 0; j < mod->count; j++) {
+            imp = &this->peimps[mod->first + j];
+            sym = &f->deps[i].syms[f->deps[i].count++];
+            if (imp->name) {
+                sym->name = graph_strdup(&f->arena, imp->name, imp->nameLen);
+                sym->len = imp->nameLen;
+            } else sym->ordinal = imp->hint;
+        }
+    }
+}
+
+/* First pass: what one file exports and imports. */
+static void graph_index(void *ctx, int index, int worker) {
+    struct graph *g = ctx;
+    struct graph_file *f = &g->files[index];
+    const struct exe_diag *d;
+    const char *base, *p;
+    struct THIS *this;
+
+    (void) worker;
+    if (!(this = init_this())) err(1, "Cannot allocate memory");
+    this->fname = f->fname;
+    this->need = NEED_NEXT | NEED_NE_NAMES | NEED_NE_SEGMENTS | NEED_NE_RELOCS | NEED_NE_EXPORTS;
+    if (strcmp(f->fname, "-") ? map_file(this) : map_stream(this, stdin)) {
+        warn("Cannot open %s", f->fname);
+        f->kind = -1;
+        destroy_this(this);
+        return;
+    }
+    read_exe(this);
+    f->kind = this->kind;
+    if (this->ne) graph_ne(f, this);
+    else if (this->le) graph_le(f, this);
+    else if (this->pe) graph_pe(f, this);
+    /* Files that do not name themselves go by their file name, as Windows would load them. */
+    if (!f->module) {
+        for (base = p = f->fname; *p; p++)
+            if (*p == '/' || *p == '\\' || *p == ':') base = p + 1;
+        f->module = graph_strdup(&f->arena, base, strlen(base));
+    }
+    f->key = graph_key(&f->arena, f->module);
+    if (f->ordinalCount) qsort(f->ordinals, f->ordinalCount, sizeof(struct graph_sym), compare_sym_ordinal);
+    if (f->nameCount) qsort(f->names, f->nameCount, sizeof(struct graph_sym), compare_sym_name);
+    for (d = this->diags; d; d = d->next)
+        warnx("%s", d->msg);
+    destroy_this(this);
+}
+
+static int graph_lookup(const struct graph *g, const char *key) {
+    uint32_t slot;
+
+    for (slot = graph_hash(key) & g->mask; g->table[slot]; slot = (slot + 1) & g->mask)
+        if (!strcmp(g->files[g->table[slot] - 1].key, key)) return g->table[slot] - 1;
+    return -1;
+}
+
+/* Second pass: each of one file's imports looked up in the module that should have it. */
+static void graph_resolve(void *ctx, int index, int worker) {
+    struct graph *g = ctx;
+    struct graph_file *f = &g->files[index], *p;
+    struct graph_dep *dep;
+    struct graph_sym *sym;
+    int i, j;
+
+    (void) worker;
+    for (i = 0; i < f->depCount; i++) {
+        dep = &f->deps[i];
+        dep->provider = graph_lookup(g, dep->key);
+        p = dep->provider >= 0 ? &g->files[dep->provider] : NULL;
+        for (j = 0; j < dep->count; j++) {
+            sym = &dep->syms[j];
+            if (!p) sym->missing = 1;
+            else if (sym->name) sym->missing = !p->nameCount || !bsearch(sym, p->names, p->nameCount, sizeof(struct graph_sym), compare_sym_name);
+            else sym->missing = !p->ordinalCount || !bsearch(sym, p->ordinals, p->ordinalCount, sizeof(struct graph_sym), compare_sym_ordinal);
+            if (sym->missing) dep->unresolved++;
+        }
+    }
+}
+
+static void dot_id(FILE *out, const char *prefix, const char *s) {
+    fprintf(out, "\"%s", prefix);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void dot_str(FILE *out, const char *s) {
+    dot_id(out, "", s);
+}
+
+static void graph_write(const struct graph *g, enum graph_format format, FILE *out, struct graph_counts *counts) {
+    const struct graph_file *f;
+    const struct graph_dep *dep;
+    const struct graph_sym *sym;
+    int i, j, k;
+
+    if (format == GRAPH_DOT) {
+        fprintf(out, "digraph imports {\n  node [shape=box];\n");
+        for (i = 0; i < g->count; i++) {
+            f = &g->files[i];
+            if (f->kind != EXE_NE && f->kind != EXE_LE && f->kind != EXE_LX && f->kind != EXE_PE) continue;
+            fprintf(out, "  ");
+            dot_str(out, f->fname);
+            fprintf(out, " [label=");
+            dot_str(out, f->module);
+            fprintf(out, "];\n");
+        }
+    }
+    for (i = 0; i < g->count; i++) {
+        f = &g->files[i];
+        for (j = 0; j < f->depCount; j++) {
+            dep = &f->deps[j];
+            counts->edges++;
+            counts->imports += dep->count;
+            counts->unresolved += dep->unresolved;
+            if (dep->provider < 0) counts->missing++;
+            if (format == GRAPH_EDGES) {
+                fprintf(out, "edge\t%s\t%s\t%s\t%d\t%d\n", f->fname, dep->module,
+                    dep->provider >= 0 ? g->files[dep->provider].fname : "-", dep->count - dep->unresolved, dep->unresolved);
+                for (k = 0; k < dep->count; k++) {
+                    sym = &dep->syms[k];
+                    if (!sym->missing) continue;
+                    if (sym->name) fprintf(out, "unresolved\t%s\t%s\t%s\n", f->fname, dep->module, sym->name);
+                    else fprintf(out, "unresolved\t%s\t%s\t@%"PRIu32"\n", f->fname, dep->module, sym->ordinal);
+                }
+                continue;
+            }
+            /* Modules no file provides get a dashed node named by key; Graphviz merges the repeats into one. */
+            if (dep->provider < 0) {
+                fprintf(out, "  ");
+                dot_id(out, "missing:", dep->key);
+                fprintf(out, " [label=");
+                dot_str(out, dep->module);
+                fprintf(out, ", style=dashed];\n");
+            }
+            fprintf(out, "  ");
+            dot_str(out, f->fname);
+            fprintf(out, " -> ");
+            if (dep->provider >= 0) dot_str(out, g->files[dep->provider].fname);
+            else dot_id(out, "missing:", dep->key);
+            if (dep->provider < 0) fprintf(out, " [style=dashed, label=\"missing\"]");
+            else if (dep->unresolved) fprintf(out, " [color=red, label=\"%d/%d unresolved\"]", dep->unresolved, dep->count);
+            else if (dep->count) fprintf(out, " [label=\"%d\"]", dep->count);
+            fprintf(out, ";\n");
+            for (k = 0; dep->provider >= 0 && k < dep->count; k++) {
+                sym = &dep->syms[k];
+                if (!sym->missing) continue;
+                if (sym->name) fprintf(out, "  /* unresolved: %s.%s */\n", dep->module, sym->name);
+                else fprintf(out, "  /* unresolved: %s.@%"PRIu32" */\n", dep->module, sym->ordinal);
+            }
+        }
+    }
+    if (format == GRAPH_DOT) fprintf(out, "}\n");
+}
+
+/*
+ * Resolves the imports of every file in files against the exports of the
+ * others, on up to nthreads threads, and writes the graph to out. Returns
+ * the number of files that could not be read.
+ */
+int graph_run(char *const *files, int count, int nthreads, enum graph_format format, FILE *out, struct graph_counts *counts) {
+    struct graph g;
+    struct graph_file *f;
+    uint32_t size, slot;
+    int i;
+
+    memset(counts, 0, sizeof(*counts));
+    g.count = count;
+    if (!(g.files = calloc(count ? count : 1, sizeof(struct graph_file)))) err(1, "Cannot allocate memory");
+    for (i = 0; i < count; i++)
+        g.files[i].fname = files[i];
+    pool_run(count, nthreads, graph_index, &g);
+
+    /* Only files that can be loaded as modules; the first of two with the same name wins, as on a search path. */
+    for (size = 16; size < (uint32_t) count * 2; size <<= 1)
+        ;
+    if (!(g.table = calloc(size, sizeof(int)))) err(1, "Cannot allocate memory");
+    g.mask = size - 1;
+    for (i = 0; i < count; i++) {
+        f = &g.files[i];
+        if (f->kind < 0) {
+            counts->failed++;
+            continue;
+        }
+        if (f->kind != EXE_NE && f->kind != EXE_LE && f->kind != EXE_LX && f->kind != EXE_PE) continue;
+        counts->files++;
+        if (graph_lookup(&g, f->key) >= 0) {
+            counts->duplicates++;
+            continue;
+        }
+        for (slot = graph_hash(f->key) & g.mask; g.table[slot]; slot = (slot + 1) & g.mask)
+            ;
+        g.table[slot] = i + 1;
+    }
+    pool_run(count, nthreads, graph_resolve, &g);
+    graph_write(&g, format, out, counts);
+
+    for (i = 0; i < count; i++)
+        arena_free(&g.files[i].arena);
+    free(g.table);
+    free(g.files);
+    return (int) counts->failed;
+}
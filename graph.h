@@ -0,0 +1,41 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd
+ * graph.h - Import resolution and dependency graph over a set of files
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdio.h>
+
+enum graph_format {
+    GRAPH_DOT,                              /* a Graphviz digraph */
+    GRAPH_EDGES                             /* tab-separated "edge" and "unresolved" lines */
+};
+
+/* What graph_run() found, for the summary */
+struct graph_counts {
+    unsigned long files;                    /* NE, LE, LX and PE files indexed */
+    unsigned long failed;                   /* files that could not be read */
+    unsigned long edges;                    /* importer and module pairs */
+    unsigned long imports;                  /* imported names and ordinals */
+    unsigned long unresolved;               /* of those, not found in the module that should have them */
+    unsigned long missing;                  /* edges to modules no file provides */
+    unsigned long duplicates;               /* files naming themselves after a module already indexed */
+};
+
+int graph_run(char *const *files, int count, int nthreads, enum graph_format format, FILE *out, struct graph_counts *counts);
+
+#endif /* GRAPH_H */
@@ -0,0 +1,219 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd
+ * hash.c - XXH64 and SHA-256, for hashing segments, objects and modules
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Plain C on purpose: this has to build for DOS and OS/2 as well. XXH64
+ * keeps four independent lanes going, which a modern CPU already runs in
+ * parallel, so it keeps up with a mapped file without SIMD help.
+ */
+
+#include <string.h>
+#include "hash.h"
+
+/* Little-endian loads, as the rest of readexe assumes; memcpy() keeps them legal at any alignment. */
+static uint64_t load64(const uint8_t *p) {
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t load32(const uint8_t *p) {
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+#define XXH_PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define XXH_PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define XXH_PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define XXH_PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define XXH_PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    acc = ROTL64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static uint64_t xxh64_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void xxh64_stripe(uint64_t v[4], const uint8_t *p) {
+    v[0] = xxh64_round(v[0], load64(p));
+    v[1] = xxh64_round(v[1], load64(p + 8));
+    v[2] = xxh64_round(v[2], load64(p + 16));
+    v[3] = xxh64_round(v[3], load64(p + 24));
+}
+
+void xxh64_init(struct xxh64_state *s, uint64_t seed) {
+    memset(s, 0, sizeof(*s));
+    s->seed = seed;
+    s->v[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    s->v[1] = seed + XXH_PRIME64_2;
+    s->v[2] = seed;
+    s->v[3] = seed - XXH_PRIME64_1;
+}
+
+void xxh64_update(struct xxh64_state *s, const void *data, size_t len) {
+    const uint8_t *p = data;
+    size_t n;
+
+    s->total += len;
+    if (s->buflen) {
+        n = sizeof(s->buf) - s->buflen < len ? sizeof(s->buf) - s->buflen : len;
+        memcpy(s->buf + s->buflen, p, n);
+        s->buflen += n;
+        p += n;
+        len -= n;
+        if (s->buflen < sizeof(s->buf)) return;
+        xxh64_stripe(s->v, s->buf);
+        s->buflen = 0;
+    }
+    for (; len >= 32; p += 32, len -= 32)
+        xxh64_stripe(s->v, p);
+    memcpy(s->buf, p, len);
+    s->buflen = len;
+}
+
+uint64_t xxh64_digest(const struct xxh64_state *s) {
+    const uint8_t *p = s->buf, *end = s->buf + s->buflen;
+    uint64_t h;
+
+    if (s->total >= 32) {
+        h = ROTL64(s->v[0], 1) + ROTL64(s->v[1], 7) + ROTL64(s->v[2], 12) + ROTL64(s->v[3], 18);
+        h = xxh64_merge(h, s->v[0]);
+        h = xxh64_merge(h, s->v[1]);
+        h = xxh64_merge(h, s->v[2]);
+        h = xxh64_merge(h, s->v[3]);
+    } else h = s->seed + XXH_PRIME64_5;
+    h += s->total;
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, load64(p));
+        h = ROTL64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t) load32(p) * XXH_PRIME64_1;
+        h = ROTL64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * XXH_PRIME64_5;
+        h = ROTL64(h, 11) * XXH_PRIME64_1;
+    }
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t xxh64(const void *data, size_t len, uint64_t seed) {
+    struct xxh64_state s;
+
+    xxh64_init(&s, seed);
+    xxh64_update(&s, data, len);
+    return xxh64_digest(&s);
+}
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, r) (((x) >> (r)) | ((x) << (32 - (r))))
+
+static void sha256_block(uint32_t h[8], const uint8_t *p) {
+    uint32_t w[64], a, b, c, d, e, f, g, k, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = (uint32_t) p[4 * i] << 24 | (uint32_t) p[4 * i + 1] << 16 | (uint32_t) p[4 * i + 2] << 8 | p[4 * i + 3];
+    for (; i < 64; i++)
+        w[i] = w[i - 16] + (ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3))
+             + w[i - 7] + (ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10));
+    a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4]; f = h[5]; g = h[6]; k = h[7];
+    for (i = 0; i < 64; i++) {
+        t1 = k + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+void sha256_init(struct sha256_state *s) {
+    static const uint32_t iv[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+    memset(s, 0, sizeof(*s));
+    memcpy(s->h, iv, sizeof(iv));
+}
+
+void sha256_update(struct sha256_state *s, const void *data, size_t len) {
+    const uint8_t *p = data;
+    size_t n;
+
+    s->total += len;
+    if (s->buflen) {
+        n = sizeof(s->buf) - s->buflen < len ? sizeof(s->buf) - s->buflen : len;
+        memcpy(s->buf + s->buflen, p, n);
+        s->buflen += n;
+        p += n;
+        len -= n;
+        if (s->buflen < sizeof(s->buf)) return;
+        sha256_block(s->h, s->buf);
+        s->buflen = 0;
+    }
+    for (; len >= 64; p += 64, len -= 64)
+        sha256_block(s->h, p);
+    memcpy(s->buf, p, len);
+    s->buflen = len;
+}
+
+void sha256_final(struct sha256_state *s, uint8_t digest[SHA256_SIZE]) {
+    uint64_t bits = s->total * 8;
+    int i;
+
+    s->buf[s->buflen++] = 0x80;
+    if (s->buflen > 56) {
+        memset(s->buf + s->buflen, 0, sizeof(s->buf) - s->buflen);
+        sha256_block(s->h, s->buf);
+        s->buflen = 0;
+    }
+    memset(s->buf + s->buflen, 0, 56 - s->buflen);
+    for (i = 0; i < 8; i++)
+        s->buf[56 + i] = (uint8_t) (bits >> (56 - 8 * i));
+    sha256_block(s->h, s->buf);
+    for (i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t) (s->h[i] >> 24);
+        digest[4 * i + 1] = (uint8_t) (s->h[i] >> 16);
+        digest[4 * i + 2] = (uint8_t) (s->h[i] >> 8);
+        digest[4 * i + 3] = (uint8_t) s->h[i];
+    }
+}
@@ -0,0 +1,52 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd
+ * hash.h - XXH64 and SHA-256, for hashing segments, objects and modules
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Streaming XXH64; xxh64("", 0, 0) is 0xEF46DB3751D8E999. */
+struct xxh64_state {
+    uint64_t v[4];                          /* the four lanes */
+    uint64_t seed;
+    uint64_t total;                         /* bytes taken so far */
+    uint8_t buf[32];                        /* a partial stripe */
+    uint32_t buflen;
+};
+
+void xxh64_init(struct xxh64_state *s, uint64_t seed);
+void xxh64_update(struct xxh64_state *s, const void *data, size_t len);
+uint64_t xxh64_digest(const struct xxh64_state *s);
+uint64_t xxh64(const void *data, size_t len, uint64_t seed);
+
+/* Streaming SHA-256 (FIPS 180-4) */
+#define SHA256_SIZE 32
+
+struct sha256_state {
+    uint32_t h[8];
+    uint64_t total;
+    uint8_t buf[64];
+    uint32_t buflen;
+};
+
+void sha256_init(struct sha256_state *s);
+void sha256_update(struct sha256_state *s, const void *data, size_t len);
+void sha256_final(struct sha256_state *s, uint8_t digest[SHA256_SIZE]);
+
+#endif /* HASH_H */
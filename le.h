@@ -43,11 +43,10 @@ struct exe_le_header {
             uint32_t    _reserved4       : 2;
             uint32_t    moduleNotLoaded  : 1;
             uint32_t    _reserved5       : 2;
-            uint32_t    libraryModule    : 1;
-            uint32_t    _reserved6       : 7;
-            uint32_t    protectedLibrary : 1;
-            uint32_t    deviceDriver     : 1;
-            uint32_t    _reserved7       : 7;
+            uint32_t    moduleType       : 3; /* enum exe_le_module_type */
+            uint32_t    _reserved6       : 12;
+            uint32_t    libTerm          : 1;
+            uint32_t    _reserved7       : 1;
         };
     };
     uint32_t    pages;
@@ -70,7 +69,7 @@ struct exe_le_header {
     uint32_t    idataMapOffset;
     uint32_t    resourceOffset;
     uint32_t    resourceCount;
-    uint32_t    resourceNameOffset;
+    uint32_t    residentNameTableOffset;
     uint32_t    entryTableOffset;
     uint32_t    moduleDirectiveOffset;
     uint32_t    moduleDirectiveCount;
@@ -80,8 +79,9 @@ struct exe_le_header {
     uint32_t    importModuleNameTableCount;
     uint32_t    importProcNameTableOffset;
     uint32_t    pageChecksumTableOffset;
+    uint32_t    dataPagesOffset;    /* from the start of the file */
     uint32_t    preloadPageCount;
-    uint32_t    nonresidentNameTableOffset;
+    uint32_t    nonresidentNameTableOffset; /* from the start of the file */
     uint32_t    nonresidentNameTableSize;
     uint32_t    nonresidentNameTableChecksum;
     uint32_t    autodataObject;
@@ -97,12 +97,147 @@ struct exe_le_header {
             uint8_t leReserved[8];
             uint32_t windowsResourceOffset;
             uint32_t windowsResourceSize;
-            uint32_t windowsDeviceID;
-            uint32_t windowsDDKVersion;
+            uint16_t windowsDeviceID;
+            uint16_t windowsDDKVersion;
         };
     };
 };
 
+/* Unless noted otherwise, table offsets in the header are from the start of the header. */
+
+/* Object table entry */
+struct exe_le_object {
+    uint32_t    virtualSize;
+    uint32_t    relocBase;
+    uint32_t    flags;              /* LE_OBJ_* */
+    uint32_t    pageMapIndex;       /* first entry in the object page map, from 1 */
+    uint32_t    pageMapEntries;
+    uint32_t    _reserved;
+};
+
+/* Object page map entry, LE flavour */
+struct exe_le_page_le {
+    uint8_t     pageNumber[3];      /* big-endian, from 1 */
+    uint8_t     flags;              /* LE_PAGE_* */
+};
+
+/* Object page map entry, LX flavour */
+struct exe_le_page_lx {
+    uint32_t    dataOffset;         /* shifted left by pageShift, from dataPagesOffset */
+    uint16_t    dataSize;
+    uint16_t    flags;              /* LE_PAGE_* */
+};
+
+/* An iterated (EXEPACK1) page is a run of these, each followed by byteCount bytes to be repeated iterations times. */
+struct exe_le_iterated {
+    uint16_t    iterations;
+    uint16_t    byteCount;
+};
+
+/* Entry table bundle header; the object number is absent for unused bundles. */
+struct exe_le_bundle {
+    uint8_t     count;
+    uint8_t     type;               /* LE_BUNDLE_* */
+    uint16_t    object;
+};
+
+/* Resident, non-resident, imported module and imported procedure names, pointing into the file image */
+struct exe_le_name {
+    uint8_t     size;
+    uint32_t    offset;             /* from the start of its table */
+    uint16_t    ordinal;            /* resident and non-resident names only */
+    const char  *name;
+};
+
+/* A decoded entry table entry */
+struct exe_le_entry {
+    uint16_t    ordinal;
+    uint8_t     type;               /* LE_BUNDLE_* */
+    uint8_t     flags;              /* LE_ENTRY_* */
+    uint16_t    object;             /* or the module ordinal of a forwarder */
+    uint16_t    callgate;
+    uint32_t    offset;             /* or the ordinal or procedure name offset of a forwarder */
+};
+
+#define LE_OBJ_READABLE     0x0001
+#define LE_OBJ_WRITABLE     0x0002
+#define LE_OBJ_EXECUTABLE   0x0004
+#define LE_OBJ_RESOURCE     0x0008
+#define LE_OBJ_DISCARDABLE  0x0010
+#define LE_OBJ_SHARED       0x0020
+#define LE_OBJ_PRELOAD      0x0040
+#define LE_OBJ_INVALID      0x0080
+#define LE_OBJ_ZEROFILL     0x0100
+#define LE_OBJ_RESIDENT     0x0200
+#define LE_OBJ_LONGLOCKABLE 0x0400
+#define LE_OBJ_ALIAS16      0x1000
+#define LE_OBJ_BIG          0x2000
+#define LE_OBJ_CONFORMING   0x4000
+#define LE_OBJ_IOPL         0x8000
+
+enum exe_le_page_type {
+    LE_PAGE_LEGAL,
+    LE_PAGE_ITERATED,                   /* EXEPACK in LX */
+    LE_PAGE_INVALID,
+    LE_PAGE_ZEROFILL,
+    LE_PAGE_RANGE,
+    LE_PAGE_COMPRESSED                  /* EXEPACK2, LX only */
+};
+
+/*
+ * Fixup records. The source byte gives what is patched, the flags byte
+ * what it points at and how wide each of the fields after them is.
+ */
+enum exe_le_fixup_source {
+    LE_FIXUP_BYTE,
+    LE_FIXUP_SELECTOR16 = 2,
+    LE_FIXUP_FAR16,                     /* 16:16 pointer */
+    LE_FIXUP_OFFSET16 = 5,
+    LE_FIXUP_FAR48,                     /* 16:32 pointer */
+    LE_FIXUP_OFFSET32,
+    LE_FIXUP_RELATIVE32                 /* 32-bit offset from the end of the location */
+};
+
+#define LE_FIXUP_SOURCE_MASK    0x0F
+#define LE_FIXUP_ALIAS          0x10    /* 16:16 alias of a 32-bit object */
+#define LE_FIXUP_LIST           0x20    /* a count and a list of source offsets instead of one */
+
+enum exe_le_fixup_target {
+    LE_TARGET_INTERNAL,
+    LE_TARGET_IMPORD,
+    LE_TARGET_IMPNAME,
+    LE_TARGET_ENTRY                     /* internal, through the entry table */
+};
+
+#define LE_TARGET_MASK          0x03
+#define LE_TARGET_ADDITIVE      0x04
+#define LE_TARGET_CHAIN         0x08    /* LX internal chaining */
+#define LE_TARGET_OFFSET32      0x10    /* 32-bit target offset or imported ordinal */
+#define LE_TARGET_ADDITIVE32    0x20
+#define LE_TARGET_OBJECT16      0x40    /* 16-bit object number or module ordinal */
+#define LE_TARGET_ORDINAL8      0x80    /* 8-bit imported ordinal */
+
+enum exe_le_bundle_type {
+    LE_BUNDLE_UNUSED,
+    LE_BUNDLE_ENTRY16,
+    LE_BUNDLE_GATE286,
+    LE_BUNDLE_ENTRY32,
+    LE_BUNDLE_FORWARDER                 /* LX only */
+};
+
+#define LE_BUNDLE_TYPE_MASK 0x7F
+#define LE_ENTRY_EXPORTED   0x01
+#define LE_ENTRY_SHARED     0x02        /* uses a shared data segment */
+#define LE_ENTRY_BYORDINAL  0x01        /* forwarders: import by ordinal rather than name */
+
+enum exe_le_module_type {
+    LE_MOD_PROGRAM,
+    LE_MOD_LIBRARY,
+    LE_MOD_PROTLIBRARY = 3,
+    LE_MOD_PDD,
+    LE_MOD_VDD
+};
+
 enum exe_le_header_cputypes {
     CPU_286 = 1,
     CPU_386,
@@ -111,8 +246,12 @@ enum exe_le_header_cputypes {
 };
 
 enum exe_le_ostypes {
-    LE_OS_OS2 = 1,
-    LE_OS_WINDOWS = 4
+    LE_OS_UNKNOWN,
+    LE_OS_OS2,
+    LE_OS_WIN16,
+    LE_OS_DOS4,
+    LE_OS_WINDOWS,
+    LE_OS_PN
 };
 
 #endif /* LE_H */
@@ -0,0 +1,3209 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd 
+ * libreadexe.c - MZ, NE, LE/LX, W3 and PE parsers, without any output
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE 
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY 
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER 
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING 
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* Map the whole file where we can; everything else reads it into one buffer. */
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# define USE_MMAP
+#elif !defined(HAVE_CONFIG_H) && (defined(__unix__) || defined(__APPLE__))
+# define USE_MMAP
+#endif
+
+#ifdef USE_MMAP
+# include <unistd.h>
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+#endif
+
+#include "readexe.h"
+#include "pool.h"
+
+/*
+ * The arena is a list of chunks handed out front to back. Requests too
+ * big to share a chunk get one of their own, linked in behind the
+ * current chunk so that its free space is not thrown away.
+ */
+#define ARENA_CHUNK 8192
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;                            /* usable bytes behind the header */
+    size_t used;
+};
+
+#define ARENA_HEADER ARENA_ROUND(sizeof(struct arena_chunk))
+
+void *arena_alloc(struct arena *arena, size_t size) {
+    struct arena_chunk *c = arena->head;
+    size_t want;
+    void *p;
+
+    if (size > SIZE_MAX - ARENA_HEADER - ARENA_ALIGN) return NULL;
+    size = size ? ARENA_ROUND(size) : ARENA_ALIGN;
+    if (!c || c->size - c->used < size) {
+        want = size > ARENA_CHUNK / 4 ? size : ARENA_CHUNK - ARENA_HEADER;
+        if (!(c = malloc(ARENA_HEADER + want))) return NULL;
+        arena->allocs++;
+        c->size = want;
+        c->used = 0;
+        if (want == size && arena->head) {
+            c->next = arena->head->next;
+            arena->head->next = c;
+        } else {
+            c->next = arena->head;
+            arena->head = c;
+        }
+    }
+    p = (char *) c + ARENA_HEADER + c->used;
+    c->used += size;
+    return p;
+}
+
+void *arena_calloc(struct arena *arena, size_t count, size_t size) {
+    void *p;
+
+    if (size && count > SIZE_MAX / size) return NULL;
+    if ((p = arena_alloc(arena, count * size))) memset(p, 0, count * size);
+    return p;
+}
+
+void arena_free(struct arena *arena) {
+    struct arena_chunk *c, *next;
+
+    for (c = arena->head; c; c = next) {
+        next = c->next;
+        free(c);
+    }
+    arena->head = NULL;
+    arena->allocs = 0;
+}
+
+/* Records a problem with the file. Parsing carries on with whatever could be read. */
+static void exe_warn(struct THIS *this, int code, const char *format, ...) {
+    struct exe_diag *d;
+    va_list ap;
+    int n;
+
+    if (!this->status) this->status = code;
+    va_start(ap, format);
+    n = vsnprintf(NULL, 0, format, ap);
+    va_end(ap);
+    if (n < 0 || !(d = arena_alloc(&this->arena, sizeof(struct exe_diag) + n))) return;
+    d->next = NULL;
+    d->code = code;
+    va_start(ap, format);
+    vsnprintf(d->msg, n + 1, format, ap);
+    va_end(ap);
+    *this->diagTail = d;
+    this->diagTail = &d->next;
+}
+
+static void exe_nomem(struct THIS *this) {
+    exe_warn(this, EXE_ERR_NOMEM, "Cannot allocate memory: %s", this->fname);
+}
+
+const char *const exe_phase_names[EXE_PHASE_COUNT] = {
+    "other", "map", "mz", "mz.relocs", "next", "ne", "ne.segments", "ne.imports", "ne.relocs", "ne.resources", "ne.exports", "le", "le.fixups", "w3", "pe", "output"
+};
+
+static uint64_t exe_clock(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_MONOTONIC, &ts)) return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+    return (uint64_t) clock() * (1000000000 / CLOCKS_PER_SEC);
+}
+
+/* Charges what happened since the last switch to the current phase and makes phase current, counting it as entered unless resuming. */
+static void exe_phase_switch(struct THIS *this, int phase, int resuming) {
+    struct exe_phase_stats *s = &this->stats->phase[this->phase];
+    uint64_t t = exe_clock();
+
+    /* Nothing to time against on the first call. */
+    if (this->phaseStart) s->ns += t - this->phaseStart;
+    s->allocs += this->arena.allocs - this->phaseAllocs;
+    s->syscalls += this->syscalls - this->phaseSyscalls;
+    this->phaseStart = t;
+    this->phaseAllocs = this->arena.allocs;
+    this->phaseSyscalls = this->syscalls;
+    if (phase != this->phase && !resuming) this->stats->phase[phase].entered++;
+}
+
+/*
+ * Makes phase (EXE_PHASE_*) the one being charged and returns the one
+ * that was, so the caller can switch back. Switching to the current phase
+ * brings this->stats up to date. Without this->stats this is all it does.
+ */
+int exe_phase(struct THIS *this, int phase) {
+    int prev = this->phase;
+
+    if (this->stats) exe_phase_switch(this, phase, 0);
+    this->phase = phase;
+    return prev;
+}
+
+/* Goes back to the phase exe_phase() returned. */
+static void exe_phase_resume(struct THIS *this, int phase) {
+    if (this->stats) exe_phase_switch(this, phase, 1);
+    this->phase = phase;
+}
+
+/* Runs call with its costs charged to phase. */
+#define IN_PHASE(this, phase, call) do { int prev_ = exe_phase(this, phase); call; exe_phase_resume(this, prev_); } while (0)
+
+/*
+ * Loads the whole of this->fname into this->base. Returns 0 on success or
+ * -1 with errno set. Every system call made here and in unmap_file() is
+ * counted in this->syscalls (stdio calls count as one each); the buffer
+ * malloc()'d when mmap() is not available counts towards arena.allocs.
+ */
+static int map_file_image(struct THIS *this) {
+#ifdef USE_MMAP
+    struct stat st;
+    void *p;
+    int fd;
+
+    this->syscalls += 2;                    /* open() and close() */
+    if ((fd = open(this->fname, O_RDONLY)) == -1) return -1;
+    this->syscalls++;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    if ((uintmax_t) st.st_size > SIZE_MAX) {
+        close(fd);
+        errno = EFBIG;
+        return -1;
+    }
+    this->size = (size_t) st.st_size;
+    if (this->size) {
+        this->syscalls++;
+        if ((p = mmap(NULL, this->size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        this->base = p;
+        this->mapped = 1;
+    }
+    close(fd);
+    return 0;
+#else
+    FILE *fp;
+    uint8_t *buf = NULL;
+    long len;
+
+    this->syscalls += 2;                    /* fopen() and fclose() */
+    if (!(fp = fopen(this->fname, "rb"))) return -1;
+    this->syscalls += 3;
+    if (fseek(fp, 0, SEEK_END) || (len = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET)) {
+        fclose(fp);
+        return -1;
+    }
+    if ((unsigned long) len > SIZE_MAX) {
+        fclose(fp);
+        errno = ENOMEM;
+        return -1;
+    }
+    if (len) {
+        if (!(buf = malloc((size_t) len))) {
+            fclose(fp);
+            errno = ENOMEM;
+            return -1;
+        }
+        this->arena.allocs++;
+        this->syscalls++;
+        if (fread(buf, 1, (size_t) len, fp) != (size_t) len) {
+            free(buf);
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    this->base = buf;
+    this->size = (size_t) len;
+    return 0;
+#endif
+}
+
+int map_file(struct THIS *this) {
+    int ret;
+
+    IN_PHASE(this, EXE_PHASE_MAP, ret = map_file_image(this));
+    return ret;
+}
+
+#define STREAM_ALL UINT64_MAX                /* stream_extent(): read up to the end of the stream */
+#define STREAM_LIMIT 0xFFFFFFFFUL            /* view_at() offsets are 32-bit, so nothing past this is read */
+#define STREAM_MAX(e, x) do { uint64_t x_ = (x); if (x_ > (e)) (e) = x_; } while (0)
+
+/*
+ * How many bytes from the start of the file the tables in this->need
+ * reach, going by the len bytes at p read so far. The answer only grows
+ * as more is read: each header says where the tables behind it are, and
+ * NE relocation blocks say how long they are. This follows the same
+ * rules the parsers below use to find each table.
+ */
+static uint64_t stream_extent(const struct THIS *this, const uint8_t *p, size_t len) {
+    const struct exe_mz_header *mz;
+    const struct exe_ne_header *ne;
+    const struct exe_ne_segment *seg;
+    const struct exe_le_header *le;
+    uint64_t e = sizeof(struct exe_mz_header), hdr, segtab, off;
+    int i;
+
+    if (this->need & NEED_FILE) return STREAM_ALL;
+    if (len < e) return e;
+    mz = (const struct exe_mz_header *) p;
+    if ((mz->magic[0] == 'M' && mz->magic[1] == 'Z') || (mz->magic[0] == 'Z' && mz->magic[1] == 'M')) {
+        if (this->need & NEED_MZ_RELOCS) STREAM_MAX(e, mz->relocationOffset + (uint64_t) sizeof(struct exe_mz_reloc) * mz->relocationEntries);
+        if (this->need & NEED_MZ_PACKER) {
+            STREAM_MAX(e, 0x1C + 8);        /* LZEXE's and PKLITE's signatures */
+            off = ((uint64_t) mz->hdrSize + mz->initCodeSeg) * 16;
+            STREAM_MAX(e, off + (mz->initInstPtr > sizeof(struct exe_lzexe_header) ? mz->initInstPtr : sizeof(struct exe_lzexe_header)));
+        }
+    } else if (this->noffset == -1) return e;
+    if (!(this->need & NEED_NEXT)) return e;
+    if (this->noffset != -1) hdr = (uint32_t) this->noffset;
+    else if (mz->relocationOffset < 0x40) return e;
+    else {
+        STREAM_MAX(e, sizeof(struct exe_mz_header) + sizeof(struct exe_mz_new_header));
+        if (len < sizeof(struct exe_mz_header) + sizeof(struct exe_mz_new_header)) return e;
+        hdr = ((const struct exe_mz_new_header *) (p + sizeof(struct exe_mz_header)))->nextHeader;
+    }
+    STREAM_MAX(e, hdr + 2);
+    if (len < hdr + 2) return e;
+
+    if (p[hdr] == 'N' && p[hdr + 1] == 'E') {
+        STREAM_MAX(e, hdr + sizeof(struct exe_ne_header));
+        if (len < hdr + sizeof(struct exe_ne_header)) return e;
+        ne = (const struct exe_ne_header *) (p + hdr);
+        segtab = hdr + ne->segmentTableOffset + (uint64_t) sizeof(struct exe_ne_segment) * ne->segmentCount;
+        if (this->need & (NEED_NE_SEGMENTS | NEED_NE_RELOCS)) STREAM_MAX(e, segtab);
+        if (this->need & NEED_NE_NAMES) {
+            STREAM_MAX(e, hdr + ne->modulesTableOffset + (uint64_t) sizeof(uint16_t) * ne->modRefCount);
+            STREAM_MAX(e, hdr + (ne->entryTableOffset > ne->importedNamesTableOffset ? ne->entryTableOffset : ne->importedNamesTableOffset + 0x10000));
+        }
+        if ((this->need & NEED_NE_RESOURCES) && ne->resourceTableOffset != ne->residentNamesTableOffset)
+            STREAM_MAX(e, hdr + (ne->residentNamesTableOffset > ne->resourceTableOffset ? ne->residentNamesTableOffset : ne->resourceTableOffset + 0x10000));
+        if (this->need & NEED_NE_EXPORTS) {
+            STREAM_MAX(e, hdr + ne->entryTableOffset + ne->entryTableSize);
+            STREAM_MAX(e, hdr + (ne->modulesTableOffset > ne->residentNamesTableOffset ? ne->modulesTableOffset : ne->residentNamesTableOffset + 0x10000));
+            if (ne->nonResidentTableOffset) STREAM_MAX(e, (uint64_t) ne->nonResidentTableOffset + ne->nonResidentTableSize);
+        }
+        /* Each relocation block follows its segment's data and starts with its count. */
+        if ((this->need & NEED_NE_RELOCS) && len >= segtab && ne->offsetShiftCount <= 31) {
+            for (i = 0; i < ne->segmentCount; i++) {
+                seg = (const struct exe_ne_segment *) (p + hdr + ne->segmentTableOffset) + i;
+                if (!seg->relocations || !seg->segmentOffset) continue;
+                off = ((uint64_t) seg->segmentOffset << ne->offsetShiftCount) + (seg->segmentSize ? seg->segmentSize : 0x10000);
+                STREAM_MAX(e, off + sizeof(uint16_t));
+                if (len >= off + sizeof(uint16_t))
+                    STREAM_MAX(e, off + sizeof(uint16_t) + (uint64_t) sizeof(struct exe_ne_reloc) * *(const uint16_t *) (p + off));
+            }
+        }
+    } else if (p[hdr] == 'L' && (p[hdr + 1] == 'E' || p[hdr + 1] == 'X')) {
+        /* le_load() decodes its tables whenever asked, so all of them are read. */
+        STREAM_MAX(e, hdr + sizeof(struct exe_le_header));
+        if (len < hdr + sizeof(struct exe_le_header)) return e;
+        le = (const struct exe_le_header *) (p + hdr);
+        STREAM_MAX(e, hdr + le->objectTableOffset + le->loaderSize);
+        STREAM_MAX(e, hdr + le->fixupPageTableOffset + le->fixupSize);
+        if (le->nonresidentNameTableOffset) STREAM_MAX(e, (uint64_t) le->nonresidentNameTableOffset + le->nonresidentNameTableSize);
+    } else if ((p[hdr] == 'P' && p[hdr + 1] == 'E') || (p[hdr] == 'W' && (p[hdr + 1] == '3' || p[hdr + 1] == '4'))) {
+        /* PE tables are found by RVA inside section data, and W3/W4 modules are the rest of the file. */
+        return STREAM_ALL;
+    }
+    return e;
+}
+
+/*
+ * Reads fp from where it is, forward only and once, as far as the tables
+ * this->need asks for reach, leaving the rest of the stream unread. Like
+ * map_file_image(), returns 0 or -1 with errno set.
+ */
+static int map_stream_image(struct THIS *this, FILE *fp) {
+    uint8_t *buf = NULL, *grown;
+    size_t len = 0, cap = 0, got, n;
+    uint64_t want, grow;
+
+    for (;;) {
+        if ((want = stream_extent(this, buf, len)) <= len || len >= STREAM_LIMIT) break;
+        if (len == cap) {
+            /*
+             * The plan comes from header fields a corrupt file can set to
+             * anything, so it only says when to stop: the buffer doubles
+             * as data actually arrives.
+             */
+            grow = cap ? (uint64_t) cap * 2 : 0x1000;
+            if (grow > want) grow = want;
+            if (grow > STREAM_LIMIT) grow = STREAM_LIMIT;
+            if (grow > SIZE_MAX || !(grown = realloc(buf, (size_t) grow))) {
+                free(buf);
+                errno = ENOMEM;
+                return -1;
+            }
+            this->arena.allocs++;
+            buf = grown;
+            cap = (size_t) grow;
+        }
+        n = want - len < cap - len ? (size_t) (want - len) : cap - len;
+        this->syscalls++;
+        if (!(got = fread(buf + len, 1, n, fp))) {
+            if (ferror(fp)) {
+                free(buf);
+                return -1;
+            }
+            break;
+        }
+        len += got;
+    }
+    this->base = buf;
+    this->size = len;
+    return 0;
+}
+
+/*
+ * Like map_file(), but for a pipe or anything else that cannot seek or
+ * be mapped. Only the start of the file that this->need calls for is
+ * kept: the tables of an NE or LE/LX file without their data unless
+ * NEED_FILE is asked for, and the whole of anything else.
+ */
+int map_stream(struct THIS *this, FILE *fp) {
+    int ret;
+
+    IN_PHASE(this, EXE_PHASE_MAP, ret = map_stream_image(this, fp));
+    return ret;
+}
+
+void unmap_file(struct THIS *this) {
+    int prev = exe_phase(this, EXE_PHASE_MAP);
+
+#ifdef USE_MMAP
+    if (this->mapped) {
+        munmap((void *) this->base, this->size);
+        this->syscalls++;
+    }
+#endif
+    if (!this->mapped) free((void *) this->base);
+    this->base = NULL;
+    this->size = 0;
+    this->mapped = 0;
+    exe_phase_resume(this, prev);
+}
+
+/* Bounds-checked pointer to len bytes at offset in the file image, or NULL if that runs past the end. */
+const void *view_at(struct THIS *this, uint32_t offset, size_t len) {
+    if (this->stats) {
+        this->stats->phase[this->phase].views++;
+        this->stats->phase[this->phase].bytes += len;
+    }
+    if (offset > this->size || len > this->size - offset) return NULL;
+    return this->base + offset;
+}
+
+void read_ne_exe(struct THIS *this) {
+    if ((this->ne = view_at(this, this->mzx->nextHeader, sizeof(struct exe_ne_header)))) {
+        if (this->need & NEED_NE_NAMES) IN_PHASE(this, EXE_PHASE_NE_IMPORTS, read_ne_names(this));
+        if (this->need & (NEED_NE_SEGMENTS | NEED_NE_RELOCS)) IN_PHASE(this, EXE_PHASE_NE_SEGMENTS, read_ne_segments(this));
+        if (this->need & NEED_NE_RELOCS) IN_PHASE(this, EXE_PHASE_NE_RELOCS, read_ne_relocs(this));
+        if (this->need & NEED_NE_RESOURCES) IN_PHASE(this, EXE_PHASE_NE_RESOURCES, read_ne_resources(this));
+        if (this->need & NEED_NE_EXPORTS) IN_PHASE(this, EXE_PHASE_NE_EXPORTS, read_ne_exports(this));
+    } else exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+    return;
+}
+
+void read_ne_segments(struct THIS *this) {
+    if (!(this->nesegs = view_at(this, this->mzx->nextHeader + this->ne->segmentTableOffset, sizeof(struct exe_ne_segment) * this->ne->segmentCount)))
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+}
+
+/* File offset of NE segment i's data, or 0 if it has none in the file. */
+uint32_t ne_segment_offset(struct THIS *this, int i) {
+    if (this->ne->offsetShiftCount > 31) return 0;
+    return (uint32_t) this->nesegs[i].segmentOffset << this->ne->offsetShiftCount;
+}
+
+/* Bytes of NE segment i's data present in the file; a stored size of zero means 64K unless the segment has no data at all. */
+uint32_t ne_segment_size(struct THIS *this, int i) {
+    if (!this->nesegs[i].segmentOffset) return 0;
+    return this->nesegs[i].segmentSize ? this->nesegs[i].segmentSize : 0x10000;
+}
+
+/* Formats MODULE.ordinal or MODULE.NAME for an imported reference into buf, which should hold NE_IMPORT_REF_MAX bytes. */
+const char *ne_import_ref(struct THIS *this, uint16_t module, int byname, uint16_t value, char *buf) {
+    const struct exe_ne_import *imp;
+    int n;
+
+    if (module >= 1 && module <= this->ne_moduleCount)
+        n = sprintf(buf, "%.*s", this->nemods[module - 1].size, this->nemods[module - 1].name);
+    else
+        n = sprintf(buf, "#%"PRIu16, module);
+    if (!byname)
+        sprintf(buf + n, ".%"PRIu16, value);
+    else if ((imp = get_ne_import(this, value)))
+        sprintf(buf + n, ".%.*s", imp->size, imp->name);
+    else
+        sprintf(buf + n, ".<name at 0x%04"PRIx16">", value);
+    return buf;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Picks the (up to) NE_TOP_IMPORTS most referenced imports out of a segment's relocations, using keys (sr->count entries) as scratch. */
+static void ne_top_imports(struct ne_segrelocs *sr, uint32_t *keys) {
+    const struct exe_ne_reloc *r = sr->relocs;
+    unsigned long run;
+    int i, j, n = 0;
+
+    for (i = 0; i < sr->count; i++)
+        if ((r[i].relocationType & RELTYPE_MASK) == RELTYPE_IMPORD || (r[i].relocationType & RELTYPE_MASK) == RELTYPE_IMPNAME)
+            keys[n++] = NE_IMPORT_KEY(r[i].moduleReference, (r[i].relocationType & RELTYPE_MASK) == RELTYPE_IMPNAME, r[i].importOrdinal);
+    qsort(keys, n, sizeof(uint32_t), compare_u32);
+    for (i = 0; i < n; i += run) {
+        for (run = 1; i + run < (unsigned long) n && keys[i + run] == keys[i]; run++);
+        /* Insertion into the short top list, most referenced first. */
+        for (j = sr->ntop; j > 0 && sr->topcount[j - 1] < run; j--) {
+            if (j < NE_TOP_IMPORTS) {
+                sr->top[j] = sr->top[j - 1];
+                sr->topcount[j] = sr->topcount[j - 1];
+            }
+        }
+        if (j < NE_TOP_IMPORTS) {
+            sr->top[j] = keys[i];
+            sr->topcount[j] = run;
+            if (sr->ntop < NE_TOP_IMPORTS) sr->ntop++;
+        }
+    }
+}
+
+/*
+ * Decodes the relocation block that follows each segment's data. The
+ * whole block is taken from the file view in one go; the counts by type
+ * and the number of locations patched (following the chains through the
+ * segment data for non-additive fixups) are kept in this->nerelocs.
+ */
+void read_ne_relocs(struct THIS *this) {
+    const uint16_t *count;
+    const uint8_t *data;
+    const struct exe_ne_reloc *r;
+    struct ne_segrelocs *sr;
+    uint32_t segoff, segsz, off, steps, *keys = NULL;
+    int i, j, width, nkeys = 0;
+
+    if (!this->nesegs || !this->ne->segmentCount) return;
+    if (!(this->nerelocs = arena_calloc(&this->arena, this->ne->segmentCount, sizeof(struct ne_segrelocs)))) {
+        exe_nomem(this);
+        return;
+    }
+    for (i = 0; i < this->ne->segmentCount; i++) {
+        sr = &this->nerelocs[i];
+        if (!this->nesegs[i].relocations || !(segoff = ne_segment_offset(this, i))) continue;
+        segsz = ne_segment_size(this, i);
+        if (!(count = view_at(this, segoff + segsz, sizeof(uint16_t)))
+            || !(sr->relocs = view_at(this, segoff + segsz + sizeof(uint16_t), sizeof(struct exe_ne_reloc) * *count))) {
+            exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+            continue;
+        }
+        sr->present = 1;
+        sr->count = *count;
+        sr->fileOffset = segoff + segsz;
+        data = view_at(this, segoff, segsz);
+        for (j = 0; j < sr->count; j++) {
+            r = &sr->relocs[j];
+            sr->byType[r->relocationType & RELTYPE_MASK]++;
+            if (r->relocationType & RELFLAG_ADDITIVE) {
+                sr->additive++;
+                sr->sites++;
+                continue;
+            }
+            /* Follow the chain; a byte fixup has no room for a link. */
+            width = (r->addressType & RADDR_MASK) == RADDR_LOWBYTE ? 1 : 2;
+            for (off = r->offset, steps = 0; off != NE_RELOC_CHAIN_END && steps <= segsz; steps++) {
+                sr->sites++;
+                if (width == 1 || !data || off + 2 > segsz) break;
+                off = *(const uint16_t *) (data + off);
+            }
+        }
+        /* One scratch buffer for every segment, grown in the arena only when a bigger block turns up. */
+        if (sr->count > nkeys) {
+            if (!(keys = arena_alloc(&this->arena, sizeof(uint32_t) * sr->count))) {
+                exe_nomem(this);
+                return;
+            }
+            nkeys = sr->count;
+        }
+        if (sr->count) ne_top_imports(sr, keys);
+    }
+}
+
+/*
+ * Bytes an iterated segment's data expands to, walking the records in
+ * the len bytes at p; *bad is set if a record runs past the end.
+ */
+static uint32_t ne_iterated_size(const uint8_t *p, uint32_t len, int *bad) {
+    const struct exe_ne_iterated *it;
+    uint32_t pos, total = 0;
+
+    for (pos = 0; pos + sizeof(struct exe_ne_iterated) <= len; pos += sizeof(struct exe_ne_iterated) + it->byteCount) {
+        it = (const struct exe_ne_iterated *) (p + pos);
+        if (it->byteCount > len - pos - sizeof(struct exe_ne_iterated)) {
+            *bad = 1;
+            break;
+        }
+        total += (uint32_t) it->iterations * it->byteCount;
+        /* No segment is bigger than 64K, so anything past that is nonsense. */
+        if (total > 0x10000) {
+            *bad = 1;
+            return 0x10000;
+        }
+    }
+    return total;
+}
+
+/* Canonical stand-in for an imported name: 15 bits of its hash, so the same import comes out the same in every build. */
+static uint16_t ne_canon_name(const char *name, size_t len) {
+    return (uint16_t) (xxh64(name, len, 0) & 0x7FFF);
+}
+
+/*
+ * What relocation r points at, as selector and offset. Segments go by
+ * number and imports by the hashes of their names, with the top bit of
+ * the selector set; nothing depends on where the module is loaded. An
+ * import by ordinal keeps its ordinal as the offset. Returns 0, or -1 if
+ * r is an OS fixup or points at nothing this file describes.
+ */
+static int ne_reloc_target(struct THIS *this, const struct exe_ne_reloc *r, uint16_t *sel, uint32_t *off) {
+    const struct exe_ne_export *exp;
+    const struct exe_ne_import *imp;
+    const struct exe_ne_module *mod;
+
+    switch (r->relocationType & RELTYPE_MASK) {
+        case RELTYPE_INTREF:
+            if (r->segment != NE_MOVABLE_SEGMENT) {
+                if (!r->segment || r->segment > this->ne->segmentCount) return -1;
+                *sel = r->segment;
+                *off = r->ordinal;
+            } else {
+                if (!(exp = ne_export(this, r->ordinal))) return -1;
+                *sel = exp->segment == NE_BUNDLE_CONSTANT ? 0 : exp->segment;
+                *off = exp->offset;
+            }
+            return 0;
+        case RELTYPE_IMPORD:
+        case RELTYPE_IMPNAME:
+            if (!r->moduleReference || r->moduleReference > this->ne_moduleCount) return -1;
+            mod = &this->nemods[r->moduleReference - 1];
+            *sel = 0x8000 | ne_canon_name(mod->name, mod->size);
+            if ((r->relocationType & RELTYPE_MASK) == RELTYPE_IMPORD) *off = r->importOrdinal;
+            else if ((imp = get_ne_import(this, r->importNameOffset))) *off = ne_canon_name(imp->name, imp->size);
+            else return -1;
+            return 0;
+        default:
+            /* The x87 fixups depend on the machine the program runs on. */
+            return -1;
+    }
+}
+
+static uint32_t get_le(const uint8_t *p, int width) {
+    return width == 1 ? p[0] : width == 2 ? (uint32_t) (p[0] | p[1] << 8) : (uint32_t) (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24);
+}
+
+static void put_le(uint8_t *p, uint32_t v, int width) {
+    int i;
+
+    for (i = 0; i < width; i++, v >>= 8)
+        p[i] = (uint8_t) v;
+}
+
+/*
+ * Patches one location of img with sel:off the way the loader would:
+ * additive fixups add the offset to what is there, others replace it.
+ * Returns -1 if the location does not fit in the segment.
+ */
+static int ne_patch(struct ne_segimage *img, uint32_t at, uint8_t type, int additive, uint16_t sel, uint32_t off) {
+    uint32_t width;
+
+    switch (type & RADDR_MASK) {
+        case RADDR_LOWBYTE:
+        case RADDR_OFFSET16:
+        case RADDR_OFFSET32:
+            width = (type & RADDR_MASK) == RADDR_LOWBYTE ? 1 : (type & RADDR_MASK) == RADDR_OFFSET16 ? 2 : 4;
+            if (at > img->size || width > img->size - at) return -1;
+            put_le(img->data + at, additive ? get_le(img->data + at, width) + off : off, width);
+            return 0;
+        case RADDR_SELECTOR:
+            if (at > img->size || 2 > img->size - at) return -1;
+            put_le(img->data + at, additive ? get_le(img->data + at, 2) + sel : sel, 2);
+            return 0;
+        case RADDR_POINTER32:
+        case RADDR_POINTER48:
+            width = (type & RADDR_MASK) == RADDR_POINTER32 ? 2 : 4;
+            if (at > img->size || width + 2 > img->size - at) return -1;
+            put_le(img->data + at, additive ? get_le(img->data + at, width) + off : off, width);
+            put_le(img->data + at + width, sel, 2);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/*
+ * Builds segment i's image. Runs on a worker thread, so it takes the data
+ * ne_load_segments() has already viewed and leaves warnings and stats to
+ * it. A segment whose data is not all in the file stays zero-filled, and
+ * its relocations are not applied.
+ */
+static void ne_load_segment(void *ctx, int i, int worker) {
+    struct THIS *this = ctx;
+    struct ne_segimage *img = &this->neimages[i];
+    const struct ne_segrelocs *sr = this->nerelocs ? &this->nerelocs[i] : NULL;
+    const struct exe_ne_reloc *r;
+    const struct exe_ne_iterated *it;
+    const uint8_t *src = img->src;
+    uint32_t len = img->srcSize, pos, out, at, next, steps, off, n;
+    uint16_t sel;
+    int j;
+
+    (void) worker;
+    if (!img->data || !src) return;
+    if (this->nesegs[i].iterated) {
+        for (pos = out = 0; pos + sizeof(struct exe_ne_iterated) <= len; pos += sizeof(struct exe_ne_iterated) + it->byteCount) {
+            it = (const struct exe_ne_iterated *) (src + pos);
+            if (it->byteCount > len - pos - sizeof(struct exe_ne_iterated)) break;
+            for (n = 0; n < it->iterations && it->byteCount <= img->dataSize - out; n++, out += it->byteCount)
+                memcpy(img->data + out, src + pos + sizeof(struct exe_ne_iterated), it->byteCount);
+        }
+    } else if (img->dataSize) memcpy(img->data, src, img->dataSize);
+
+    for (j = 0; sr && sr->present && j < sr->count; j++) {
+        r = &sr->relocs[j];
+        if (ne_reloc_target(this, r, &sel, &off)) {
+            img->unresolved++;
+            continue;
+        }
+        if (r->relocationType & RELFLAG_ADDITIVE) {
+            if (ne_patch(img, r->offset, r->addressType, 1, sel, off)) img->bad = 1; else img->applied++;
+            continue;
+        }
+        /* Each location holds the offset of the next; read it before it is overwritten. */
+        for (at = r->offset, steps = 0; at != NE_RELOC_CHAIN_END && steps <= img->size; steps++, at = next) {
+            next = (r->addressType & RADDR_MASK) != RADDR_LOWBYTE && at + 2 <= img->size ? get_le(img->data + at, 2) : NE_RELOC_CHAIN_END;
+            if (ne_patch(img, at, r->addressType, 0, sel, off)) {
+                img->bad = 1;
+                break;
+            }
+            img->applied++;
+        }
+    }
+}
+
+/*
+ * Builds every segment as the loader would have it in memory, with the
+ * segments spread over up to nthreads threads: iterated data expanded,
+ * zero-filled up to the minimum allocation and every relocation that
+ * can be resolved within the file applied (see ne_reloc_target()). The
+ * images go in this->neimages. Needs the relocations, imported names and
+ * entry table (NEED_NE_RELOCS, NEED_NE_NAMES, NEED_NE_EXPORTS). Returns
+ * this->status.
+ */
+int ne_load_segments(struct THIS *this, int nthreads) {
+    struct ne_segimage *img;
+    const uint8_t *src;
+    uint32_t len, minalloc;
+    uint64_t total = 0;
+    uint8_t *data;
+    int i, prev;
+
+    if (this->neimages || !this->ne || !this->nesegs || !this->ne->segmentCount) return this->status;
+    prev = exe_phase(this, EXE_PHASE_NE_SEGMENTS);
+    if (!(this->neimages = arena_calloc(&this->arena, this->ne->segmentCount, sizeof(struct ne_segimage)))) {
+        exe_nomem(this);
+        exe_phase_resume(this, prev);
+        return this->status;
+    }
+    /* Sizes first, so that the images are a single allocation that the workers only write into. */
+    for (i = 0; i < this->ne->segmentCount; i++) {
+        img = &this->neimages[i];
+        len = ne_segment_offset(this, i) ? ne_segment_size(this, i) : 0;
+        if (len && !(src = view_at(this, ne_segment_offset(this, i), len))) {
+            exe_warn(this, EXE_ERR_TRUNCATED, "Segment %d runs past end of file: %s", i, this->fname);
+            len = 0;
+        }
+        img->src = len ? src : NULL;
+        img->srcSize = len;
+        img->dataSize = this->nesegs[i].iterated && len ? ne_iterated_size(src, len, &img->bad) : len;
+        minalloc = this->nesegs[i].minimumAllocation ? this->nesegs[i].minimumAllocation : 0x10000;
+        img->size = img->dataSize > minalloc ? img->dataSize : minalloc;
+        total += img->size;
+    }
+    if (!(data = arena_calloc(&this->arena, total ? total : 1, 1))) {
+        exe_nomem(this);
+        exe_phase_resume(this, prev);
+        return this->status;
+    }
+    for (i = 0; i < this->ne->segmentCount; i++, data += this->neimages[i - 1].size)
+        this->neimages[i].data = data;
+    pool_run(this->ne->segmentCount, nthreads, ne_load_segment, this);
+
+    for (i = 0; i < this->ne->segmentCount; i++)
+        if (this->neimages[i].bad) exe_warn(this, EXE_ERR_MALFORMED, "Bad data or relocations in segment %d of %s", i, this->fname);
+    exe_phase_resume(this, prev);
+    return this->status;
+}
+
+/* Finds the imported names table entry that starts at offset, or NULL. */
+const struct exe_ne_import *get_ne_import(struct THIS *this, uint16_t offset) {
+    int lo = 0, hi = this->ne_importCount - 1, mid;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (this->neimps[mid].offset == offset) return &this->neimps[mid];
+        if (this->neimps[mid].offset < offset) lo = mid + 1; else hi = mid - 1;
+    }
+    return NULL;
+}
+
+/*
+ * Indexes the module reference and imported names tables in one pass each.
+ * Names point straight into the file image and are not NUL-terminated, so
+ * print them with "%.*s". Relocations name their imports by offset into the
+ * imported names table, which get_ne_import() resolves without touching the
+ * file again.
+ */
+void read_ne_names(struct THIS *this) {
+    const uint16_t *modtab;
+    const uint8_t *names;
+    uint32_t start, end, pos;
+    int i;
+
+    start = this->mzx->nextHeader + this->ne->importedNamesTableOffset;
+    /* The imported names table has no size of its own; it runs up to the entry table. */
+    if (this->ne->entryTableOffset > this->ne->importedNamesTableOffset)
+        end = this->mzx->nextHeader + this->ne->entryTableOffset;
+    else
+        end = start + 0x10000;
+    if (end > this->size) end = this->size;
+    if (start > end) start = end;
+    names = view_at(this, start, end - start);
+
+    /* Entries are counted first so the index is a single allocation. */
+    for (pos = 0, i = 0; names && pos < end - start; pos += 1 + names[pos])
+        if (names[pos] && pos + 1 + names[pos] <= end - start) i++;
+    if (i && !(this->neimps = arena_calloc(&this->arena, i, sizeof(struct exe_ne_import)))) {
+        exe_nomem(this);
+        return;
+    }
+    for (pos = 0, this->ne_importCount = 0; names && pos < end - start; pos += 1 + names[pos]) {
+        if (!names[pos] || pos + 1 + names[pos] > end - start) continue;
+        this->neimps[this->ne_importCount].size = names[pos];
+        this->neimps[this->ne_importCount].offset = pos;
+        this->neimps[this->ne_importCount].name = (const char *) names + pos + 1;
+        this->ne_importCount++;
+    }
+
+    if (!this->ne->modRefCount) return;
+    if (!(modtab = view_at(this, this->mzx->nextHeader + this->ne->modulesTableOffset, sizeof(uint16_t) * this->ne->modRefCount))) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+        return;
+    }
+    if (!(this->nemods = arena_calloc(&this->arena, this->ne->modRefCount, sizeof(struct exe_ne_module)))) {
+        exe_nomem(this);
+        return;
+    }
+    this->ne_moduleCount = this->ne->modRefCount;
+    for (i = 0; i < this->ne_moduleCount; i++) {
+        this->nemods[i].offset = modtab[i];
+        /* Module names normally sit on an entry boundary; decode in place if some linker thought otherwise. */
+        if (names && modtab[i] < end - start && (uint32_t) modtab[i] + 1 + names[modtab[i]] <= end - start) {
+            this->nemods[i].size = names[modtab[i]];
+            this->nemods[i].name = (const char *) names + modtab[i] + 1;
+        } else {
+            exe_warn(this, EXE_ERR_MALFORMED, "Bad module name offset 0x%04"PRIx16" in %s", modtab[i], this->fname);
+            this->nemods[i].size = 0;
+            this->nemods[i].name = "";
+        }
+    }
+}
+
+static const char *const ne_restype_names[RESTYPE_COUNT] = {
+    NULL, "RT_CURSOR", "RT_BITMAP", "RT_ICON", "RT_MENU", "RT_DIALOG", "RT_STRING", "RT_FONTDIR",
+    "RT_FONT", "RT_ACCELERATOR", "RT_RCDATA", "RT_MESSAGETABLE", "RT_GROUP_CURSOR", NULL,
+    "RT_GROUP_ICON", NULL, "RT_VERSION", "RT_DLGINCLUDE", NULL, "RT_PLUGPLAY", "RT_VXD",
+    "RT_ANICURSOR", "RT_ANIICON", "RT_HTML"
+};
+
+/* "RT_VERSION" and the like for a standard resource type, or NULL. */
+const char *ne_resource_type_name(uint16_t type) {
+    return type < RESTYPE_COUNT ? ne_restype_names[type] : NULL;
+}
+
+/*
+ * Parses len bytes at spec as a resource type or name: RT_VERSION and the
+ * like, a number (which may be written #16, as in .RC files), or anything
+ * else as a name. Returns 0, or -1 for a number that cannot be an ID.
+ */
+int ne_resource_key(const char *spec, size_t len, struct ne_reskey *key) {
+    size_t i, start = len && spec[0] == '#';
+    unsigned long n = 0;
+    uint16_t t;
+
+    key->id = 0;
+    key->name = NULL;
+    key->len = 0;
+    for (t = 1; t < RESTYPE_COUNT; t++) {
+        if (ne_restype_names[t] && strlen(ne_restype_names[t]) == len && !strncmp(ne_restype_names[t], spec, len)) {
+            key->id = t;
+            return 0;
+        }
+    }
+    for (i = start; i < len && spec[i] >= '0' && spec[i] <= '9'; i++)
+        if (n <= 0x7FFF) n = n * 10 + (spec[i] - '0');
+    if (len > start && i == len) {
+        if (!n || n > 0x7FFF) return -1;
+        key->id = (uint16_t) n;
+        return 0;
+    }
+    key->name = spec;
+    key->len = len;
+    return 0;
+}
+
+/* Numbers first and in order, then names without regard to case, as Windows finds them. */
+static int ne_reskey_cmp(uint16_t ida, const char *na, size_t la, uint16_t idb, const char *nb, size_t lb) {
+    size_t i;
+    int ca, cb;
+
+    if (!na || !nb) return !na && !nb ? (ida > idb) - (ida < idb) : na ? 1 : -1;
+    for (i = 0; i < la && i < lb; i++) {
+        ca = na[i] >= 'a' && na[i] <= 'z' ? na[i] - 'a' + 'A' : (unsigned char) na[i];
+        cb = nb[i] >= 'a' && nb[i] <= 'z' ? nb[i] - 'a' + 'A' : (unsigned char) nb[i];
+        if (ca != cb) return ca - cb;
+    }
+    return (la > lb) - (la < lb);
+}
+
+static int ne_resource_order(const struct ne_resource *r, const struct ne_reskey *type, const struct ne_reskey *name) {
+    int c = ne_reskey_cmp(r->type, r->typeName, r->typeNameLen, type->id, type->name, type->len);
+
+    if (c || !name) return c;
+    return ne_reskey_cmp(r->id, r->name, r->nameLen, name->id, name->name, name->len);
+}
+
+static int compare_ne_resource(const void *a, const void *b) {
+    const struct ne_resource *ra = a, *rb = b;
+    int c = ne_reskey_cmp(ra->type, ra->typeName, ra->typeNameLen, rb->type, rb->typeName, rb->typeNameLen);
+
+    if (!c) c = ne_reskey_cmp(ra->id, ra->name, ra->nameLen, rb->id, rb->name, rb->nameLen);
+    return c ? c : (ra->fileOffset > rb->fileOffset) - (ra->fileOffset < rb->fileOffset);
+}
+
+/* Decodes a typeID or resourceID: a number if the high bit is set, otherwise a name at that offset in the table. */
+static void ne_resource_id(struct THIS *this, const uint8_t *tab, uint32_t len, uint16_t value, uint16_t *id, const char **name, uint8_t *namelen) {
+    *id = 0;
+    *name = NULL;
+    *namelen = 0;
+    if (value & NE_RES_INTEGER) {
+        *id = value & ~NE_RES_INTEGER;
+    } else if (value < len && (uint32_t) value + 1 + tab[value] <= len) {
+        *name = (const char *) tab + value + 1;
+        *namelen = tab[value];
+    } else {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad resource name offset 0x%04"PRIx16" in %s", value, this->fname);
+        *name = "";
+    }
+}
+
+/*
+ * Indexes the resource table into this->neres, one entry per resource
+ * with the alignment shift already applied, sorted by type and then name
+ * so that ne_find_resources() is a binary search rather than a walk of
+ * the table. The table has no size of its own; it runs up to the
+ * resident names table.
+ */
+void read_ne_resources(struct THIS *this) {
+    const struct exe_ne_resource_infoblock *ti;
+    const struct exe_ne_resource_nameinfo *ni;
+    const uint8_t *tab;
+    struct ne_resource *r;
+    uint32_t start, len, pos;
+    int pass, n = 0, i;
+
+    /* Linkers point an empty resource table at the resident names table. */
+    if (this->ne->resourceTableOffset == this->ne->residentNamesTableOffset) return;
+    start = this->mzx->nextHeader + this->ne->resourceTableOffset;
+    if (this->ne->residentNamesTableOffset > this->ne->resourceTableOffset)
+        len = this->ne->residentNamesTableOffset - this->ne->resourceTableOffset;
+    else
+        len = 0x10000;
+    if (start > this->size) start = this->size;
+    if (len > this->size - start) len = this->size - start;
+    if (len < sizeof(uint16_t) || !(tab = view_at(this, start, len))) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+        return;
+    }
+    this->ne_resShift = *(const uint16_t *) tab;
+    if (this->ne_resShift > 16) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad resource alignment shift %"PRIu16" in %s", this->ne_resShift, this->fname);
+        return;
+    }
+
+    /* Resources are counted first so the index is a single allocation. */
+    for (pass = 0; pass < 2; pass++) {
+        if (pass) {
+            if (!n) return;
+            if (!(this->neres = arena_calloc(&this->arena, n, sizeof(struct ne_resource)))) {
+                exe_nomem(this);
+                return;
+            }
+            n = 0;
+        }
+        for (pos = sizeof(uint16_t); pos + sizeof(uint16_t) <= len; pos += sizeof(*ti) + ti->count * sizeof(*ni)) {
+            ti = (const struct exe_ne_resource_infoblock *) (tab + pos);
+            if (!ti->typeID) break;
+            if (len - pos < sizeof(*ti) || ti->count > (len - pos - sizeof(*ti)) / sizeof(*ni)) {
+                if (!pass) exe_warn(this, EXE_ERR_MALFORMED, "Resource table runs past the resident names table in %s", this->fname);
+                break;
+            }
+            ni = (const struct exe_ne_resource_nameinfo *) (ti + 1);
+            for (i = 0; pass && i < ti->count; i++) {
+                r = &this->neres[n + i];
+                ne_resource_id(this, tab, len, ti->typeID, &r->type, &r->typeName, &r->typeNameLen);
+                ne_resource_id(this, tab, len, ni[i].resourceID, &r->id, &r->name, &r->nameLen);
+                r->flags = ni[i].flags;
+                r->fileOffset = (uint32_t) ni[i].offset << this->ne_resShift;
+                r->size = (uint32_t) ni[i].length << this->ne_resShift;
+            }
+            n += ti->count;
+        }
+    }
+    this->ne_resourceCount = n;
+    qsort(this->neres, n, sizeof(struct ne_resource), compare_ne_resource);
+}
+
+/*
+ * The resources of the given type, and name unless that is NULL, as a run
+ * of *count entries in this->neres; NULL and 0 if there are none.
+ */
+const struct ne_resource *ne_find_resources(struct THIS *this, const struct ne_reskey *type, const struct ne_reskey *name, int *count) {
+    int lo = 0, hi = this->ne_resourceCount, mid, n;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (ne_resource_order(&this->neres[mid], type, name) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    for (n = 0; lo + n < this->ne_resourceCount && !ne_resource_order(&this->neres[lo + n], type, name); n++)
+        ;
+    *count = n;
+    return n ? &this->neres[lo] : NULL;
+}
+
+/* A resource's data, straight out of the file image; NULL if it runs past the end of the file. */
+const void *ne_resource_data(struct THIS *this, const struct ne_resource *res) {
+    const void *p;
+
+    if (!(p = view_at(this, res->fileOffset, res->size)))
+        exe_warn(this, EXE_ERR_TRUNCATED, "Resource runs past end of file: %s", this->fname);
+    return p;
+}
+
+/* Entry table bundles, expanded into this->neexps indexed by ordinal, unused ordinals included. */
+static void ne_read_entries(struct THIS *this) {
+    const uint8_t *p, *q;
+    struct exe_ne_export *exp;
+    uint32_t start, len, pos, step, ordinal;
+    int pass, i;
+
+    if (!this->ne->entryTableSize) return;
+    start = this->mzx->nextHeader + this->ne->entryTableOffset;
+    len = this->ne->entryTableSize;
+    if (start > this->size || len > this->size - start) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Entry table runs past end of file: %s", this->fname);
+        if (start > this->size) return;
+        len = this->size - start;
+    }
+    p = view_at(this, start, len);
+    /* The first pass finds the highest ordinal, so the array is a single allocation. */
+    for (pass = 0; pass < 2; pass++) {
+        if (pass) {
+            if (!this->ne_exportCount) return;
+            if (!(this->neexps = arena_calloc(&this->arena, this->ne_exportCount, sizeof(struct exe_ne_export)))) {
+                exe_nomem(this);
+                this->ne_exportCount = 0;
+                return;
+            }
+            for (i = 0; i < this->ne_exportCount; i++)
+                this->neexps[i].ordinal = i + 1;
+        }
+        for (pos = 0, ordinal = 1; pos + 2 <= len && p[pos]; pos += step) {
+            if (p[pos + 1] == NE_BUNDLE_UNUSED) {
+                ordinal += p[pos];
+                step = 2;
+                continue;
+            }
+            step = 2 + p[pos] * (p[pos + 1] == NE_BUNDLE_MOVABLE ? 6 : 3);
+            if (pos + step > len) {
+                if (!pass) exe_warn(this, EXE_ERR_MALFORMED, "Entry table bundle runs past end of table: %s", this->fname);
+                break;
+            }
+            if (ordinal + p[pos] - 1 > 0xFFFF) {
+                if (!pass) exe_warn(this, EXE_ERR_MALFORMED, "Too many entries in %s", this->fname);
+                break;
+            }
+            for (i = 0, q = p + pos + 2; pass && i < p[pos]; i++) {
+                exp = &this->neexps[ordinal + i - 1];
+                exp->flags = q[0];
+                if (p[pos + 1] == NE_BUNDLE_MOVABLE) {
+                    /* flags, INT 3Fh, segment, offset */
+                    exp->movable = 1;
+                    exp->segment = q[3];
+                    exp->offset = *(const uint16_t *) (q + 4);
+                    q += 6;
+                } else {
+                    exp->segment = p[pos + 1];
+                    exp->offset = *(const uint16_t *) (q + 1);
+                    q += 3;
+                }
+            }
+            ordinal += p[pos];
+            if (!pass && ordinal - 1 > (uint32_t) this->ne_exportCount) this->ne_exportCount = ordinal - 1;
+        }
+    }
+}
+
+/*
+ * Indexes a resident or non-resident names table: the first name (the
+ * module name or description) into *first, the rest into this->nenames
+ * from index n, or just counted while that is still NULL. Returns the new n.
+ */
+static int ne_read_name_table(struct THIS *this, uint32_t start, uint32_t len, int resident, struct exe_ne_name *first, int n) {
+    const uint8_t *p;
+    struct exe_ne_name *name;
+    uint32_t pos;
+    int seen = 0;
+
+    if (start > this->size) return n;
+    if (len > this->size - start) len = this->size - start;
+    if (!(p = view_at(this, start, len))) return n;
+    for (pos = 0; pos < len && p[pos] && pos + 3 + p[pos] <= len; pos += 3 + p[pos], seen++) {
+        if (!seen) name = first;
+        else if (this->nenames) name = &this->nenames[n++];
+        else {
+            n++;
+            continue;
+        }
+        name->size = p[pos];
+        name->name = (const char *) p + pos + 1;
+        name->ordinal = *(const uint16_t *) (p + pos + 1 + p[pos]);
+        name->resident = resident;
+    }
+    return n;
+}
+
+static uint32_t ne_name_hash(const char *name, size_t len) {
+    return (uint32_t) xxh64(name, len, 0);
+}
+
+/*
+ * Decodes the entry table into this->neexps, one entry per ordinal, and
+ * joins the resident and non-resident names to it. Names are also hashed
+ * into this->ne_nameHash, so that ne_export() and ne_export_name() are
+ * each a lookup rather than a walk of the tables.
+ */
+void read_ne_exports(struct THIS *this) {
+    struct exe_ne_export *exp;
+    const struct exe_ne_name *name;
+    uint32_t resstart, reslen, nrstart, nrlen, size, slot;
+    int pass, n = 0, i;
+
+    ne_read_entries(this);
+
+    /* The resident names table has no size of its own; it runs up to the module reference table. */
+    resstart = this->mzx->nextHeader + this->ne->residentNamesTableOffset;
+    if (this->ne->modulesTableOffset > this->ne->residentNamesTableOffset)
+        reslen = this->ne->modulesTableOffset - this->ne->residentNamesTableOffset;
+    else
+        reslen = 0x10000;
+    nrstart = this->ne->nonResidentTableOffset;
+    nrlen = nrstart ? this->ne->nonResidentTableSize : 0;
+    for (pass = 0; pass < 2; pass++) {
+        if (pass) {
+            if (!n) return;
+            if (!(this->nenames = arena_calloc(&this->arena, n, sizeof(struct exe_ne_name)))) {
+                exe_nomem(this);
+                return;
+            }
+        }
+        n = ne_read_name_table(this, resstart, reslen, 1, &this->ne_moduleName, 0);
+        n = ne_read_name_table(this, nrstart, nrlen, 0, &this->ne_description, n);
+    }
+    this->ne_nameCount = n;
+
+    for (size = 16; size < (uint32_t) n * 2; size <<= 1)
+        ;
+    if (!(this->ne_nameHash = arena_calloc(&this->arena, size, sizeof(uint32_t)))) {
+        exe_nomem(this);
+        return;
+    }
+    this->ne_nameHashMask = size - 1;
+    for (i = 0; i < n; i++) {
+        name = &this->nenames[i];
+        /* Resident names come first, so they win over a non-resident name for the same ordinal. */
+        if (name->ordinal && name->ordinal <= this->ne_exportCount) {
+            exp = &this->neexps[name->ordinal - 1];
+            if (!exp->name) {
+                exp->name = name->name;
+                exp->size = name->size;
+                exp->resident = name->resident;
+            }
+        }
+        for (slot = ne_name_hash(name->name, name->size) & this->ne_nameHashMask; this->ne_nameHash[slot]; slot = (slot + 1) & this->ne_nameHashMask)
+            ;
+        this->ne_nameHash[slot] = i + 1;
+    }
+}
+
+/* The entry for ordinal, or NULL if the entry table has no such ordinal in use. */
+const struct exe_ne_export *ne_export(struct THIS *this, uint16_t ordinal) {
+    if (!ordinal || ordinal > this->ne_exportCount || !this->neexps[ordinal - 1].segment) return NULL;
+    return &this->neexps[ordinal - 1];
+}
+
+/* The resident or non-resident name matching len bytes of name exactly, or NULL; its ordinal says which entry. */
+const struct exe_ne_name *ne_export_name(struct THIS *this, const char *name, size_t len) {
+    const struct exe_ne_name *cand;
+    uint32_t slot;
+
+    if (!this->ne_nameHash) return NULL;
+    for (slot = ne_name_hash(name, len) & this->ne_nameHashMask; this->ne_nameHash[slot]; slot = (slot + 1) & this->ne_nameHashMask) {
+        cand = &this->nenames[this->ne_nameHash[slot] - 1];
+        if (cand->size == len && !memcmp(cand->name, name, len)) return cand;
+    }
+    return NULL;
+}
+
+/* Pointer to len bytes at offset (from the LE header) within the loader and fixup sections, or NULL. */
+const void *le_at(struct THIS *this, uint32_t offset, size_t len) {
+    if (!this->leldr || offset > this->le_ldrSize || len > this->le_ldrSize - offset) return NULL;
+    return this->leldr + offset;
+}
+
+/*
+ * Takes the header, then the loader and fixup sections (which sit right
+ * behind it) as one view, so every table below is a bounds check and a
+ * pointer rather than a seek. Only the object table is decoded here; the
+ * page map, entry table and name tables are decoded by le_load() when
+ * somebody asks for them.
+ */
+void read_le_exe(struct THIS *this) {
+    uint32_t end, avail;
+
+    this->le_offset = this->mzx->nextHeader;
+    if (!(this->le = view_at(this, this->le_offset, sizeof(struct exe_le_header)))) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+        return;
+    }
+    end = this->le->objectTableOffset + this->le->loaderSize;
+    if (this->le->fixupPageTableOffset + this->le->fixupSize > end) end = this->le->fixupPageTableOffset + this->le->fixupSize;
+    avail = this->size - this->le_offset;
+    if (end > avail) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Loader section runs past end of file: %s", this->fname);
+        end = avail;
+    }
+    this->le_ldrSize = end;
+    this->leldr = view_at(this, this->le_offset, end);
+
+    if (!(this->leobjs = le_at(this, this->le->objectTableOffset, sizeof(struct exe_le_object) * this->le->objectCount)))
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad object table in %s", this->fname);
+    else
+        this->le_objectCount = this->le->objectCount;
+}
+
+/*
+ * Indexes a table of length-prefixed names. Resident and non-resident
+ * name tables end at an empty name and carry an ordinal after each name;
+ * the imported module table has a known count and the imported procedure
+ * table just runs to the end of the fixup section, with zero bytes that
+ * are not names of their own. max is -1 for no limit.
+ */
+static int le_read_names(struct THIS *this, const uint8_t *p, uint32_t len, int ordinals, int max, struct exe_le_name **out) {
+    uint32_t pos, step;
+    int pass, n = 0;
+
+    *out = NULL;
+    for (pass = 0; p && pass < 2; pass++) {
+        if (pass && n && !(*out = arena_calloc(&this->arena, n, sizeof(struct exe_le_name)))) {
+            exe_nomem(this);
+            return 0;
+        }
+        if (pass) n = 0;
+        for (pos = 0; pos < len && n != max; pos += step) {
+            if (!p[pos] && ordinals) break;
+            step = 1 + p[pos] + (ordinals ? 2 : 0);
+            if (pos + step > len) break;
+            if (!p[pos]) continue;
+            if (pass) {
+                (*out)[n].size = p[pos];
+                (*out)[n].offset = pos;
+                (*out)[n].ordinal = ordinals ? *(const uint16_t *) (p + pos + 1 + p[pos]) : 0;
+                (*out)[n].name = (const char *) p + pos + 1;
+            }
+            n++;
+        }
+    }
+    return n;
+}
+
+static void le_load_pages(struct THIS *this) {
+    const struct exe_le_page_le *le;
+    const struct exe_le_page_lx *lx;
+    struct le_page *pg;
+    uint32_t i, num;
+    int islx = this->kind == EXE_LX;
+
+    le = le_at(this, this->le->objectMapOffset, sizeof(struct exe_le_page_le) * this->le->pages);
+    lx = le_at(this, this->le->objectMapOffset, sizeof(struct exe_le_page_lx) * this->le->pages);
+    if (islx ? !lx : !le) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad object page map in %s", this->fname);
+        return;
+    }
+    if (islx && this->le->pageShift > 31) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad page offset shift %"PRIu32" in %s", this->le->pageShift, this->fname);
+        return;
+    }
+    if (!(this->lepages = arena_calloc(&this->arena, this->le->pages ? this->le->pages : 1, sizeof(struct le_page)))) {
+        exe_nomem(this);
+        return;
+    }
+    for (i = 0; i < this->le->pages; i++) {
+        pg = &this->lepages[i];
+        if (islx) {
+            pg->flags = lx[i].flags;
+            pg->fileOffset = this->le->dataPagesOffset + (lx[i].dataOffset << this->le->pageShift);
+            pg->size = lx[i].dataSize;
+        } else {
+            num = ((uint32_t) le[i].pageNumber[0] << 16) | ((uint32_t) le[i].pageNumber[1] << 8) | le[i].pageNumber[2];
+            pg->flags = le[i].flags;
+            pg->fileOffset = num ? this->le->dataPagesOffset + (num - 1) * this->le->pageSize : 0;
+            pg->size = num == this->le->pages ? this->le->lastPage : this->le->pageSize;
+            if (pg->flags == LE_PAGE_INVALID || pg->flags == LE_PAGE_ZEROFILL) pg->size = 0;
+        }
+    }
+    this->le_pageCount = this->le->pages;
+}
+
+/* Entry table bundles, expanded into one exe_le_entry per ordinal in use. */
+static void le_load_entries(struct THIS *this) {
+    static const uint8_t entsize[] = { 0, 3, 5, 5, 7 };
+    const uint8_t *p, *q, *end;
+    size_t step;
+    struct exe_le_entry *ent;
+    uint32_t start = this->le->entryTableOffset;
+    uint16_t ordinal;
+    uint8_t type;
+    int pass, i, n = 0;
+
+    if (!start || !le_at(this, start, 1)) return;
+    end = this->leldr + this->le_ldrSize;
+    /* Count first, so the entries are a single allocation. */
+    for (pass = 0; pass < 2; pass++) {
+        if (pass && !n) break;
+        if (pass && !(this->leents = arena_calloc(&this->arena, n, sizeof(struct exe_le_entry)))) {
+            exe_nomem(this);
+            return;
+        }
+        n = 0;
+        ordinal = 1;
+        for (p = this->leldr + start; p + 2 <= end && p[0]; p += step) {
+            type = p[1] & LE_BUNDLE_TYPE_MASK;
+            if (type == LE_BUNDLE_UNUSED) {
+                ordinal += p[0];
+                step = 2;       /* no object number */
+                continue;
+            }
+            if (type > LE_BUNDLE_FORWARDER) {
+                if (!pass) exe_warn(this, EXE_ERR_MALFORMED, "Unknown entry bundle type 0x%02"PRIx8" in %s", p[1], this->fname);
+                break;
+            }
+            step = 4 + (size_t) p[0] * entsize[type];
+            if (p + step > end) {
+                if (!pass) exe_warn(this, EXE_ERR_TRUNCATED, "Entry table runs past end of loader section: %s", this->fname);
+                break;
+            }
+            for (i = 0; i < p[0]; i++, ordinal++, n++) {
+                if (!pass) continue;
+                ent = &this->leents[n];
+                q = p + 4 + i * entsize[type];
+                memset(ent, 0, sizeof(*ent));
+                ent->ordinal = ordinal;
+                ent->type = type;
+                ent->flags = q[0];
+                ent->object = ((const struct exe_le_bundle *) p)->object;
+                switch (type) {
+                    case LE_BUNDLE_ENTRY16:
+                        ent->offset = *(const uint16_t *) (q + 1);
+                        break;
+                    case LE_BUNDLE_GATE286:
+                        ent->offset = *(const uint16_t *) (q + 1);
+                        ent->callgate = *(const uint16_t *) (q + 3);
+                        break;
+                    case LE_BUNDLE_ENTRY32:
+                        ent->offset = *(const uint32_t *) (q + 1);
+                        break;
+                    case LE_BUNDLE_FORWARDER:
+                        ent->object = *(const uint16_t *) (q + 1);
+                        ent->offset = *(const uint32_t *) (q + 3);
+                        break;
+                }
+            }
+        }
+    }
+    this->le_entryCount = n;
+}
+
+/* Decodes the tables in what (LE_HAVE_*) that have not been decoded yet. Returns this->status. */
+int le_load(struct THIS *this, unsigned what) {
+    const uint8_t *p;
+    uint32_t start, end;
+    int prev;
+
+    what &= ~this->le_done;
+    if (!this->le || !what) return this->status;
+    this->le_done |= what;
+    prev = exe_phase(this, EXE_PHASE_LE);
+    if (what & LE_HAVE_PAGES) le_load_pages(this);
+    if (what & LE_HAVE_ENTRIES) le_load_entries(this);
+    if (what & LE_HAVE_RESNAMES) {
+        start = this->le->residentNameTableOffset;
+        if (start && (p = le_at(this, start, 0)))
+            this->le_resnameCount = le_read_names(this, p, this->le_ldrSize - start, 1, -1, &this->leresnames);
+    }
+    if (what & LE_HAVE_NONRESNAMES) {
+        if (this->le->nonresidentNameTableOffset && this->le->nonresidentNameTableSize) {
+            if ((p = view_at(this, this->le->nonresidentNameTableOffset, this->le->nonresidentNameTableSize)))
+                this->le_nonresnameCount = le_read_names(this, p, this->le->nonresidentNameTableSize, 1, -1, &this->lenonresnames);
+            else exe_warn(this, EXE_ERR_MALFORMED, "Bad non-resident name table in %s", this->fname);
+        }
+    }
+    if (what & LE_HAVE_IMPORTS) {
+        start = this->le->importModuleNameTableOffset;
+        if (this->le->importModuleNameTableCount && start && (p = le_at(this, start, 0)))
+            this->le_impmodCount = le_read_names(this, p, this->le_ldrSize - start, 0, this->le->importModuleNameTableCount, &this->leimpmods);
+        if (this->le_impmodCount != (int) this->le->importModuleNameTableCount) exe_warn(this, EXE_ERR_MALFORMED, "Bad import module table in %s", this->fname);
+        start = this->le->importProcNameTableOffset;
+        end = this->le->fixupPageTableOffset + this->le->fixupSize;
+        if (end > this->le_ldrSize || end <= start) end = this->le_ldrSize;
+        if (start && (p = le_at(this, start, 0)))
+            this->le_impprocCount = le_read_names(this, p, end - start, 0, -1, &this->leimpprocs);
+    }
+    exe_phase_resume(this, prev);
+    return this->status;
+}
+
+/* Finds the imported procedure name starting at offset, or NULL. */
+const struct exe_le_name *le_import_proc(struct THIS *this, uint32_t offset) {
+    int lo = 0, hi = this->le_impprocCount - 1, mid;
+
+    le_load(this, LE_HAVE_IMPORTS);
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (this->leimpprocs[mid].offset == offset) return &this->leimpprocs[mid];
+        if (this->leimpprocs[mid].offset < offset) lo = mid + 1; else hi = mid - 1;
+    }
+    return NULL;
+}
+
+/* Object (from 1) that page (from 1) belongs to, or 0. */
+uint32_t le_page_object(struct THIS *this, uint32_t page) {
+    int i;
+
+    for (i = 0; i < this->le_objectCount; i++)
+        if (page >= this->leobjs[i].pageMapIndex && page - this->leobjs[i].pageMapIndex < this->leobjs[i].pageMapEntries)
+            return i + 1;
+    return 0;
+}
+
+/* Takes a width-byte field from *p, if it ends by end. */
+static int le_fixup_field(const uint8_t **p, const uint8_t *end, int width, uint32_t *v) {
+    if (end - *p < width) return -1;
+    *v = width == 1 ? **p : width == 2 ? *(const uint16_t *) *p : *(const uint32_t *) *p;
+    *p += width;
+    return 0;
+}
+
+/*
+ * Decodes the fixup records from p to end, one page's worth. With fx set
+ * each location is stored from index at on; without, they are only
+ * counted. Returns the number of locations, or -1 if a record is bad or
+ * cut short.
+ */
+static long le_decode_fixups(const uint8_t *p, const uint8_t *end, struct le_fixups *fx, uint32_t at) {
+    const uint8_t *list;
+    uint32_t target, value, additive, count, n = 0, k, v;
+    uint8_t src, flags;
+    int idwidth;
+
+    while (p < end) {
+        if (end - p < 2) return -1;
+        src = p[0];
+        flags = p[1];
+        p += 2;
+        switch (src & LE_FIXUP_SOURCE_MASK) {
+            case LE_FIXUP_BYTE: case LE_FIXUP_SELECTOR16: case LE_FIXUP_FAR16: case LE_FIXUP_OFFSET16:
+            case LE_FIXUP_FAR48: case LE_FIXUP_OFFSET32: case LE_FIXUP_RELATIVE32:
+                break;
+            default:
+                return -1;
+        }
+        list = NULL;
+        if (src & LE_FIXUP_LIST) {
+            if (le_fixup_field(&p, end, 1, &count)) return -1;
+        } else {
+            list = p;
+            count = 1;
+            if (le_fixup_field(&p, end, 2, &v)) return -1;
+        }
+        value = additive = 0;
+        idwidth = flags & LE_TARGET_OBJECT16 ? 2 : 1;
+        if (le_fixup_field(&p, end, idwidth, &target)) return -1;
+        switch (flags & LE_TARGET_MASK) {
+            case LE_TARGET_INTERNAL:
+                /* A selector fixup wants the object's selector and nothing else. */
+                if ((src & LE_FIXUP_SOURCE_MASK) != LE_FIXUP_SELECTOR16
+                    && le_fixup_field(&p, end, flags & LE_TARGET_OFFSET32 ? 4 : 2, &value)) return -1;
+                break;
+            case LE_TARGET_IMPORD:
+                if (le_fixup_field(&p, end, flags & LE_TARGET_ORDINAL8 ? 1 : flags & LE_TARGET_OFFSET32 ? 4 : 2, &value)) return -1;
+                break;
+            case LE_TARGET_IMPNAME:
+                if (le_fixup_field(&p, end, flags & LE_TARGET_OFFSET32 ? 4 : 2, &value)) return -1;
+                break;
+            case LE_TARGET_ENTRY:
+                break;
+        }
+        if ((flags & LE_TARGET_ADDITIVE) && le_fixup_field(&p, end, flags & LE_TARGET_ADDITIVE32 ? 4 : 2, &additive)) return -1;
+        if (!list) {
+            list = p;
+            if ((uint32_t) (end - p) < 2 * count) return -1;
+            p += 2 * count;
+        }
+        for (k = 0; fx && k < count; k++, at++) {
+            fx->source[at] = (int16_t) (list[2 * k] | list[2 * k + 1] << 8);
+            fx->sourceType[at] = src;
+            fx->targetFlags[at] = flags;
+            fx->target[at] = (uint16_t) target;
+            fx->value[at] = value;
+            fx->additive[at] = additive;
+        }
+        n += count;
+    }
+    return n;
+}
+
+struct le_fixjob {
+    struct THIS *this;
+    const uint32_t *table;                  /* the fixup page table */
+    const uint8_t *records;                 /* the fixup record table */
+    uint32_t size;                          /* bytes from records to the end of the fixup section */
+    long *counts;                           /* locations in each page, or -1 if its records are bad */
+    int store;                              /* second pass: fill in this->lefix */
+};
+
+/*
+ * One page's fixups, on whichever thread gets it: counted on the first
+ * pass and stored on the second, once the arrays have been sized. Only
+ * the page's own count and slots are written.
+ */
+static void le_page_fixups(void *ctx, int i, int worker) {
+    struct le_fixjob *job = ctx;
+    uint32_t start = job->table[i], end = job->table[i + 1];
+
+    (void) worker;
+    if (job->store) {
+        if (job->counts[i] > 0)
+            le_decode_fixups(job->records + start, job->records + end, &job->this->lefix, job->this->lefix.pageStart[i]);
+        return;
+    }
+    if (start > end || end > job->size) job->counts[i] = -1;
+    else job->counts[i] = le_decode_fixups(job->records + start, job->records + end, NULL, 0);
+}
+
+/*
+ * Decodes the fixup records of every page into this->lefix, on up to
+ * nthreads threads for a file of LE_FIXUP_PARALLEL pages or more. Each
+ * page's records are counted first, so the arrays are allocated once and
+ * the second pass writes each page's fixups straight into its own part
+ * of them. A page whose records are bad gets none. Returns this->status.
+ */
+int le_load_fixups(struct THIS *this, int nthreads) {
+    struct le_fixjob job;
+    struct le_fixups *fx = &this->lefix;
+    uint32_t total = 0;
+    int i, prev;
+
+    if (!this->le || (this->le_done & LE_HAVE_FIXUPS)) return this->status;
+    this->le_done |= LE_HAVE_FIXUPS;
+    if (!this->le->pages || !this->le->fixupPageTableOffset) return this->status;
+    prev = exe_phase(this, EXE_PHASE_LE_FIXUPS);
+    job.this = this;
+    if (this->le->pages > this->le_ldrSize / sizeof(uint32_t)
+        || !(job.table = le_at(this, this->le->fixupPageTableOffset, sizeof(uint32_t) * ((size_t) this->le->pages + 1)))
+        || !(job.records = le_at(this, this->le->fixupRecordTableOffset, 0))) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad fixup page table in %s", this->fname);
+        exe_phase_resume(this, prev);
+        return this->status;
+    }
+    job.size = this->le_ldrSize - this->le->fixupRecordTableOffset;
+    if (!(job.counts = arena_alloc(&this->arena, sizeof(long) * this->le->pages))
+        || !(fx->pageStart = arena_alloc(&this->arena, sizeof(uint32_t) * ((size_t) this->le->pages + 1)))) {
+        exe_nomem(this);
+        exe_phase_resume(this, prev);
+        return this->status;
+    }
+    nthreads = this->le->pages >= LE_FIXUP_PARALLEL ? nthreads : 1;
+    job.store = 0;
+    pool_run(this->le->pages, nthreads, le_page_fixups, &job);
+
+    for (i = 0; i < (int) this->le->pages; i++) {
+        fx->pageStart[i] = total;
+        if (job.counts[i] < 0) exe_warn(this, EXE_ERR_MALFORMED, "Bad fixup records for page %d in %s", i + 1, this->fname);
+        else if ((uint32_t) job.counts[i] > UINT32_MAX - total) job.counts[i] = 0;
+        else total += job.counts[i];
+    }
+    fx->pageStart[i] = total;
+    if (total) {
+        fx->source = arena_alloc(&this->arena, sizeof(int16_t) * total);
+        fx->sourceType = arena_alloc(&this->arena, total);
+        fx->targetFlags = arena_alloc(&this->arena, total);
+        fx->target = arena_alloc(&this->arena, sizeof(uint16_t) * total);
+        fx->value = arena_alloc(&this->arena, sizeof(uint32_t) * total);
+        fx->additive = arena_alloc(&this->arena, sizeof(uint32_t) * total);
+        if (!fx->source || !fx->sourceType || !fx->targetFlags || !fx->target || !fx->value || !fx->additive) {
+            memset(fx, 0, sizeof(*fx));
+            exe_nomem(this);
+            exe_phase_resume(this, prev);
+            return this->status;
+        }
+        job.store = 1;
+        pool_run(this->le->pages, nthreads, le_page_fixups, &job);
+    }
+    fx->count = total;
+    /* Charge the page table and records as one view each. */
+    if (this->stats) {
+        this->stats->phase[this->phase].views += 2;
+        this->stats->phase[this->phase].bytes += sizeof(uint32_t) * ((uint64_t) this->le->pages + 1)
+            + (job.table[this->le->pages] < job.size ? job.table[this->le->pages] : job.size);
+    }
+    exe_phase_resume(this, prev);
+    return this->status;
+}
+
+static int compare_pe_secmap(const void *a, const void *b) {
+    uint32_t x = ((const struct pe_secmap *) a)->rva, y = ((const struct pe_secmap *) b)->rva;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Takes the COFF and optional headers and the section table from the file
+ * view, and builds the section index that pe_rva_offset() searches. The
+ * import, delay import and export tables are left to pe_load().
+ */
+void read_pe_exe(struct THIS *this) {
+    const struct exe_pe_section *sec;
+    uint32_t opt, dirs = 0, i, align;
+    uint16_t magic;
+
+    if (!(this->pe = view_at(this, this->mzx->nextHeader, sizeof(struct exe_pe_header)))) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+        return;
+    }
+    opt = this->mzx->nextHeader + sizeof(struct exe_pe_header);
+    if (this->pe->sizeOfOptionalHeader >= sizeof(uint16_t) && view_at(this, opt, sizeof(uint16_t))) {
+        magic = *(const uint16_t *) (this->base + opt);
+        if (magic == PE_OPT_MAGIC32 && this->pe->sizeOfOptionalHeader >= sizeof(struct exe_pe_optional32)) {
+            this->pe32 = view_at(this, opt, sizeof(struct exe_pe_optional32));
+            dirs = opt + sizeof(struct exe_pe_optional32);
+        } else if (magic == PE_OPT_MAGIC64 && this->pe->sizeOfOptionalHeader >= sizeof(struct exe_pe_optional64)) {
+            this->pe64 = view_at(this, opt, sizeof(struct exe_pe_optional64));
+            dirs = opt + sizeof(struct exe_pe_optional64);
+        } else exe_warn(this, EXE_ERR_MALFORMED, "Unknown optional header magic 0x%04"PRIx16" in %s", magic, this->fname);
+    }
+    if (this->pe32 || this->pe64) {
+        this->pe_dirCount = this->pe32 ? this->pe32->numberOfRvaAndSizes : this->pe64->numberOfRvaAndSizes;
+        /* Whatever the header claims, the directories have to fit in the optional header. */
+        if ((uint32_t) this->pe_dirCount > (opt + this->pe->sizeOfOptionalHeader - dirs) / sizeof(struct exe_pe_datadir))
+            this->pe_dirCount = (opt + this->pe->sizeOfOptionalHeader - dirs) / sizeof(struct exe_pe_datadir);
+        if (!(this->pedirs = view_at(this, dirs, sizeof(struct exe_pe_datadir) * this->pe_dirCount))) this->pe_dirCount = 0;
+        this->pe_sizeOfHeaders = this->pe32 ? this->pe32->sizeOfHeaders : this->pe64->sizeOfHeaders;
+    }
+
+    if (!(this->pesecs = view_at(this, opt + this->pe->sizeOfOptionalHeader, sizeof(struct exe_pe_section) * this->pe->numberOfSections))) {
+        if (this->pe->numberOfSections) exe_warn(this, EXE_ERR_MALFORMED, "Bad section table in %s", this->fname);
+        return;
+    }
+    this->pe_sectionCount = this->pe->numberOfSections;
+
+    /* The loader rounds raw data pointers down to 512 bytes unless the file alignment is smaller than that. */
+    align = (this->pe32 ? this->pe32->fileAlignment : this->pe64 ? this->pe64->fileAlignment : 0) >= 0x200 ? 0x1FF : 0;
+    if (!(this->pesecmap = arena_calloc(&this->arena, this->pe_sectionCount ? this->pe_sectionCount : 1, sizeof(struct pe_secmap)))) {
+        this->pe_sectionCount = 0;
+        exe_nomem(this);
+        return;
+    }
+    for (i = 0; i < (uint32_t) this->pe_sectionCount; i++) {
+        sec = &this->pesecs[i];
+        this->pesecmap[i].rva = sec->virtualAddress;
+        this->pesecmap[i].vsize = sec->virtualSize ? sec->virtualSize : sec->sizeOfRawData;
+        this->pesecmap[i].rawOffset = sec->pointerToRawData & ~align;
+        this->pesecmap[i].rawSize = sec->pointerToRawData ? sec->sizeOfRawData : 0;
+    }
+    qsort(this->pesecmap, this->pe_sectionCount, sizeof(struct pe_secmap), compare_pe_secmap);
+}
+
+/* File offset of rva, setting *avail to the bytes of file data behind it. Returns 0 if the RVA is not backed by the file. */
+uint32_t pe_rva_offset(struct THIS *this, uint32_t rva, uint32_t *avail) {
+    const struct pe_secmap *s;
+    int lo = 0, hi = this->pe_sectionCount, mid;
+    uint32_t delta;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (this->pesecmap[mid].rva <= rva) lo = mid + 1; else hi = mid;
+    }
+    if (lo) {
+        s = &this->pesecmap[lo - 1];
+        delta = rva - s->rva;
+        if (delta < s->vsize || delta < s->rawSize) {
+            if (delta >= s->rawSize) return 0;
+            *avail = s->rawSize - delta;
+            return s->rawOffset + delta;
+        }
+    }
+    /* The headers are mapped as they are in the file. */
+    if (rva && rva < this->pe_sizeOfHeaders) {
+        *avail = this->pe_sizeOfHeaders - rva;
+        return rva;
+    }
+    return 0;
+}
+
+/* Bounds-checked pointer to len bytes at rva, or NULL. */
+const void *pe_at(struct THIS *this, uint32_t rva, size_t len) {
+    uint32_t off, avail;
+
+    if (!(off = pe_rva_offset(this, rva, &avail)) || len > avail) return NULL;
+    return view_at(this, off, len);
+}
+
+/* The NUL-terminated string at rva, left in place; its length goes in *len. */
+const char *pe_string(struct THIS *this, uint32_t rva, uint32_t *len) {
+    const char *s, *nul;
+    uint32_t off, avail;
+
+    if (!(off = pe_rva_offset(this, rva, &avail)) || off >= this->size) return NULL;
+    if (avail > this->size - off) avail = this->size - off;
+    s = (const char *) this->base + off;
+    if (!(nul = memchr(s, 0, avail))) return NULL;
+    *len = nul - s;
+    return s;
+}
+
+static const struct exe_pe_datadir *pe_dir(struct THIS *this, int index) {
+    if (index >= this->pe_dirCount || !this->pedirs[index].virtualAddress) return NULL;
+    return &this->pedirs[index];
+}
+
+/*
+ * Walks one module's import lookup table. Entries go into imps when it is
+ * not NULL; either way the number of entries is returned. bias is
+ * subtracted from every address, for old style delay imports which use
+ * VAs rather than RVAs.
+ */
+static int pe_walk_thunks(struct THIS *this, uint32_t rva, uint64_t bias, struct exe_pe_import *imps) {
+    const uint8_t *t;
+    uint64_t thunk;
+    uint32_t width = this->pe64 ? 8 : 4, len;
+    const char *name;
+    int n = 0;
+
+    for (; (t = pe_at(this, rva, width)); rva += width, n++) {
+        thunk = width == 8 ? *(const uint64_t *) t : *(const uint32_t *) t;
+        if (!thunk) break;
+        if (!imps) continue;
+        if (thunk & (width == 8 ? PE_ORDINAL_FLAG64 : PE_ORDINAL_FLAG32)) {
+            imps[n].name = NULL;
+            imps[n].nameLen = 0;
+            imps[n].hint = thunk & 0xFFFF;
+        } else if ((t = pe_at(this, (uint32_t) (thunk - bias), sizeof(uint16_t))) && (name = pe_string(this, (uint32_t) (thunk - bias) + 2, &len))) {
+            imps[n].hint = *(const uint16_t *) t;
+            imps[n].name = name;
+            imps[n].nameLen = len;
+        } else {
+            imps[n].name = "";
+            imps[n].nameLen = 0;
+            imps[n].hint = 0;
+        }
+    }
+    return n;
+}
+
+/*
+ * Both import directories, counted first and then filled in, so modules
+ * and imports are an allocation each. Every name is a view into the file.
+ */
+static void pe_load_imports(struct THIS *this) {
+    const struct exe_pe_datadir *dir;
+    const struct exe_pe_import_desc *imp;
+    const struct exe_pe_delay_desc *dl;
+    struct exe_pe_module *mod;
+    uint64_t base = this->pe32 ? this->pe32->imageBase : this->pe64 ? this->pe64->imageBase : 0, bias;
+    uint32_t rva, name, thunks;
+    int pass, nmods, nimps, n;
+
+    for (pass = 0; pass < 2; pass++) {
+        nmods = nimps = 0;
+        if ((dir = pe_dir(this, PE_DIR_IMPORT))) {
+            for (rva = dir->virtualAddress; (imp = pe_at(this, rva, sizeof(*imp))) && (imp->name || imp->firstThunk); rva += sizeof(*imp), nmods++) {
+                thunks = imp->originalFirstThunk ? imp->originalFirstThunk : imp->firstThunk;
+                if (pass) {
+                    mod = &this->pemods[nmods];
+                    if (!(mod->name = pe_string(this, imp->name, &mod->nameLen))) {
+                        mod->name = "";
+                        mod->nameLen = 0;
+                    }
+                    mod->delay = 0;
+                    mod->first = nimps;
+                }
+                n = pe_walk_thunks(this, thunks, 0, pass && this->peimps ? this->peimps + nimps : NULL);
+                if (pass) mod->count = n;
+                nimps += n;
+            }
+        }
+        if ((dir = pe_dir(this, PE_DIR_DELAY_IMPORT))) {
+            for (rva = dir->virtualAddress; (dl = pe_at(this, rva, sizeof(*dl))) && dl->dllName; rva += sizeof(*dl), nmods++) {
+                bias = (dl->attributes & PE_DELAY_RVA) ? 0 : base;
+                name = (uint32_t) (dl->dllName - bias);
+                thunks = (uint32_t) (dl->importNameTable - bias);
+                if (pass) {
+                    mod = &this->pemods[nmods];
+                    if (!(mod->name = pe_string(this, name, &mod->nameLen))) {
+                        mod->name = "";
+                        mod->nameLen = 0;
+                    }
+                    mod->delay = 1;
+                    mod->first = nimps;
+                }
+                n = pe_walk_thunks(this, thunks, bias, pass && this->peimps ? this->peimps + nimps : NULL);
+                if (pass) mod->count = n;
+                nimps += n;
+            }
+        }
+        if (!pass) {
+            if ((nmods && !(this->pemods = arena_calloc(&this->arena, nmods, sizeof(struct exe_pe_module))))
+                || (nimps && !(this->peimps = arena_calloc(&this->arena, nimps, sizeof(struct exe_pe_import))))) {
+                this->pemods = NULL;
+                this->peimps = NULL;
+                exe_nomem(this);
+                return;
+            }
+        }
+    }
+    this->pe_moduleCount = nmods;
+    this->pe_importCount = nimps;
+}
+
+static void pe_load_exports(struct THIS *this) {
+    const struct exe_pe_datadir *dir;
+    const struct exe_pe_export_dir *ed;
+    const uint32_t *funcs, *names;
+    const uint16_t *ords;
+    struct exe_pe_export *exp;
+    uint32_t i, n;
+
+    if (!(dir = pe_dir(this, PE_DIR_EXPORT))) return;
+    if (!(ed = this->peexpdir = pe_at(this, dir->virtualAddress, sizeof(struct exe_pe_export_dir)))) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad export directory in %s", this->fname);
+        return;
+    }
+    if (!(this->pe_expName = pe_string(this, ed->name, &this->pe_expNameLen))) this->pe_expNameLen = 0;
+    if (!ed->numberOfFunctions) return;
+    if (!(funcs = pe_at(this, ed->addressOfFunctions, sizeof(uint32_t) * ed->numberOfFunctions))) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad export address table in %s", this->fname);
+        return;
+    }
+    names = pe_at(this, ed->addressOfNames, sizeof(uint32_t) * ed->numberOfNames);
+    ords = pe_at(this, ed->addressOfNameOrdinals, sizeof(uint16_t) * ed->numberOfNames);
+    if (ed->numberOfNames && (!names || !ords)) exe_warn(this, EXE_ERR_MALFORMED, "Bad export name table in %s", this->fname);
+
+    if (!(this->peexps = arena_calloc(&this->arena, ed->numberOfFunctions, sizeof(struct exe_pe_export)))) {
+        exe_nomem(this);
+        return;
+    }
+    for (i = 0; i < ed->numberOfFunctions; i++) {
+        exp = &this->peexps[i];
+        exp->ordinal = ed->base + i;
+        exp->rva = funcs[i];
+        if (funcs[i] >= dir->virtualAddress && funcs[i] - dir->virtualAddress < dir->size)
+            exp->forwarder = pe_string(this, funcs[i], &exp->forwarderLen);
+    }
+    for (i = 0; names && ords && i < ed->numberOfNames; i++) {
+        if (ords[i] >= ed->numberOfFunctions) continue;
+        exp = &this->peexps[ords[i]];
+        if (!(exp->name = pe_string(this, names[i], &exp->nameLen))) exp->nameLen = 0;
+    }
+    /* Drop the unused slots in the address table. */
+    for (i = n = 0; i < ed->numberOfFunctions; i++)
+        if (this->peexps[i].rva || this->peexps[i].name)
+            this->peexps[n++] = this->peexps[i];
+    this->pe_exportCount = n;
+}
+
+/* Decodes the tables in what (PE_HAVE_*) that have not been decoded yet. Returns this->status. */
+int pe_load(struct THIS *this, unsigned what) {
+    int prev;
+
+    what &= ~this->pe_done;
+    if (!this->pe || !what) return this->status;
+    this->pe_done |= what;
+    prev = exe_phase(this, EXE_PHASE_PE);
+    if (what & PE_HAVE_IMPORTS) pe_load_imports(this);
+    if (what & PE_HAVE_EXPORTS) pe_load_exports(this);
+    exe_phase_resume(this, prev);
+    return this->status;
+}
+
+/*
+ * Content hashes. Each region is fed to the hashes straight from the file
+ * view; nothing is copied. A segment, object or module with no data in
+ * the file hashes as empty.
+ */
+struct exe_hasher {
+    unsigned what;
+    uint32_t bytes;
+    struct xxh64_state xxh;
+    struct sha256_state sha;
+};
+
+static void hash_begin(struct exe_hasher *h, unsigned what) {
+    h->what = what;
+    h->bytes = 0;
+    if (what & HASH_XXH64) xxh64_init(&h->xxh, 0);
+    if (what & HASH_SHA256) sha256_init(&h->sha);
+}
+
+static void hash_add(struct exe_hasher *h, const void *data, uint32_t len) {
+    h->bytes += len;
+    if (h->what & HASH_XXH64) xxh64_update(&h->xxh, data, len);
+    if (h->what & HASH_SHA256) sha256_update(&h->sha, data, len);
+}
+
+static void hash_end(struct exe_hasher *h, struct exe_hash *out) {
+    memset(out, 0, sizeof(*out));
+    out->what = h->what;
+    out->bytes = h->bytes;
+    if (h->what & HASH_XXH64) out->xxh64 = xxh64_digest(&h->xxh);
+    if (h->what & HASH_SHA256) sha256_final(&h->sha, out->sha256);
+}
+
+/* Hashes NE segment i's data as stored in the file. Returns 0, or -1 if it runs past the end of the file. */
+int ne_segment_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash) {
+    struct exe_hasher h;
+    const void *p = NULL;
+    uint32_t off, size;
+
+    hash_begin(&h, what);
+    if (this->nesegs && i >= 0 && i < this->ne->segmentCount && (off = ne_segment_offset(this, i))) {
+        size = ne_segment_size(this, i);
+        if (!(p = view_at(this, off, size))) {
+            exe_warn(this, EXE_ERR_TRUNCATED, "Segment %d runs past end of file: %s", i, this->fname);
+            hash_end(&h, hash);
+            return -1;
+        }
+        hash_add(&h, p, size);
+    }
+    hash_end(&h, hash);
+    return 0;
+}
+
+/* Hashes segment i as ne_load_segments() builds it. Returns 0, or -1 if it could not be built. */
+int ne_image_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash) {
+    struct exe_hasher h;
+    int ret = -1;
+
+    ne_load_segments(this, 0);
+    hash_begin(&h, what);
+    if (this->neimages && i >= 0 && i < this->ne->segmentCount && this->neimages[i].data) {
+        hash_add(&h, this->neimages[i].data, this->neimages[i].size);
+        ret = 0;
+    }
+    hash_end(&h, hash);
+    return ret;
+}
+
+/* Hashes LE object i (from 0) as the file data of its pages in order. Returns 0, or -1 if a page runs past the end of the file. */
+int le_object_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash) {
+    const struct exe_le_object *obj;
+    const struct le_page *pg;
+    struct exe_hasher h;
+    const void *p;
+    uint32_t j;
+    int ret = 0;
+
+    hash_begin(&h, what);
+    le_load(this, LE_HAVE_PAGES);
+    if (i >= 0 && i < this->le_objectCount) {
+        obj = &this->leobjs[i];
+        for (j = obj->pageMapIndex; j - obj->pageMapIndex < obj->pageMapEntries && j >= 1 && j <= (uint32_t) this->le_pageCount; j++) {
+            pg = &this->lepages[j - 1];
+            if (!pg->size) continue;
+            if (!(p = view_at(this, pg->fileOffset, pg->size))) {
+                exe_warn(this, EXE_ERR_TRUNCATED, "Page %"PRIu32" runs past end of file: %s", j, this->fname);
+                ret = -1;
+                break;
+            }
+            hash_add(&h, p, pg->size);
+        }
+    }
+    hash_end(&h, hash);
+    return ret;
+}
+
+/* Hashes W3 module i, the whole of the embedded VxD (after expansion, for W4). Returns 0, or -1 if it runs past the end of the file. */
+int w3_module_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash) {
+    struct exe_hasher h;
+    const void *p = NULL;
+    int ret = 0;
+
+    hash_begin(&h, what);
+    if (i >= 0 && i < this->wx_modcount) {
+        if (this->wximage == this->base)
+            p = view_at(this, this->w3mods[i].offset, this->w3mods[i].size);
+        else if (this->w3mods[i].offset <= this->wx_imageSize && this->w3mods[i].size <= this->wx_imageSize - this->w3mods[i].offset)
+            p = this->wximage + this->w3mods[i].offset;
+        if (p)
+            hash_add(&h, p, this->w3mods[i].size);
+        else {
+            exe_warn(this, EXE_ERR_TRUNCATED, "Module %d runs past end of file: %s", i, this->fname);
+            ret = -1;
+        }
+    }
+    hash_end(&h, hash);
+    return ret;
+}
+
+/* Hashes the load module as mz_load_image() builds it for segment seg. Returns 0, or -1 if there is none. */
+int mz_image_hash(struct THIS *this, int seg, unsigned what, struct exe_hash *hash) {
+    struct exe_hasher h;
+    const uint8_t *p;
+    uint32_t size;
+
+    hash_begin(&h, what);
+    if ((p = mz_load_image(this, (uint16_t) seg, &size))) hash_add(&h, p, size);
+    hash_end(&h, hash);
+    return p ? 0 : -1;
+}
+
+/*
+ * Checksums. The sums run over the file image a 64-bit word at a time:
+ * 16-bit words are added in 32-bit lanes (even words in one register,
+ * odd words in another) and 32-bit words straight into a 64-bit total,
+ * with the carries sorted out at the end. Plain C, so DOS and OS/2 builds
+ * get the same code.
+ */
+
+/* Sum of the little-endian 16-bit words in len bytes at p, an odd last byte counting as a word of its own. */
+static uint16_t sum_words16(const uint8_t *p, size_t len) {
+    const uint64_t lanes = UINT64_C(0x0000FFFF0000FFFF);
+    uint64_t even, odd, x, total = 0;
+    size_t n;
+
+    while (len >= 8) {
+        /* Each lane takes one word per step, so 65536 steps cannot overflow it. */
+        n = len / 8 > 65536 ? 65536 : len / 8;
+        len -= n * 8;
+        for (even = odd = 0; n; n--, p += 8) {
+            memcpy(&x, p, sizeof(x));
+            even += x & lanes;
+            odd += (x >> 16) & lanes;
+        }
+        total += (even & 0xFFFFFFFF) + (even >> 32) + (odd & 0xFFFFFFFF) + (odd >> 32);
+    }
+    for (; len >= 2; len -= 2, p += 2)
+        total += p[0] | (uint32_t) p[1] << 8;
+    if (len) total += p[0];
+    return (uint16_t) total;
+}
+
+/* Sum of the little-endian 32-bit words in len bytes at p, a short last word padded with zeroes. */
+static uint32_t sum_words32(const uint8_t *p, size_t len) {
+    uint64_t x, total = 0;
+    size_t i;
+
+    for (; len >= 8; len -= 8, p += 8) {
+        memcpy(&x, p, sizeof(x));
+        total += (x & 0xFFFFFFFF) + (x >> 32);
+    }
+    for (i = 0; i < len; i++)
+        total += (uint64_t) p[i] << (8 * (i & 3));
+    return (uint32_t) total;
+}
+
+/*
+ * The DOS header checksum: the one's complement of the sum of the 16-bit
+ * words of the file image the header describes, taking the checksum
+ * itself as 0. Most linkers leave it 0, which counts as no checksum.
+ * Returns sum->status.
+ */
+int mz_checksum(struct THIS *this, struct exe_checksum *sum) {
+    const uint8_t *p;
+    uint32_t len;
+    int whole = 1;
+
+    memset(sum, 0, sizeof(*sum));
+    if (!this->mz) return sum->status;
+    len = (uint32_t) this->mz->pageCount * 512;
+    if (this->mz->pageCount && (this->mz->lastPageSize & 511)) len -= 512 - (this->mz->lastPageSize & 511);
+    if (len > this->size) {
+        len = this->size;
+        whole = 0;
+    }
+    p = view_at(this, 0, len);
+    sum->stored = this->mz->checksum;
+    sum->computed = (uint16_t) ~(sum_words16(p, len) - (len >= offsetof(struct exe_mz_header, checksum) + 2 ? this->mz->checksum : 0));
+    if (sum->stored) {
+        sum->status = whole && sum->computed == sum->stored ? EXE_CHECK_VALID : EXE_CHECK_INVALID;
+        if (!whole) exe_warn(this, EXE_ERR_TRUNCATED, "DOS image runs past end of file: %s", this->fname);
+    }
+    return sum->status;
+}
+
+/*
+ * The NE file CRC, which for all its name is the 32-bit sum of the
+ * little-endian doublewords of the whole file, taking the CRC field as 0.
+ * Returns sum->status.
+ */
+int ne_checksum(struct THIS *this, struct exe_checksum *sum) {
+    const uint8_t *p;
+    uint32_t pos, total;
+    int i;
+
+    memset(sum, 0, sizeof(*sum));
+    if (!this->ne) return sum->status;
+    p = view_at(this, 0, this->size);
+    total = sum_words32(p, this->size);
+    /* The header was read from the image, so the field is in it; take it back out wherever it falls. */
+    pos = this->mzx->nextHeader + offsetof(struct exe_ne_header, fileCrc);
+    for (i = 0; i < 4; i++)
+        total -= (uint32_t) p[pos + i] << (8 * ((pos + i) & 3));
+    sum->stored = this->ne->fileCrc;
+    sum->computed = total;
+    if (sum->stored) sum->status = sum->computed == sum->stored ? EXE_CHECK_VALID : EXE_CHECK_INVALID;
+    return sum->status;
+}
+
+struct le_sumjob {
+    struct THIS *this;
+    const uint32_t *table;
+};
+
+/*
+ * One page's checksum, on whichever thread gets it. Only the page's own
+ * exe_checksum is written, and the image is looked at directly rather
+ * than through view_at(), which keeps counts that are not thread safe.
+ */
+static void le_page_checksum(void *ctx, int i, int worker) {
+    struct le_sumjob *job = ctx;
+    struct THIS *this = job->this;
+    const struct le_page *pg = &this->lepages[i];
+    struct exe_checksum *sum = &this->lesums[i];
+
+    (void) worker;
+    sum->stored = job->table[i];
+    if (pg->fileOffset > this->size || pg->size > this->size - pg->fileOffset) {
+        sum->status = EXE_CHECK_INVALID;
+        return;
+    }
+    sum->computed = sum_words32(this->base + pg->fileOffset, pg->size);
+    if (!sum->stored && !pg->size) sum->status = EXE_CHECK_ABSENT;
+    else sum->status = sum->computed == sum->stored ? EXE_CHECK_VALID : EXE_CHECK_INVALID;
+}
+
+/*
+ * Checks each page against the per-page checksum table, taking a page's
+ * checksum as the 32-bit sum of its data as stored in the file. Fills in
+ * this->lesums, one per page map entry, on up to nthreads threads for a
+ * file of LE_CHECKSUM_PARALLEL bytes or more. Returns EXE_CHECK_ABSENT if
+ * there is no table, otherwise EXE_CHECK_INVALID if any page is wrong.
+ */
+int le_page_checksums(struct THIS *this, int nthreads) {
+    struct le_sumjob job;
+    const struct le_page *pg;
+    uint32_t off = this->le->pageChecksumTableOffset;
+    uint64_t bytes = 0;
+    int i;
+
+    if (this->lesums) return this->le_sumStatus;
+    le_load(this, LE_HAVE_PAGES);
+    if (!off || !this->lepages) return EXE_CHECK_ABSENT;
+    if (off > this->size - this->le_offset
+        || !(job.table = view_at(this, this->le_offset + off, sizeof(uint32_t) * this->le_pageCount))) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad page checksum table in %s", this->fname);
+        return EXE_CHECK_INVALID;
+    }
+    if (!(this->lesums = arena_calloc(&this->arena, this->le_pageCount ? this->le_pageCount : 1, sizeof(struct exe_checksum)))) {
+        exe_nomem(this);
+        return EXE_CHECK_INVALID;
+    }
+    job.this = this;
+    pool_run(this->le_pageCount, this->size >= LE_CHECKSUM_PARALLEL ? nthreads : 1, le_page_checksum, &job);
+
+    this->le_sumStatus = EXE_CHECK_VALID;
+    for (i = 0; i < this->le_pageCount; i++) {
+        pg = &this->lepages[i];
+        if (pg->fileOffset > this->size || pg->size > this->size - pg->fileOffset)
+            exe_warn(this, EXE_ERR_TRUNCATED, "Page %d runs past end of file: %s", i + 1, this->fname);
+        else
+            bytes += pg->size;
+        if (this->lesums[i].status == EXE_CHECK_INVALID) this->le_sumStatus = EXE_CHECK_INVALID;
+    }
+    /* Charge the pages as though each had been a view of its own. */
+    if (this->stats) {
+        this->stats->phase[this->phase].views += this->le_pageCount;
+        this->stats->phase[this->phase].bytes += bytes;
+    }
+    return this->le_sumStatus;
+}
+
+/* Repeats the len bytes at dst over count * len bytes, doubling what is already there so each copy is one memcpy(). */
+static void le_fill(uint8_t *dst, uint32_t len, uint32_t count) {
+    uint32_t done = len, total = len * count, n;
+
+    if (len == 1) {
+        memset(dst, dst[0], total);
+        return;
+    }
+    for (; done < total; done += n) {
+        n = done < total - done ? done : total - done;
+        memcpy(dst + done, dst, n);
+    }
+}
+
+/*
+ * Copies len bytes from dist bytes back in the page being expanded. The
+ * OS/2 loader copies these a word at a time, which only differs from a
+ * byte-by-byte copy when dist is 1: each word then picks up one byte not
+ * yet written. Otherwise a copy is done in pieces no longer than dist, so
+ * that no piece overlaps what it copies from.
+ */
+static void le_copy_back(uint8_t *dst, uint32_t dist, uint32_t len) {
+    uint32_t n;
+
+    if (!dist) return;
+    if (dist == 1) {
+        if (len & 1) {
+            dst[0] = dst[-1];
+            dst++;
+        }
+        for (len >>= 1; len; len--, dst += 2) {
+            n = dst[0];
+            dst[0] = dst[-1];
+            dst[1] = (uint8_t) n;
+        }
+        return;
+    }
+    for (; len; dst += n, len -= n) {
+        n = dist < len ? dist : len;
+        memcpy(dst, dst - dist, n);
+    }
+}
+
+/* Expands an iterated (EXEPACK1) page of len bytes at p into the size bytes at out. Returns -1 if it does not fit. */
+static int le_expand_iterated(const uint8_t *p, uint32_t len, uint8_t *out, uint32_t size) {
+    const struct exe_le_iterated *it;
+    uint32_t pos, done = 0;
+
+    for (pos = 0; pos + sizeof(struct exe_le_iterated) <= len; pos += sizeof(struct exe_le_iterated) + it->byteCount) {
+        it = (const struct exe_le_iterated *) (p + pos);
+        if (it->byteCount > len - pos - sizeof(struct exe_le_iterated)) return -1;
+        if (!it->iterations || !it->byteCount) continue;
+        if ((uint32_t) it->iterations * it->byteCount > size - done) return -1;
+        memcpy(out + done, p + pos + sizeof(struct exe_le_iterated), it->byteCount);
+        le_fill(out + done, it->byteCount, it->iterations);
+        done += (uint32_t) it->iterations * it->byteCount;
+    }
+    return 0;
+}
+
+/*
+ * Expands a compressed (EXEPACK2) page of len bytes at p into the size
+ * bytes at out. The low two bits of each control byte say what follows:
+ *   0: a run of the next n bytes as they are (n in the top six bits), or
+ *      with those zero, a count and a byte to repeat; a count of zero
+ *      ends the page
+ *   1: up to 3 bytes as they are, then 3 to 10 bytes from up to 511 back
+ *   2: 3 to 6 bytes from up to 4095 back
+ *   3: up to 15 bytes as they are, then up to 63 bytes from up to 4095
+ *      back
+ * Returns -1 if the data runs out or refers outside the page.
+ */
+static int le_expand_compressed(const uint8_t *p, uint32_t len, uint8_t *out, uint32_t size) {
+    const uint8_t *end = p + len;
+    uint32_t lit, n, dist, done = 0;
+
+    while (p < end) {
+        switch (p[0] & 3) {
+            case 0:
+                if (p[0]) {
+                    lit = p[0] >> 2;
+                    p++;
+                    n = dist = 0;
+                } else {
+                    if (end - p < 3) return p + 1 < end && !p[1] ? 0 : -1;
+                    if (!p[1]) return 0;
+                    if (p[1] > size - done) return -1;
+                    memset(out + done, p[2], p[1]);
+                    done += p[1];
+                    p += 3;
+                    continue;
+                }
+                break;
+            case 1:
+                if (end - p < 2) return -1;
+                lit = (p[0] >> 2) & 3;
+                n = ((p[0] >> 4) & 7) + 3;
+                dist = ((uint32_t) p[1] << 1) | (p[0] >> 7);
+                p += 2;
+                break;
+            case 2:
+                if (end - p < 2) return -1;
+                lit = 0;
+                n = ((p[0] >> 2) & 3) + 3;
+                dist = ((uint32_t) p[1] << 4) | (p[0] >> 4);
+                p += 2;
+                break;
+            default:
+                if (end - p < 3) return -1;
+                lit = (p[0] >> 2) & 0xF;
+                n = ((uint32_t) (p[1] & 0xF) << 2) | (p[0] >> 6);
+                dist = ((uint32_t) p[2] << 4) | (p[1] >> 4);
+                p += 3;
+                break;
+        }
+        if (lit > (uint32_t) (end - p) || lit > size - done) return -1;
+        memcpy(out + done, p, lit);
+        p += lit;
+        done += lit;
+        if (!n) continue;
+        if (dist > done || n > size - done) return -1;
+        le_copy_back(out + done, dist, n);
+        done += n;
+    }
+    return 0;
+}
+
+struct le_expandjob {
+    struct THIS *this;
+    uint8_t *bad;                           /* per page: 1 past the end of the file, 2 bad data */
+};
+
+/*
+ * Expands page i into its slot of this->leimage, on whichever thread
+ * gets it. The slot starts out zeroed, which is all that invalid and
+ * zero-filled pages need.
+ */
+static void le_expand_page(void *ctx, int i, int worker) {
+    struct le_expandjob *job = ctx;
+    struct THIS *this = job->this;
+    const struct le_page *pg = &this->lepages[i];
+    uint32_t size = this->le->pageSize;
+    uint8_t *out = this->leimage + (size_t) i * size;
+    const uint8_t *p;
+
+    (void) worker;
+    if (!pg->size || pg->flags == LE_PAGE_INVALID || pg->flags == LE_PAGE_ZEROFILL) return;
+    if (pg->fileOffset > this->size || pg->size > this->size - pg->fileOffset) {
+        job->bad[i] = 1;
+        return;
+    }
+    p = this->base + pg->fileOffset;
+    switch (pg->flags) {
+        case LE_PAGE_ITERATED:
+            if (le_expand_iterated(p, pg->size, out, size)) job->bad[i] = 2;
+            break;
+        case LE_PAGE_COMPRESSED:
+            if (le_expand_compressed(p, pg->size, out, size)) job->bad[i] = 2;
+            break;
+        default:
+            if (pg->size > size) job->bad[i] = 2;
+            memcpy(out, p, pg->size < size ? pg->size : size);
+            break;
+    }
+}
+
+/*
+ * Builds every page as it would be in memory, pageSize bytes each, in
+ * this->leimage: iterated (EXEPACK1) and compressed (EXEPACK2) pages
+ * expanded, short and zero-filled pages padded with zeros. The pages are
+ * spread over up to nthreads threads for files of LE_EXPAND_PARALLEL
+ * pages or more. A page that cannot be expanded is left as far as it
+ * got and reported. Returns this->status.
+ */
+int le_expand_pages(struct THIS *this, int nthreads) {
+    struct le_expandjob job;
+    uint64_t bytes = 0;
+    int i, prev;
+
+    if (!this->le || (this->le_done & LE_HAVE_IMAGE)) return this->status;
+    this->le_done |= LE_HAVE_IMAGE;
+    le_load(this, LE_HAVE_PAGES);
+    if (!this->lepages || !this->le_pageCount) return this->status;
+    if (!this->le->pageSize || this->le->pageSize > 0x10000) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad page size %"PRIu32" in %s", this->le->pageSize, this->fname);
+        return this->status;
+    }
+    prev = exe_phase(this, EXE_PHASE_LE);
+    if ((uint64_t) this->le_pageCount * this->le->pageSize > SIZE_MAX
+        || !(job.bad = arena_calloc(&this->arena, this->le_pageCount, 1))
+        || !(this->leimage = arena_calloc(&this->arena, this->le_pageCount, this->le->pageSize))) {
+        exe_nomem(this);
+        exe_phase_resume(this, prev);
+        return this->status;
+    }
+    job.this = this;
+    pool_run(this->le_pageCount, this->le_pageCount >= LE_EXPAND_PARALLEL ? nthreads : 1, le_expand_page, &job);
+
+    for (i = 0; i < this->le_pageCount; i++) {
+        if (job.bad[i] == 1) exe_warn(this, EXE_ERR_TRUNCATED, "Page %d runs past end of file: %s", i + 1, this->fname);
+        else if (job.bad[i]) exe_warn(this, EXE_ERR_MALFORMED, "Bad %s page %d in %s", this->lepages[i].flags == LE_PAGE_COMPRESSED ? "compressed" : this->lepages[i].flags == LE_PAGE_ITERATED ? "iterated" : "oversized", i + 1, this->fname);
+        else bytes += this->lepages[i].size;
+    }
+    /* Charge the pages as though each had been a view of its own. */
+    if (this->stats) {
+        this->stats->phase[this->phase].views += this->le_pageCount;
+        this->stats->phase[this->phase].bytes += bytes;
+    }
+    exe_phase_resume(this, prev);
+    return this->status;
+}
+
+/* Hashes object i's pages as le_expand_pages() builds them, pageSize bytes each. Returns 0, or -1 if they could not be built. */
+int le_image_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash) {
+    const struct exe_le_object *obj;
+    struct exe_hasher h;
+    uint32_t j;
+    int ret = -1;
+
+    le_expand_pages(this, 0);
+    hash_begin(&h, what);
+    if (this->leimage && i >= 0 && i < this->le_objectCount) {
+        obj = &this->leobjs[i];
+        for (j = obj->pageMapIndex; j - obj->pageMapIndex < obj->pageMapEntries && j >= 1 && j <= (uint32_t) this->le_pageCount; j++)
+            hash_add(&h, this->leimage + (size_t) (j - 1) * this->le->pageSize, this->le->pageSize);
+        ret = 0;
+    }
+    hash_end(&h, hash);
+    return ret;
+}
+
+void read_w3_exe(struct THIS *this) {
+    uint32_t modoff;
+
+    if ((this->w3 = view_at(this, this->mzx->nextHeader, sizeof(struct exe_w3_header)))) {
+        this->wx_modcount = this->w3->modcount;
+        modoff = this->mzx->nextHeader + sizeof(struct exe_w3_header);
+        /* Keep whatever part of the module table is actually present. */
+        while (this->wx_modcount && !(this->w3mods = view_at(this, modoff, sizeof(struct exe_w3_modentry) * this->wx_modcount)))
+            this->wx_modcount--;
+        if (this->wx_modcount != this->w3->modcount) exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+        this->wximage = this->base;
+        this->wx_imageSize = this->size;
+    } else exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+    return;
+}
+
+/* Takes the W4 header and chunk table. The chunks are left to w3_load_modules(). */
+void read_w4_exe(struct THIS *this) {
+    if (!(this->w4 = view_at(this, this->mzx->nextHeader, sizeof(struct exe_w4_header)))) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+        return;
+    }
+    if (this->w4->dsMagic[0] != 'D' || this->w4->dsMagic[1] != 'S' || !this->w4->chunkSize) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Unknown W4 compression in %s", this->fname);
+        return;
+    }
+    if (!(this->w4chunks = view_at(this, this->mzx->nextHeader + sizeof(struct exe_w4_header), sizeof(uint32_t) * this->w4->chunkCount))) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+        return;
+    }
+    this->w4_chunkCount = this->w4->chunkCount;
+}
+
+/*
+ * The DoubleSpace bit stream, read a bit at a time from the low end of
+ * each byte. Past the end of the input it reads zeros and sets over.
+ */
+struct ds_bits {
+    const uint8_t *p, *end;
+    uint32_t buf;
+    int n;
+    int over;
+};
+
+static uint32_t ds_get(struct ds_bits *b, int count) {
+    uint32_t v;
+
+    while (b->n < count) {
+        if (b->p < b->end) b->buf |= (uint32_t) *b->p++ << b->n;
+        else b->over = 1;
+        b->n += 8;
+    }
+    v = b->buf & ((1U << count) - 1);
+    b->buf >>= count;
+    b->n -= count;
+    return v;
+}
+
+#define DS_END_MARK 4415                    /* the largest offset, which marks the end of a block instead */
+
+/*
+ * Expands one DoubleSpace compressed chunk of len bytes into out, which
+ * holds max. Each item starts with two bits: 1 and 2 are literals of 7
+ * more bits (2 with the top bit set), 0 and 3 a match whose distance
+ * takes 6, 8 (+64) or 12 (+320) bits, and whose length is a run of n
+ * zero bits, a one and n more bits, 2 to 2^n + 1 + that. Returns the
+ * bytes written, or -1 if the stream makes no sense.
+ */
+static long ds_expand(const uint8_t *in, uint32_t len, uint8_t *out, uint32_t max) {
+    struct ds_bits b = { NULL, NULL, 0, 0, 0 };
+    uint32_t pos = 0, dist, count, code;
+    int n;
+
+    b.p = in;
+    b.end = in + len;
+    while (pos < max) {
+        code = ds_get(&b, 2);
+        if (b.over) break;
+        if (code == 1 || code == 2) {
+            out[pos++] = (uint8_t) (ds_get(&b, 7) | (code == 2 ? 0x80 : 0));
+            continue;
+        }
+        if (code == 0) dist = ds_get(&b, 6);
+        else if (!ds_get(&b, 1)) dist = ds_get(&b, 8) + 64;
+        else if ((dist = ds_get(&b, 12) + 320) == DS_END_MARK) continue;
+        for (n = 0; !ds_get(&b, 1) && !b.over; n++)
+            if (n == 15) return -1;
+        count = (1U << n) + 1 + ds_get(&b, n);
+        /* The padding at the end of the last chunk may look like the start of a match. */
+        if (b.over) break;
+        if (!dist || dist > pos) return -1;
+        if (count > max - pos) count = max - pos;
+        /* Overlapping copies repeat the last dist bytes, so this has to go a byte at a time. */
+        for (; count; count--, pos++)
+            out[pos] = out[pos - dist];
+    }
+    return (long) pos;
+}
+
+struct w4_job {
+    struct THIS *this;
+    uint8_t *image;                         /* where the W4 header would be in the W3 image */
+    long *got;                              /* bytes each chunk expanded to, or -1 */
+};
+
+/* Expands chunk i into its place in the image. Runs on a worker thread: no view_at(), warnings or stats. */
+static void w4_expand_chunk(void *ctx, int i, int worker) {
+    struct w4_job *job = ctx;
+    struct THIS *this = job->this;
+    uint32_t chunk = this->w4->chunkSize, start = this->w4chunks[i], end;
+
+    (void) worker;
+    end = i + 1 < this->w4_chunkCount ? this->w4chunks[i + 1] : (uint32_t) this->size;
+    if (start > this->size || end > this->size || end < start) {
+        job->got[i] = -1;
+        return;
+    }
+    if (end - start == chunk) {
+        memcpy(job->image + (size_t) i * chunk, this->base + start, chunk);
+        job->got[i] = chunk;
+    } else job->got[i] = ds_expand(this->base + start, end - start, job->image + (size_t) i * chunk, chunk);
+}
+
+/*
+ * Expands every chunk, on up to nthreads threads, into a W3 image behind
+ * the file's own DOS stub, and takes the W3 header and module table from
+ * that. Only the last chunk may come out short.
+ */
+static void w4_expand(struct THIS *this, int nthreads) {
+    struct w4_job job;
+    uint32_t at = this->mzx->nextHeader, chunk = this->w4->chunkSize, modoff;
+    uint64_t total = 0, bytes = 0;
+    int i;
+
+    if (!this->w4_chunkCount) return;
+    if ((uint64_t) chunk * this->w4_chunkCount > SIZE_MAX - at
+        || !(job.image = arena_alloc(&this->arena, at + (size_t) chunk * this->w4_chunkCount))
+        || !(job.got = arena_alloc(&this->arena, sizeof(long) * this->w4_chunkCount))) {
+        exe_nomem(this);
+        return;
+    }
+    memcpy(job.image, this->base, at);
+    job.image += at;
+    job.this = this;
+    pool_run(this->w4_chunkCount, nthreads, w4_expand_chunk, &job);
+
+    for (i = 0; i < this->w4_chunkCount; i++) {
+        if (job.got[i] < 0) {
+            exe_warn(this, EXE_ERR_MALFORMED, "Bad W4 chunk %d in %s", i, this->fname);
+            break;
+        }
+        bytes += (i + 1 < this->w4_chunkCount ? this->w4chunks[i + 1] : this->size) - this->w4chunks[i];
+        total += job.got[i];
+        if ((uint32_t) job.got[i] < chunk) {
+            if (i + 1 < this->w4_chunkCount) exe_warn(this, EXE_ERR_MALFORMED, "W4 chunk %d expands to only %ld bytes in %s", i, job.got[i], this->fname);
+            break;
+        }
+    }
+    /* Charge the chunks as though each had been a view of its own. */
+    if (this->stats) {
+        this->stats->phase[this->phase].views += i;
+        this->stats->phase[this->phase].bytes += bytes;
+    }
+    this->wximage = job.image - at;
+    this->wx_imageSize = at + total;
+
+    if (total < sizeof(struct exe_w3_header) || job.image[0] != 'W' || job.image[1] != '3') {
+        exe_warn(this, EXE_ERR_MALFORMED, "W4 does not expand to W3 in %s", this->fname);
+        return;
+    }
+    this->w3 = (const struct exe_w3_header *) job.image;
+    this->wx_modcount = this->w3->modcount;
+    modoff = at + sizeof(struct exe_w3_header);
+    if ((uint64_t) modoff + sizeof(struct exe_w3_modentry) * this->wx_modcount > this->wx_imageSize) {
+        this->wx_modcount = (this->wx_imageSize - modoff) / sizeof(struct exe_w3_modentry);
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+    }
+    this->w3mods = (const struct exe_w3_modentry *) (this->wximage + modoff);
+}
+
+/* Parses module i in place as an LE file of its own. Runs on a worker thread, so it keeps to the module's THIS. */
+static void w3_parse_module(void *ctx, int i, int worker) {
+    struct THIS *this = ctx, *le;
+    const struct exe_w3_modentry *mod = &this->w3mods[i];
+    char *fname;
+    int n;
+
+    (void) worker;
+    if (!(le = init_this())) return;
+    this->wxles[i] = le;
+    le->container = this;
+    le->need = this->need;
+    /* Names are blank padded to eight characters. */
+    for (n = 8; n && (mod->name[n - 1] == ' ' || !mod->name[n - 1]); n--);
+    if ((fname = arena_alloc(&le->arena, strlen(this->fname) + n + 3))) {
+        sprintf(fname, "%s(%.*s)", this->fname, n, mod->name);
+        le->fname = fname;
+    } else le->fname = this->fname;
+    if (mod->offset <= this->wx_imageSize) {
+        le->base = this->wximage + mod->offset;
+        le->size = mod->size < this->wx_imageSize - mod->offset ? mod->size : this->wx_imageSize - mod->offset;
+        if (mod->size > le->size) exe_warn(le, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", le->fname);
+    } else exe_warn(le, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", le->fname);
+    /* A VxD in a container has no DOS stub of its own; one that does is read the usual way. */
+    if (le->size >= 2 && le->base[0] == 'L' && (le->base[1] == 'E' || le->base[1] == 'X')) le->noffset = 0;
+    read_exe(le);
+    if (le->le) le_load(le, LE_HAVE_PAGES | LE_HAVE_ENTRIES | LE_HAVE_RESNAMES | LE_HAVE_NONRESNAMES | LE_HAVE_IMPORTS);
+    else if (le->size) exe_warn(le, EXE_ERR_MALFORMED, "Not an LE VxD: %s", le->fname);
+}
+
+/*
+ * Expands a W4 file, then parses every module of a W3 or W4 file as an
+ * LE file of its own, in place, with the modules spread over up to
+ * nthreads threads. Fills in this->wxles; each module's problems are
+ * recorded against this as well. Returns this->status.
+ */
+int w3_load_modules(struct THIS *this, int nthreads) {
+    const struct exe_diag *d;
+    int prev, i;
+
+    if (this->wx_loaded || (!this->w3 && !this->w4)) return this->status;
+    this->wx_loaded = 1;
+    prev = exe_phase(this, EXE_PHASE_W3);
+    if (this->w4 && !this->w3) w4_expand(this, nthreads);
+    if (this->wx_modcount && !(this->wxles = arena_calloc(&this->arena, this->wx_modcount, sizeof(struct THIS *)))) exe_nomem(this);
+    if (this->wxles) {
+        pool_run(this->wx_modcount, nthreads, w3_parse_module, this);
+        for (i = 0; i < this->wx_modcount; i++) {
+            if (!this->wxles[i]) exe_nomem(this);
+            for (d = this->wxles[i] ? this->wxles[i]->diags : NULL; d; d = d->next)
+                exe_warn(this, d->code, "%s", d->msg);
+        }
+    }
+    exe_phase_resume(this, prev);
+    return this->status;
+}
+
+void read_next_header(struct THIS *this) {
+    const char *next_magic;
+
+    if (!(next_magic = view_at(this, this->mzx->nextHeader, 2))) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+        return;
+    }
+    this->nextMagic = next_magic;
+    if (((next_magic[0] == 'N') && (next_magic[1] == 'E'))) {
+        this->kind = EXE_NE;
+        IN_PHASE(this, EXE_PHASE_NE, read_ne_exe(this));
+    } else if (((next_magic[0] == 'P') && (next_magic[1] == 'E'))) {
+        this->kind = EXE_PE;
+        IN_PHASE(this, EXE_PHASE_PE, read_pe_exe(this));
+    } else if (((next_magic[0] == 'L') && (next_magic[1] == 'E')) ||
+               ((next_magic[0] == 'L') && (next_magic[1] == 'X'))) {
+        this->kind = next_magic[1] == 'X' ? EXE_LX : EXE_LE;
+        IN_PHASE(this, EXE_PHASE_LE, read_le_exe(this));
+    } else if ((next_magic[0] == 'W') && (next_magic[1] == '3')) {
+        this->kind = EXE_W3;
+        IN_PHASE(this, EXE_PHASE_W3, read_w3_exe(this));
+    } else if ((next_magic[0] == 'W') && (next_magic[1] == '4')) {
+        this->kind = EXE_W4;
+        IN_PHASE(this, EXE_PHASE_W3, read_w4_exe(this));
+    }
+}
+
+/* A zeroed THIS in an arena of its own, set up to read everything; NULL if out of memory. */
+struct THIS *init_this(void) {
+    struct arena arena = { NULL, 0 };
+    struct THIS *this;
+
+    if (!(this = arena_calloc(&arena, 1, sizeof(struct THIS)))) return NULL;
+    this->arena = arena;
+    this->noffset = -1;
+    this->need = NEED_ALL;
+    this->diagTail = &this->diags;
+    return this;
+}
+
+/* Unmaps the file and frees everything read from it, this included. */
+void destroy_this(struct THIS *this) {
+    struct arena arena;
+    int i;
+
+    if (!this) return;
+    for (i = 0; this->wxles && i < this->wx_modcount; i++)
+        destroy_this(this->wxles[i]);
+    if (this->base && !this->container) unmap_file(this);
+    arena = this->arena;
+    arena_free(&arena);
+}
+
+/*
+ * The load module as DOS would leave it at segment seg: the image the
+ * header describes, with seg added to each word the relocation table
+ * points at. Entries are applied one at a time and in full, duplicates
+ * included, in the order the table lists them, as DOS does: two can
+ * overlap by a byte, and then the order decides the result, so the
+ * sorted mzrelocs will not do. Entries past the end of the image would
+ * patch memory beyond it and are skipped. The relocations have to have
+ * been read (NEED_MZ_RELOCS). Returns the image, *size bytes that stay
+ * valid until this is destroyed or the next call, or NULL if there is no
+ * load module.
+ */
+const uint8_t *mz_load_image(struct THIS *this, uint16_t seg, uint32_t *size) {
+    uint32_t n, start, have, a;
+    uint16_t w;
+    uint8_t *img;
+    int i;
+
+    if (!this->mz || !(n = mz_image_size(this))) return NULL;
+    if (!this->mzimage || this->mz_imageSize != n) {
+        if (!(this->mzimage = arena_alloc(&this->arena, n))) {
+            exe_nomem(this);
+            return NULL;
+        }
+        this->mz_imageSize = n;
+    }
+    img = this->mzimage;
+    start = (uint32_t) this->mz->hdrSize * 16;
+    have = start < this->size ? (this->size - start < n ? (uint32_t) (this->size - start) : n) : 0;
+    if (have < n) exe_warn(this, EXE_ERR_TRUNCATED, "Load module runs past end of file: %s", this->fname);
+    if (have) memcpy(img, view_at(this, start, have), have);
+    memset(img + have, 0, n - have);
+    for (i = 0; i < this->mz_relocCount; i++) {
+        a = ((uint32_t) this->mzreltab[i].segment << 4) + this->mzreltab[i].offset;
+        if (a + 2 > n) continue;
+        w = (uint16_t) (img[a] | img[a + 1] << 8) + seg;
+        img[a] = (uint8_t) w;
+        img[a + 1] = (uint8_t) (w >> 8);
+    }
+    *size = n;
+    return img;
+}
+
+/* Size of the DOS load module: the file image described by the header, less the header itself. */
+uint32_t mz_image_size(struct THIS *this) {
+    uint32_t total;
+
+    if (!this->mz->pageCount) return 0;
+    total = (uint32_t) this->mz->pageCount * 512;
+    if (this->mz->lastPageSize & 511) total -= 512 - (this->mz->lastPageSize & 511);
+    if (total < (uint32_t) this->mz->hdrSize * 16) return 0;
+    return total - (uint32_t) this->mz->hdrSize * 16;
+}
+
+const char *const mz_packer_names[MZ_PACKER_COUNT] = { "none", "EXEPACK", "LZEXE 0.90", "LZEXE 0.91", "PKLITE" };
+
+/* File offset of CS:0, where packers put their unpacker, or 0 if that is outside the file. */
+static uint32_t mz_code_offset(struct THIS *this) {
+    uint32_t off = ((uint32_t) this->mz->hdrSize + this->mz->initCodeSeg) * 16;
+
+    return off < this->size ? off : 0;
+}
+
+/*
+ * Which packer, if any, the program was run through, going by the marks
+ * each one leaves: LZEXE and PKLITE sign the header, EXEPACK only shows
+ * in the "RB" that ends its own header just before CS:IP. For PKLITE
+ * *version gets the version word (major, minor and PKLITE_* flags); it
+ * may be NULL.
+ */
+int mz_packer(struct THIS *this, uint16_t *version) {
+    const uint8_t *p;
+    uint32_t code;
+
+    if (!this->mz) return MZ_PACKER_NONE;
+    if ((p = view_at(this, 0x1C, 4)) && !memcmp(p, "LZ09", 4)) return MZ_PACKER_LZEXE090;
+    if (p && !memcmp(p, "LZ91", 4)) return MZ_PACKER_LZEXE091;
+    if ((p = view_at(this, 0x1C, 8)) && (!memcmp(p + 2, "PKLITE", 6) || !memcmp(p + 2, "PKlite", 6))) {
+        if (version) *version = (uint16_t) (p[0] | p[1] << 8);
+        return MZ_PACKER_PKLITE;
+    }
+    if ((this->mz->initInstPtr == 16 || this->mz->initInstPtr == 18) && (code = mz_code_offset(this))
+        && (p = view_at(this, code + this->mz->initInstPtr - 2, 2)) && p[0] == 'R' && p[1] == 'B')
+        return MZ_PACKER_EXEPACK;
+    return MZ_PACKER_NONE;
+}
+
+/* A packed program taken apart again, for mz_rebuild() */
+struct mz_unpacked {
+    uint8_t *image;
+    uint32_t imageSize;
+    uint32_t *relocs;                       /* segment << 16 | offset */
+    uint32_t relocCount;
+    uint16_t ip, cs, sp, ss;
+};
+
+/*
+ * The relocation table EXEPACK and LZEXE 0.90 keep: for each of the 16
+ * 64K frames in turn, a count and that many offsets. Fills out if it is
+ * not NULL. Returns the entries, or -1 if the table runs past end.
+ */
+static long mz_frame_relocs(const uint8_t *p, const uint8_t *end, uint32_t *out) {
+    uint32_t n = 0, count, i;
+    int frame;
+
+    for (frame = 0; frame < 16; frame++) {
+        if (end - p < 2) return -1;
+        count = p[0] | p[1] << 8;
+        p += 2;
+        if ((uint32_t) (end - p) / 2 < count) return -1;
+        for (i = 0; i < count; i++, p += 2, n++)
+            if (out) out[n] = (uint32_t) frame << 28 | (uint32_t) (p[0] | p[1] << 8);
+    }
+    return (long) n;
+}
+
+/*
+ * LZEXE 0.91's: each entry is the distance from the one before as a byte,
+ * or a word after a zero byte; a zero word moves on 0xFFF0 bytes and a
+ * one ends the table. Same results as mz_frame_relocs().
+ */
+static long mz_lzexe_relocs(const uint8_t *p, const uint8_t *end, uint32_t *out) {
+    uint32_t n = 0, off = 0, span;
+    uint16_t seg = 0;
+
+    for (;;) {
+        if (p >= end) return -1;
+        if (!(span = *p++)) {
+            if (end - p < 2) return -1;
+            span = p[0] | p[1] << 8;
+            p += 2;
+            if (!span) {
+                seg += 0x0FFF;
+                continue;
+            }
+            if (span == 1) break;
+        }
+        off += span;
+        seg += (uint16_t) (off >> 4);
+        off &= 0xF;
+        if (n == 0xFFFF) return -1;
+        if (out) out[n] = (uint32_t) seg << 16 | off;
+        n++;
+    }
+    return (long) n;
+}
+
+/* Takes the relocation table at p with fn, into u. */
+static int mz_unpack_relocs(struct THIS *this, long (*fn)(const uint8_t *, const uint8_t *, uint32_t *),
+                            const uint8_t *p, const uint8_t *end, struct mz_unpacked *u) {
+    long n;
+
+    if ((n = fn(p, end, NULL)) < 0 || n > 0xFFFF) return -1;
+    if (n && !(u->relocs = arena_calloc(&this->arena, n, sizeof(uint32_t)))) {
+        exe_nomem(this);
+        return -1;
+    }
+    fn(p, end, u->relocs);
+    u->relocCount = (uint32_t) n;
+    return 0;
+}
+
+/*
+ * Runs EXEPACK's unpacker. The packed data ends skipLen - 1 paragraphs
+ * short of CS:0, padded with up to 15 0xFF bytes, and is read backwards
+ * from there: a command byte, a length word, then a byte to repeat (0xB0)
+ * or that many bytes to copy (0xB2) to the top of what is left of the
+ * destLen paragraphs. Bit 0 of the command marks the last one. Whatever
+ * is below is left as it is, already unpacked.
+ */
+static int mz_unexepack(struct THIS *this, struct mz_unpacked *u) {
+    struct exe_exepack_header hdr;
+    const uint8_t *blk, *p, *end;
+    uint32_t code = mz_code_offset(this), packed, src, dst, len, i;
+    uint16_t hsize = this->mz->initInstPtr - 2;
+    uint8_t cmd, *buf;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.skipLen = 1;
+    if (!code || !(blk = view_at(this, code, hsize))) return -1;
+    memcpy(&hdr, blk, hsize);
+    if (hdr.exepackSize < hsize || !hdr.skipLen || hdr.skipLen - 1 > this->mz->initCodeSeg) return -1;
+    if (!(blk = view_at(this, code, hdr.exepackSize))) return -1;
+
+    packed = ((uint32_t) this->mz->initCodeSeg - (hdr.skipLen - 1)) * 16;
+    u->imageSize = (uint32_t) hdr.destLen * 16;
+    if (!(p = view_at(this, (uint32_t) this->mz->hdrSize * 16, packed))) return -1;
+    if (!(buf = arena_alloc(&this->arena, packed > u->imageSize ? packed : u->imageSize))) {
+        exe_nomem(this);
+        return -1;
+    }
+    memcpy(buf, p, packed);
+    for (src = packed, i = 0; src && i < 16 && buf[src - 1] == 0xFF; src--, i++)
+        ;
+    dst = u->imageSize;
+    do {
+        if (src < 3) return -1;
+        cmd = buf[--src];
+        len = buf[src - 2] | buf[src - 1] << 8;
+        src -= 2;
+        if ((cmd & 0xFE) == 0xB0) {
+            if (!src || len > dst) return -1;
+            dst -= len;
+            memset(buf + dst, buf[--src], len);
+        } else if ((cmd & 0xFE) == 0xB2) {
+            if (len > src || len > dst) return -1;
+            src -= len;
+            dst -= len;
+            /* The unpacker copies from the top down, which memmove() matches whenever dst is above src. */
+            if (dst >= src) memmove(buf + dst, buf + src, len);
+            else for (i = len; i; i--)
+                buf[dst + i - 1] = buf[src + i - 1];
+        } else return -1;
+    } while (!(cmd & 1));
+    /* Below dst is what was stored unpacked; past the packed data, nothing would have put it there. */
+    if (dst > packed) return -1;
+    u->image = buf;
+
+    end = blk + hdr.exepackSize;
+    for (p = blk + hsize; end - p >= (ptrdiff_t) sizeof(EXEPACK_ERROR_MSG) - 1; p++)
+        if (!memcmp(p, EXEPACK_ERROR_MSG, sizeof(EXEPACK_ERROR_MSG) - 1)) break;
+    if (end - p < (ptrdiff_t) sizeof(EXEPACK_ERROR_MSG) - 1) return -1;
+    if (mz_unpack_relocs(this, mz_frame_relocs, p + sizeof(EXEPACK_ERROR_MSG) - 1, end, u)) return -1;
+    u->ip = hdr.realIP;
+    u->cs = hdr.realCS;
+    u->sp = hdr.realSP;
+    u->ss = hdr.realSS;
+    return 0;
+}
+
+/*
+ * LZEXE's bit stream: 16-bit words taken from the low bit up, with the
+ * next word fetched as soon as the last bit of one is used, so that the
+ * bytes the decoder reads in between come after it. Past the end of the
+ * input it sets over.
+ */
+struct lz_bits {
+    const uint8_t *p, *end;
+    uint16_t buf;
+    int n;
+    int over;
+};
+
+static int lz_get(struct lz_bits *b) {
+    int bit = b->buf & 1;
+
+    b->buf >>= 1;
+    if (--b->n) return bit;
+    if (b->end - b->p >= 2) {
+        b->buf = (uint16_t) (b->p[0] | b->p[1] << 8);
+        b->p += 2;
+    } else b->over = 1;
+    b->n = 16;
+    return bit;
+}
+
+/*
+ * Expands LZEXE's packed image of len bytes into out, which holds max. A
+ * 1 bit is a literal byte; 00 and two bits is a match of 2 to 5 bytes up
+ * to 256 back, distance in the next byte; 01 is a match up to 8K back in
+ * the next word, 13 bits of distance and 3 of length, 3 to 9, or 0 for a
+ * length byte after it: 0 ends the stream, 1 only marks a new segment
+ * and anything else is one less than the length. Returns the bytes
+ * written, or -1 if the stream makes no sense.
+ */
+static long lz_expand(const uint8_t *in, uint32_t len, uint8_t *out, uint32_t max) {
+    struct lz_bits b = { NULL, NULL, 0, 16, 0 };
+    uint32_t pos = 0, dist, count;
+    uint8_t hi;
+
+    if (len < 2) return -1;
+    b.buf = (uint16_t) (in[0] | in[1] << 8);
+    b.p = in + 2;
+    b.end = in + len;
+    for (;;) {
+        if (lz_get(&b)) {
+            if (b.over || b.p >= b.end || pos >= max) return -1;
+            out[pos++] = *b.p++;
+            continue;
+        }
+        if (!lz_get(&b)) {
+            count = lz_get(&b) << 1;
+            count |= lz_get(&b);
+            count += 2;
+            if (b.over || b.p >= b.end) return -1;
+            dist = 0x100 - *b.p++;
+        } else {
+            if (b.over || b.end - b.p < 2) return -1;
+            hi = b.p[1];
+            dist = 0x2000 - ((uint32_t) (hi & 0xF8) << 5 | b.p[0]);
+            b.p += 2;
+            if ((count = (hi & 7) + 2) == 2) {
+                if (b.p >= b.end) return -1;
+                if (!(count = *b.p++)) break;
+                if (count == 1) continue;
+                count++;
+            }
+        }
+        if (dist > pos || count > max - pos) return -1;
+        /* A match no longer than its distance does not overlap what it writes. */
+        if (dist >= count) memcpy(out + pos, out + pos - dist, count);
+        else for (; count; count--, pos++)
+            out[pos] = out[pos - dist];
+        pos += count;
+    }
+    return (long) pos;
+}
+
+/*
+ * Runs LZEXE's unpacker. The packed image is the packedSize paragraphs
+ * just below CS:0 and unpacks to up to extraSize paragraphs more than the
+ * whole load module; the unpacker and its relocation table follow CS:0.
+ */
+static int mz_unlzexe(struct THIS *this, int packer, struct mz_unpacked *u) {
+    const struct exe_lzexe_header *hdr;
+    const uint8_t *in, *tab;
+    uint32_t code = mz_code_offset(this), max, at;
+    long n;
+
+    if (!code || !(hdr = view_at(this, code, sizeof(*hdr)))) return -1;
+    if (hdr->packedSize > this->mz->initCodeSeg) return -1;
+    if (!(in = view_at(this, code - (uint32_t) hdr->packedSize * 16, (uint32_t) hdr->packedSize * 16))) return -1;
+    max = ((uint32_t) this->mz->initCodeSeg + hdr->extraSize + 0x20) * 16;
+    if (max > 0x100000) max = 0x100000;
+    if (!(u->image = arena_alloc(&this->arena, max))) {
+        exe_nomem(this);
+        return -1;
+    }
+    if ((n = lz_expand(in, (uint32_t) hdr->packedSize * 16, u->image, max)) < 0) return -1;
+    u->imageSize = (uint32_t) n;
+
+    at = code + (packer == MZ_PACKER_LZEXE090 ? LZEXE_RELOCS_090 : LZEXE_RELOCS_091);
+    if (at >= this->size || !(tab = view_at(this, at, this->size - at))) return -1;
+    if (mz_unpack_relocs(this, packer == MZ_PACKER_LZEXE090 ? mz_frame_relocs : mz_lzexe_relocs, tab, tab + (this->size - at), u))
+        return -1;
+    u->ip = hdr->realIP;
+    u->cs = hdr->realCS;
+    u->sp = hdr->realSP;
+    u->ss = hdr->realSS;
+    return 0;
+}
+
+/*
+ * Lays u out as an EXE file: a header with the relocations straight
+ * after it, padded to a paragraph, then the image. The program needs as
+ * much memory as the packed one did, less what its image now covers.
+ */
+static uint8_t *mz_rebuild(struct THIS *this, const struct mz_unpacked *u, uint32_t *size) {
+    struct exe_mz_header h;
+    uint32_t hdr = (sizeof(h) + u->relocCount * 4 + 15) & ~15U, total = hdr + u->imageSize, need, have, i;
+    uint8_t *out, *r;
+
+    if (total > 0xFFFFUL * 512) return NULL;
+    if (!(out = arena_calloc(&this->arena, total, 1))) {
+        exe_nomem(this);
+        return NULL;
+    }
+    memset(&h, 0, sizeof(h));
+    h.magic[0] = 'M';
+    h.magic[1] = 'Z';
+    h.lastPageSize = total % 512;
+    h.pageCount = (uint16_t) ((total + 511) / 512);
+    h.relocationEntries = (uint16_t) u->relocCount;
+    h.hdrSize = (uint16_t) (hdr / 16);
+    need = (mz_image_size(this) + 15) / 16 + this->mz->minMemory;
+    have = (u->imageSize + 15) / 16;
+    if (need > have) h.minMemory = need - have > 0xFFFF ? 0xFFFF : (uint16_t) (need - have);
+    h.maxMemory = this->mz->maxMemory < h.minMemory ? h.minMemory : this->mz->maxMemory;
+    h.stackSegment = u->ss;
+    h.stackPointer = u->sp;
+    h.initInstPtr = u->ip;
+    h.initCodeSeg = u->cs;
+    h.relocationOffset = sizeof(h);
+    memcpy(out, &h, sizeof(h));
+    for (i = 0, r = out + sizeof(h); i < u->relocCount; i++, r += 4) {
+        r[0] = (uint8_t) u->relocs[i];
+        r[1] = (uint8_t) (u->relocs[i] >> 8);
+        r[2] = (uint8_t) (u->relocs[i] >> 16);
+        r[3] = (uint8_t) (u->relocs[i] >> 24);
+    }
+    memcpy(out + hdr, u->image, u->imageSize);
+    *size = total;
+    return out;
+}
+
+/*
+ * The program as it was before EXEPACK or LZEXE packed it: the image run
+ * through the packer's own unpacker, its relocation table and registers
+ * put back in an MZ header. Returns the file, *size bytes that stay valid
+ * until this is destroyed, or NULL if the file is not packed with either,
+ * with a warning if it is but the packed data makes no sense. PKLITE is
+ * only recognised.
+ */
+const uint8_t *mz_unpack(struct THIS *this, uint32_t *size) {
+    struct mz_unpacked u;
+    int packer = mz_packer(this, NULL), err;
+
+    if (this->mzunpacked) {
+        *size = this->mz_unpackedSize;
+        return this->mzunpacked;
+    }
+    memset(&u, 0, sizeof(u));
+    if (packer == MZ_PACKER_EXEPACK) err = mz_unexepack(this, &u);
+    else if (packer == MZ_PACKER_LZEXE090 || packer == MZ_PACKER_LZEXE091) err = mz_unlzexe(this, packer, &u);
+    else return NULL;
+    if (err || !(this->mzunpacked = mz_rebuild(this, &u, &this->mz_unpackedSize))) {
+        exe_warn(this, EXE_ERR_MALFORMED, "Bad %s data in %s", mz_packer_names[packer], this->fname);
+        return NULL;
+    }
+    *size = this->mz_unpackedSize;
+    return this->mzunpacked;
+}
+
+/*
+ * Takes the relocation table from the file view in one go and keeps it as
+ * an array of linear addresses (segment * 16 + offset) sorted ascending in
+ * this->mzrelocs, which makes duplicates adjacent and the image bounds check
+ * a matter of looking at the tail.
+ */
+void read_mz_reloc(struct THIS *this) {
+    uint32_t imagesz;
+    int count = this->mz->relocationEntries, i;
+
+    /* Use whatever part of the relocation table is actually present. */
+    while (count && !(this->mzreltab = view_at(this, this->mz->relocationOffset, sizeof(struct exe_mz_reloc) * count)))
+        count--;
+    if (count != this->mz->relocationEntries) exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+    if (!count) return;
+
+    if (!(this->mzrelocs = arena_calloc(&this->arena, count, sizeof(uint32_t)))) {
+        exe_nomem(this);
+        return;
+    }
+    for (i = 0; i < count; i++)
+        this->mzrelocs[i] = ((uint32_t) this->mzreltab[i].segment << 4) + this->mzreltab[i].offset;
+    this->mz_relocCount = count;
+    qsort(this->mzrelocs, count, sizeof(uint32_t), compare_u32);
+
+    imagesz = mz_image_size(this);
+    for (i = 0; i < count; i++) {
+        if (i && this->mzrelocs[i] == this->mzrelocs[i - 1]) this->mz_relocDups++;
+        if (this->mzrelocs[i] + 2 > imagesz) this->mz_relocOutside++;
+    }
+    return;
+}
+
+/* Parses the DOS header and everything hanging off it into this. */
+void read_mz_exe(struct THIS *this) {
+    if (!(this->mz = view_at(this, 0, sizeof(struct exe_mz_header)))) {
+        exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+        return;
+    }
+    if (    ((this->mz->magic[0] == 'M') && (this->mz->magic[1] == 'Z'))
+        ||  ((this->mz->magic[1] == 'M') && (this->mz->magic[0] == 'Z')) ) {
+        if (this->kind == EXE_UNKNOWN) this->kind = EXE_MZ;
+        if (this->mz->relocationEntries && (this->need & NEED_MZ_RELOCS)) IN_PHASE(this, EXE_PHASE_MZ_RELOCS, read_mz_reloc(this));
+        /* check for next header */
+        if((this->noffset == -1) && (this->mz->relocationOffset >= 0x40)) {
+            if (!(this->mzx = view_at(this, sizeof(struct exe_mz_header), sizeof(struct exe_mz_new_header))))
+                exe_warn(this, EXE_ERR_TRUNCATED, "Unexpected end of file: %s", this->fname);
+            else if (this->need & NEED_NEXT)
+                IN_PHASE(this, EXE_PHASE_NEXT, read_next_header(this));
+        }
+    } else this->mz = NULL;
+}
+
+/* Parses whatever this->need asks for out of the mapped file. Returns this->status. */
+int read_exe(struct THIS *this) {
+    if (this->noffset != -1) {
+        this->mzx_user.nextHeader = this->noffset;
+        this->mzx = &this->mzx_user;
+        if (this->need & NEED_NEXT) IN_PHASE(this, EXE_PHASE_NEXT, read_next_header(this));
+    }
+    IN_PHASE(this, EXE_PHASE_MZ, read_mz_exe(this));
+    return this->status;
+}
@@ -56,4 +56,42 @@ struct exe_mz_reloc {
     uint16_t    segment;
 };
 
+/*
+ * What MS EXEPACK leaves at CS:0, in front of its unpacker. The header is
+ * 16 or 18 bytes, IP points just past it and it ends in "RB"; skipLen is
+ * only there in the 18-byte kind.
+ */
+struct exe_exepack_header {
+    uint16_t    realIP;
+    uint16_t    realCS;
+    uint16_t    memStart;                   /* scratch for the unpacker */
+    uint16_t    exepackSize;                /* bytes from CS:0 to the end of the relocation table */
+    uint16_t    realSP;
+    uint16_t    realSS;
+    uint16_t    destLen;                    /* paragraphs of unpacked image */
+    uint16_t    skipLen;                    /* one more than the paragraphs between the packed data and CS:0 */
+};
+
+/* The unpacker's relocation table follows this message. */
+#define EXEPACK_ERROR_MSG   "Packed file is corrupt"
+
+/* LZEXE's, likewise at CS:0; the file says which version at offset 0x1C. */
+struct exe_lzexe_header {
+    uint16_t    realIP;
+    uint16_t    realCS;
+    uint16_t    realSP;
+    uint16_t    realSS;
+    uint16_t    packedSize;                 /* paragraphs of packed image, ending at CS:0 */
+    uint16_t    extraSize;                  /* paragraphs the image grows by */
+    uint16_t    stubSize;                   /* bytes of unpacker and relocation table */
+    uint16_t    checksum;                   /* 0.90 only */
+};
+
+#define LZEXE_RELOCS_090    0x19D           /* relocation table, from CS:0 */
+#define LZEXE_RELOCS_091    0x158
+
+/* PKLITE's version word at offset 0x1C; its copyright string follows at 0x1E. */
+#define PKLITE_EXTRA        0x1000          /* -e, extra compression */
+#define PKLITE_LARGE        0x2000          /* large (multi-segment) compression */
+
 #endif
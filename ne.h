@@ -100,7 +100,7 @@ struct exe_ne_segment {
             uint16_t    segType      : 1;
             uint16_t    allocated    : 1;
             uint16_t    loaded       : 1;
-            uint16_t    _reserved1   : 1;
+            uint16_t    iterated     : 1;      /* the data is iterated records, see exe_ne_iterated */
             uint16_t    relocatable  : 1;
             uint16_t    shared       : 1;
             uint16_t    preload      : 1;
@@ -114,63 +114,162 @@ struct exe_ne_segment {
     uint16_t    minimumAllocation;
 };
 
+/*
+ * The resource table starts with a uint16_t alignment shift, then one of
+ * these per type, each followed by count exe_ne_resource_nameinfos, then
+ * a typeID of 0. Type and resource names follow as length-prefixed
+ * strings, at offsets from the start of the table.
+ */
 struct exe_ne_resource_infoblock {
     uint16_t    typeID; /* integer if high bit set, string offset otherwise. */
     uint16_t    count;
     uint32_t    _reserved;
 };
 
+struct exe_ne_resource_nameinfo {
+    uint16_t    offset;                     /* file offset, in units of 1 << the alignment shift */
+    uint16_t    length;                     /* likewise */
+    uint16_t    flags;                      /* NE_RES_* */
+    uint16_t    resourceID;                 /* integer if high bit set, string offset otherwise. */
+    uint16_t    _handle;
+    uint16_t    _usage;
+};
+
+#define NE_RES_INTEGER      0x8000          /* in typeID and resourceID */
+#define NE_RES_MOVEABLE     0x0010
+#define NE_RES_PURE         0x0020
+#define NE_RES_PRELOAD      0x0040
+
+/* Integer resource types, less NE_RES_INTEGER */
+enum exe_ne_resource_type {
+    RESTYPE_CURSOR = 1,
+    RESTYPE_BITMAP,
+    RESTYPE_ICON,
+    RESTYPE_MENU,
+    RESTYPE_DIALOG,
+    RESTYPE_STRING,
+    RESTYPE_FONTDIR,
+    RESTYPE_FONT,
+    RESTYPE_ACCELERATOR,
+    RESTYPE_RCDATA,
+    RESTYPE_MESSAGETABLE,
+    RESTYPE_GROUP_CURSOR,
+    RESTYPE_GROUP_ICON = 14,
+    RESTYPE_VERSION = 16,
+    RESTYPE_DLGINCLUDE,
+    RESTYPE_PLUGPLAY = 19,
+    RESTYPE_VXD,
+    RESTYPE_ANICURSOR,
+    RESTYPE_ANIICON,
+    RESTYPE_HTML,
+    RESTYPE_COUNT
+};
+
+/*
+ * An iterated segment's data is a run of these, each followed by
+ * byteCount bytes to be repeated iterations times.
+ */
+struct exe_ne_iterated {
+    uint16_t    iterations;
+    uint16_t    byteCount;
+};
+
 /* Not a file format structure per se, just to make it easier to handle */
 struct exe_ne_module { 
     uint8_t     size;
-    uint16_t    *offsets;
+    uint16_t    offset;     /* of the name in the imported names table */
+    const char *name;       /* points into the file image, not NUL-terminated */
 };
 
 struct exe_ne_import {
     uint8_t     size;
     int         offset;     /* For resolving module name table offsets */
-    char *      name;
+    const char *name;       /* points into the file image, not NUL-terminated */
 };
 
+/* An entry table entry, one per ordinal whether the ordinal is used or not */
 struct exe_ne_export {
+    uint8_t     size;       /* of the name, 0 if there is none */
+    const char *name;       /* from the resident or non-resident names table; points into the file image, not NUL-terminated */
+    uint16_t    ordinal;
+    uint8_t     segment;    /* 1-based, NE_BUNDLE_CONSTANT, or 0 if the ordinal is unused */
+    uint8_t     flags;      /* NE_ENTRY_* */
+    uint8_t     movable;    /* came from a movable bundle, by way of an INT 3Fh thunk */
+    uint8_t     resident;   /* the name is in the resident names table */
+    uint16_t    offset;     /* or the value of a constant */
+};
+
+/* A resident or non-resident name, with the ordinal it names */
+struct exe_ne_name {
     uint8_t     size;
-    char *      name;
-    uint8_t     ordinal;
+    uint8_t     resident;
+    uint16_t    ordinal;
+    const char *name;       /* points into the file image, not NUL-terminated */
 };
 
+/* Entry table bundles are a count, an indicator, then count entries of three bytes, or six for movable ones. */
+#define NE_BUNDLE_UNUSED    0x00    /* count ordinals skipped; no entries follow */
+#define NE_BUNDLE_CONSTANT  0xFE    /* the offsets are constants, not addresses */
+#define NE_BUNDLE_MOVABLE   0xFF    /* otherwise the indicator is the fixed segment the entries are in */
+
+#define NE_ENTRY_EXPORTED   0x01
+#define NE_ENTRY_SHARED     0x02    /* uses the shared (global) data segment */
+
+/* Each segment with RELOCINFO set is followed by a uint16_t count and this many of these. */
 struct exe_ne_reloc {
-    uint8_t     addressType;
-    uint8_t     relocationType;
+    uint8_t     addressType;                /* exe_ne_reloc_address_type */
+    uint8_t     relocationType;             /* exe_ne_reloc_type, plus RELFLAG_ADDITIVE */
+    uint16_t    offset;                     /* first location to patch; unless additive, each location holds the offset of the next, up to 0xFFFF */
     union {
         struct { 
-            uint16_t    moduleReference;
+            uint16_t    moduleReference;    /* 1-based index into the module reference table */
             union {
-                uint16_t    importNameOffset;
+                uint16_t    importNameOffset;   /* into the imported names table */
                 uint16_t    importOrdinal;
             };
         };
         struct {
-            uint8_t     segment;
+            uint8_t     segment;            /* 1-based, or NE_MOVABLE_SEGMENT */
             uint8_t     zero;
-            uint16_t    ordinal;
+            uint16_t    ordinal;            /* offset in a fixed segment, entry table ordinal for a movable one */
+        };
+        struct {
+            uint16_t    osFixupType;        /* exe_ne_osfixup_type */
+            uint16_t    _osFixupZero;
         };
     };          
 };
 
+#define NE_MOVABLE_SEGMENT  0xFF
+#define NE_RELOC_CHAIN_END  0xFFFF
+
 enum exe_ne_reloc_address_type {
     RADDR_LOWBYTE,
     RADDR_SELECTOR = 2,
     RADDR_POINTER32,
     RADDR_OFFSET16 = 5,
     RADDR_POINTER48 = 11,
-    RADDR_OFFSET32 = 13
+    RADDR_OFFSET32 = 13,
+    RADDR_MASK = 0x0F
 };
 
 enum exe_ne_reloc_type {
     RELTYPE_INTREF,
     RELTYPE_IMPORD,
     RELTYPE_IMPNAME,
-    RELTYPE_OSFIXUP
+    RELTYPE_OSFIXUP,
+    RELTYPE_MASK = 0x03,
+    RELFLAG_ADDITIVE = 0x04
+};
+
+/* Floating point fixups, patched by Windows to use or not use the x87 */
+enum exe_ne_osfixup_type {
+    OSFIXUP_FIARQQ = 1,                     /* also FJARQQ */
+    OSFIXUP_FISRQQ,                         /* also FJSRQQ */
+    OSFIXUP_FICRQQ,                         /* also FJCRQQ */
+    OSFIXUP_FIERQQ,
+    OSFIXUP_FIDRQQ,
+    OSFIXUP_FIWRQQ
 };
 
 enum exe_ne_header_data_typebits {
@@ -0,0 +1,298 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd
+ * pe.h - Structure information for 32/64-bit Portable Executable format
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PE_H
+#define PE_H
+
+#include <stdint.h>
+
+/* "PE\0\0" followed by the COFF file header */
+struct exe_pe_header {
+    char        magic[4];
+    uint16_t    machine;
+    uint16_t    numberOfSections;
+    uint32_t    timeDateStamp;
+    uint32_t    pointerToSymbolTable;
+    uint32_t    numberOfSymbols;
+    uint16_t    sizeOfOptionalHeader;
+    uint16_t    characteristics;
+};
+
+/* Optional header, PE32 flavour */
+struct exe_pe_optional32 {
+    uint16_t    magic;                  /* PE_OPT_MAGIC32 */
+    uint8_t     linkerMajor;
+    uint8_t     linkerMinor;
+    uint32_t    sizeOfCode;
+    uint32_t    sizeOfInitializedData;
+    uint32_t    sizeOfUninitializedData;
+    uint32_t    addressOfEntryPoint;
+    uint32_t    baseOfCode;
+    uint32_t    baseOfData;
+    uint32_t    imageBase;
+    uint32_t    sectionAlignment;
+    uint32_t    fileAlignment;
+    uint16_t    osMajor;
+    uint16_t    osMinor;
+    uint16_t    imageMajor;
+    uint16_t    imageMinor;
+    uint16_t    subsystemMajor;
+    uint16_t    subsystemMinor;
+    uint32_t    win32VersionValue;
+    uint32_t    sizeOfImage;
+    uint32_t    sizeOfHeaders;
+    uint32_t    checkSum;
+    uint16_t    subsystem;
+    uint16_t    dllCharacteristics;
+    uint32_t    sizeOfStackReserve;
+    uint32_t    sizeOfStackCommit;
+    uint32_t    sizeOfHeapReserve;
+    uint32_t    sizeOfHeapCommit;
+    uint32_t    loaderFlags;
+    uint32_t    numberOfRvaAndSizes;
+};
+
+/* Optional header, PE32+ flavour: no baseOfData, and 64-bit image base, stack and heap sizes */
+struct exe_pe_optional64 {
+    uint16_t    magic;                  /* PE_OPT_MAGIC64 */
+    uint8_t     linkerMajor;
+    uint8_t     linkerMinor;
+    uint32_t    sizeOfCode;
+    uint32_t    sizeOfInitializedData;
+    uint32_t    sizeOfUninitializedData;
+    uint32_t    addressOfEntryPoint;
+    uint32_t    baseOfCode;
+    uint64_t    imageBase;
+    uint32_t    sectionAlignment;
+    uint32_t    fileAlignment;
+    uint16_t    osMajor;
+    uint16_t    osMinor;
+    uint16_t    imageMajor;
+    uint16_t    imageMinor;
+    uint16_t    subsystemMajor;
+    uint16_t    subsystemMinor;
+    uint32_t    win32VersionValue;
+    uint32_t    sizeOfImage;
+    uint32_t    sizeOfHeaders;
+    uint32_t    checkSum;
+    uint16_t    subsystem;
+    uint16_t    dllCharacteristics;
+    uint64_t    sizeOfStackReserve;
+    uint64_t    sizeOfStackCommit;
+    uint64_t    sizeOfHeapReserve;
+    uint64_t    sizeOfHeapCommit;
+    uint32_t    loaderFlags;
+    uint32_t    numberOfRvaAndSizes;
+};
+
+struct exe_pe_datadir {
+    uint32_t    virtualAddress;
+    uint32_t    size;
+};
+
+struct exe_pe_section {
+    char        name[8];                /* not NUL-terminated when all eight are used */
+    uint32_t    virtualSize;
+    uint32_t    virtualAddress;
+    uint32_t    sizeOfRawData;
+    uint32_t    pointerToRawData;
+    uint32_t    pointerToRelocations;
+    uint32_t    pointerToLinenumbers;
+    uint16_t    numberOfRelocations;
+    uint16_t    numberOfLinenumbers;
+    uint32_t    characteristics;        /* PE_SCN_* */
+};
+
+struct exe_pe_import_desc {
+    uint32_t    originalFirstThunk;     /* import lookup table */
+    uint32_t    timeDateStamp;
+    uint32_t    forwarderChain;
+    uint32_t    name;
+    uint32_t    firstThunk;             /* import address table */
+};
+
+struct exe_pe_delay_desc {
+    uint32_t    attributes;             /* PE_DELAY_RVA, or addresses are VAs */
+    uint32_t    dllName;
+    uint32_t    moduleHandle;
+    uint32_t    importAddressTable;
+    uint32_t    importNameTable;
+    uint32_t    boundImportAddressTable;
+    uint32_t    unloadInformationTable;
+    uint32_t    timeDateStamp;
+};
+
+struct exe_pe_export_dir {
+    uint32_t    characteristics;
+    uint32_t    timeDateStamp;
+    uint16_t    majorVersion;
+    uint16_t    minorVersion;
+    uint32_t    name;
+    uint32_t    base;
+    uint32_t    numberOfFunctions;
+    uint32_t    numberOfNames;
+    uint32_t    addressOfFunctions;
+    uint32_t    addressOfNames;
+    uint32_t    addressOfNameOrdinals;
+};
+
+/* An imported module. Names point into the file image and are not NUL-terminated. */
+struct exe_pe_module {
+    const char  *name;
+    uint32_t    nameLen;
+    int         delay;                  /* from the delay import directory */
+    int         first;                  /* index of its first exe_pe_import */
+    int         count;
+};
+
+struct exe_pe_import {
+    const char  *name;                  /* NULL when imported by ordinal */
+    uint32_t    nameLen;
+    uint16_t    hint;                   /* or the ordinal */
+};
+
+struct exe_pe_export {
+    uint32_t    ordinal;
+    uint32_t    rva;
+    const char  *name;                  /* NULL if only exported by ordinal */
+    uint32_t    nameLen;
+    const char  *forwarder;             /* "MODULE.Name" if the RVA points back into the export directory */
+    uint32_t    forwarderLen;
+};
+
+#define PE_OPT_MAGIC32      0x010B
+#define PE_OPT_MAGIC64      0x020B
+#define PE_DELAY_RVA        0x0001
+#define PE_ORDINAL_FLAG32   0x80000000UL
+#define PE_ORDINAL_FLAG64   0x8000000000000000ULL
+
+enum exe_pe_datadir_index {
+    PE_DIR_EXPORT,
+    PE_DIR_IMPORT,
+    PE_DIR_RESOURCE,
+    PE_DIR_EXCEPTION,
+    PE_DIR_SECURITY,                    /* a file offset, not an RVA */
+    PE_DIR_BASERELOC,
+    PE_DIR_DEBUG,
+    PE_DIR_ARCHITECTURE,
+    PE_DIR_GLOBALPTR,
+    PE_DIR_TLS,
+    PE_DIR_LOAD_CONFIG,
+    PE_DIR_BOUND_IMPORT,
+    PE_DIR_IAT,
+    PE_DIR_DELAY_IMPORT,
+    PE_DIR_CLR,
+    PE_DIR_RESERVED,
+    PE_DIR_COUNT
+};
+
+enum exe_pe_machine {
+    PE_MACHINE_UNKNOWN  = 0x0000,
+    PE_MACHINE_I386     = 0x014C,
+    PE_MACHINE_R3000    = 0x0162,
+    PE_MACHINE_R4000    = 0x0166,
+    PE_MACHINE_R10000   = 0x0168,
+    PE_MACHINE_WCEMIPSV2 = 0x0169,
+    PE_MACHINE_ALPHA    = 0x0184,
+    PE_MACHINE_SH3      = 0x01A2,
+    PE_MACHINE_SH3DSP   = 0x01A3,
+    PE_MACHINE_SH4      = 0x01A6,
+    PE_MACHINE_SH5      = 0x01A8,
+    PE_MACHINE_ARM      = 0x01C0,
+    PE_MACHINE_THUMB    = 0x01C2,
+    PE_MACHINE_ARMNT    = 0x01C4,
+    PE_MACHINE_AM33     = 0x01D3,
+    PE_MACHINE_POWERPC  = 0x01F0,
+    PE_MACHINE_POWERPCFP = 0x01F1,
+    PE_MACHINE_IA64     = 0x0200,
+    PE_MACHINE_MIPS16   = 0x0266,
+    PE_MACHINE_ALPHA64  = 0x0284,
+    PE_MACHINE_MIPSFPU  = 0x0366,
+    PE_MACHINE_MIPSFPU16 = 0x0466,
+    PE_MACHINE_EBC      = 0x0EBC,
+    PE_MACHINE_RISCV32  = 0x5032,
+    PE_MACHINE_RISCV64  = 0x5064,
+    PE_MACHINE_AMD64    = 0x8664,
+    PE_MACHINE_M32R     = 0x9041,
+    PE_MACHINE_ARM64    = 0xAA64
+};
+
+enum exe_pe_subsystem {
+    PE_SUBSYS_UNKNOWN,
+    PE_SUBSYS_NATIVE,
+    PE_SUBSYS_WINDOWS_GUI,
+    PE_SUBSYS_WINDOWS_CUI,
+    PE_SUBSYS_OS2_CUI = 5,
+    PE_SUBSYS_POSIX_CUI = 7,
+    PE_SUBSYS_NATIVE_WINDOWS,
+    PE_SUBSYS_WINDOWS_CE_GUI,
+    PE_SUBSYS_EFI_APPLICATION,
+    PE_SUBSYS_EFI_BOOT_DRIVER,
+    PE_SUBSYS_EFI_RUNTIME_DRIVER,
+    PE_SUBSYS_EFI_ROM,
+    PE_SUBSYS_XBOX,
+    PE_SUBSYS_WINDOWS_BOOT = 16
+};
+
+/* COFF header characteristics */
+#define PE_FILE_RELOCS_STRIPPED         0x0001
+#define PE_FILE_EXECUTABLE_IMAGE        0x0002
+#define PE_FILE_LINE_NUMS_STRIPPED      0x0004
+#define PE_FILE_LOCAL_SYMS_STRIPPED     0x0008
+#define PE_FILE_AGGRESSIVE_WS_TRIM      0x0010
+#define PE_FILE_LARGE_ADDRESS_AWARE     0x0020
+#define PE_FILE_BYTES_REVERSED_LO       0x0080
+#define PE_FILE_32BIT_MACHINE           0x0100
+#define PE_FILE_DEBUG_STRIPPED          0x0200
+#define PE_FILE_REMOVABLE_RUN_FROM_SWAP 0x0400
+#define PE_FILE_NET_RUN_FROM_SWAP       0x0800
+#define PE_FILE_SYSTEM                  0x1000
+#define PE_FILE_DLL                     0x2000
+#define PE_FILE_UP_SYSTEM_ONLY          0x4000
+#define PE_FILE_BYTES_REVERSED_HI       0x8000
+
+/* Optional header DLL characteristics */
+#define PE_DLL_HIGH_ENTROPY_VA          0x0020
+#define PE_DLL_DYNAMIC_BASE             0x0040
+#define PE_DLL_FORCE_INTEGRITY          0x0080
+#define PE_DLL_NX_COMPAT                0x0100
+#define PE_DLL_NO_ISOLATION             0x0200
+#define PE_DLL_NO_SEH                   0x0400
+#define PE_DLL_NO_BIND                  0x0800
+#define PE_DLL_APPCONTAINER             0x1000
+#define PE_DLL_WDM_DRIVER               0x2000
+#define PE_DLL_GUARD_CF                 0x4000
+#define PE_DLL_TERMINAL_SERVER_AWARE    0x8000
+
+/* Section characteristics */
+#define PE_SCN_CNT_CODE                 0x00000020
+#define PE_SCN_CNT_INITIALIZED_DATA     0x00000040
+#define PE_SCN_CNT_UNINITIALIZED_DATA   0x00000080
+#define PE_SCN_LNK_INFO                 0x00000200
+#define PE_SCN_LNK_REMOVE               0x00000800
+#define PE_SCN_LNK_COMDAT               0x00001000
+#define PE_SCN_GPREL                    0x00008000
+#define PE_SCN_LNK_NRELOC_OVFL          0x01000000
+#define PE_SCN_MEM_DISCARDABLE          0x02000000
+#define PE_SCN_MEM_NOT_CACHED           0x04000000
+#define PE_SCN_MEM_NOT_PAGED            0x08000000
+#define PE_SCN_MEM_SHARED               0x10000000
+#define PE_SCN_MEM_EXECUTE              0x20000000
+#define PE_SCN_MEM_READ                 0x40000000
+#define PE_SCN_MEM_WRITE                0x80000000
+
+#endif /* PE_H */
@@ -0,0 +1,160 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd 
+ * pool.c - Work-stealing parallel loop over an index range
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE 
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY 
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER 
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING 
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include "pool.h"
+
+#ifdef USE_THREADS
+# include <pthread.h>
+# include <unistd.h>
+
+/*
+ * Each worker starts out owning an equal slice [head, tail) of the index
+ * range and takes work from the front of it. A worker whose slice runs dry
+ * steals the back half of the next victim that still has work, so one
+ * slow file (or page, or segment) never leaves the other cores idle.
+ */
+struct pool_slice {
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+};
+
+struct pool {
+    struct pool_slice *slices;
+    int nthreads;
+    pool_fn fn;
+    void *ctx;
+};
+
+struct pool_worker {
+    struct pool *pool;
+    int id;
+};
+
+/* Set in pool threads so a nested pool_run() just loops instead of oversubscribing the machine. */
+static _Thread_local int pool_nested;
+
+static int pool_take(struct pool *p, int self, int *index) {
+    struct pool_slice *own = &p->slices[self], *victim;
+    int i, head, tail, n;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->head < own->tail) {
+        *index = own->head++;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (i = 1; i < p->nthreads; i++) {
+        victim = &p->slices[(self + i) % p->nthreads];
+        pthread_mutex_lock(&victim->lock);
+        n = victim->tail - victim->head;
+        if (n > 0) {
+            /* Take the back half, rounding up so a single leftover item can be stolen too. */
+            tail = victim->tail;
+            head = tail - (n + 1) / 2;
+            victim->tail = head;
+            pthread_mutex_unlock(&victim->lock);
+            pthread_mutex_lock(&own->lock);
+            own->head = head + 1;
+            own->tail = tail;
+            pthread_mutex_unlock(&own->lock);
+            *index = head;
+            return 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return 0;
+}
+
+static void *pool_thread(void *arg) {
+    struct pool_worker *w = arg;
+    int index;
+
+    pool_nested = 1;
+    while (pool_take(w->pool, w->id, &index))
+        w->pool->fn(w->pool->ctx, index, w->id);
+    return NULL;
+}
+#endif /* USE_THREADS */
+
+int pool_default_threads(void) {
+#if defined(USE_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (n > 0) return n > 256 ? 256 : (int) n;
+#endif
+    return 1;
+}
+
+/* Runs fn for every index in [0, count) on up to nthreads threads. Returns the number of threads used. */
+int pool_run(int count, int nthreads, pool_fn fn, void *ctx) {
+    int i;
+#ifdef USE_THREADS
+    struct pool p;
+    struct pool_worker *workers;
+    pthread_t *threads;
+    int started;
+
+    if (nthreads <= 0) nthreads = pool_default_threads();
+    if (nthreads > count) nthreads = count;
+    if (nthreads > 1 && !pool_nested) {
+        p.slices = malloc(sizeof(struct pool_slice) * nthreads);
+        workers = malloc(sizeof(struct pool_worker) * nthreads);
+        threads = malloc(sizeof(pthread_t) * nthreads);
+        if (p.slices && workers && threads) {
+            p.nthreads = nthreads;
+            p.fn = fn;
+            p.ctx = ctx;
+            for (i = 0; i < nthreads; i++) {
+                pthread_mutex_init(&p.slices[i].lock, NULL);
+                p.slices[i].head = (int) (((long long) count * i) / nthreads);
+                p.slices[i].tail = (int) (((long long) count * (i + 1)) / nthreads);
+                workers[i].pool = &p;
+                workers[i].id = i;
+            }
+            /* The calling thread is worker 0; if a thread fails to start, the others steal its slice. */
+            for (started = 1; started < nthreads; started++)
+                if (pthread_create(&threads[started], NULL, pool_thread, &workers[started])) break;
+            pool_thread(&workers[0]);
+            pool_nested = 0;
+            for (i = 1; i < started; i++)
+                pthread_join(threads[i], NULL);
+            /* Anything left in the slices of threads that never started. */
+            for (i = started; i < nthreads; i++)
+                while (p.slices[i].head < p.slices[i].tail)
+                    fn(ctx, p.slices[i].head++, 0);
+            for (i = 0; i < nthreads; i++)
+                pthread_mutex_destroy(&p.slices[i].lock);
+            free(threads);
+            free(workers);
+            free(p.slices);
+            return started;
+        }
+        free(threads);
+        free(workers);
+        free(p.slices);
+    }
+#else
+    (void) nthreads;
+#endif
+    for (i = 0; i < count; i++)
+        fn(ctx, i, 0);
+    return 1;
+}
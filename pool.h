@@ -0,0 +1,38 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd 
+ * pool.h - Work-stealing parallel loop over an index range
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE 
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY 
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER 
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING 
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* Threads where we have them; DOS, OS/2 1.x and friends just run the loop. */
+#if defined(HAVE_PTHREAD)
+# define USE_THREADS
+#elif !defined(HAVE_CONFIG_H) && (defined(__unix__) || defined(__APPLE__))
+# define USE_THREADS
+#endif
+
+/* Called once per index; worker is 0..nthreads-1 and stable for the calling thread. */
+typedef void (*pool_fn)(void *ctx, int index, int worker);
+
+int pool_default_threads(void);
+int pool_run(int count, int nthreads, pool_fn fn, void *ctx);
+
+#endif /* POOL_H */
@@ -23,7 +23,7 @@
 #include <unistd.h>
 #include <limits.h>
 #include <errno.h>
-#include <fcntl.h>
+#include <getopt.h>
 #include <err.h> /* -I. or such for platforms without err.h */
 
 #ifdef HAVE_CONFIG_H
@@ -32,493 +32,3095 @@
 # define VERSION "0.1.4"
 #endif
 
-/* Big assumptions on little-endianiness here */
-
-#include "mz.h"
-#include "ne.h"
-#include "le.h"
-#include "w3.h"
-
-
-struct THIS {
-    FILE *fd;                               /* standard I/O library file descriptor */
-    char *fname;                            /* File name of the executable we're inspecting, passed as the sole argument. */
-    struct exe_mz_header *mz;               /* DOS (MZ) header */
-    struct exe_mz_new_header *mzx;          /* eXtended DOS (MZ) header */
-    struct exe_ne_header *ne;               /* New Executable (NE) header */
-    struct exe_ne_segment *nesegs;          /* NE segments */
-    int ne_importCount;                     /* number of entries in NE imported names table  */
-    int ne_moduleCount;                     /* number of module references in modules table */
-    struct exe_ne_module *nemods;           /* NE imported modules */
-    struct exe_le_header *le;               /* Linear Executable (LE/LX) header */
-    struct exe_w3_header *w3;               /* W3 header */
-    int wx_modcount;                        /* W3/W4 LE module count */
+#if defined(HAVE_DIRENT_H) || (!defined(HAVE_CONFIG_H) && (defined(__unix__) || defined(__APPLE__)))
+# define USE_DIRENT
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <dirent.h>
+#endif
+
+/* Files come in on standard input and resources go out on standard output as they are, so both have to be binary. */
+#if defined(_WIN32) || defined(__MSDOS__) || defined(__DOS__) || defined(__OS2__)
+# define NEED_SETMODE
+# include <io.h>
+# include <fcntl.h>
+#endif
+
+#include <time.h>
+#include <stdarg.h>
+#include "pool.h"
+#include "cache.h"
+#include "graph.h"
+#include "readexe.h"
+
+static const char *exe_kind_names[EXE_KIND_COUNT] = { "unknown", "MZ", "NE", "LE", "LX", "W3", "PE", "W4" };
+
+enum out_format {
+    FORMAT_TEXT,
+    FORMAT_JSON,                            /* one indented object per file */
+    FORMAT_NDJSON                           /* one object per line, one line per file */
+};
+
+#define JSON_MAX_DEPTH 32
+
+/* Output for one file is collected here and written out whole. */
+struct outbuf {
+    char *buf;
+    size_t len;
+    size_t cap;
+    int pretty;                             /* indent JSON, otherwise keep it on one line */
+    int depth;                              /* JSON nesting depth */
+    uint32_t first;                         /* bit n set while nothing has been written at depth n yet */
+};
+
+struct THIS;
+
+/* Which header a field lives in; fields of headers the file doesn't have are left out. */
+enum field_header {
+    FIELD_FILE,
+    FIELD_MZ,
+    FIELD_NE,
+    FIELD_LE,
+    FIELD_W3,
+    FIELD_PE
+};
+
+struct field {
+    const char *name;                       /* as given to --fields */
+    enum field_header header;
+    unsigned need;                          /* NEED_* */
+    void (*emit)(struct THIS *this, const char *key);
+};
+
+/* A compiled --fields selection */
+struct field_plan {
+    const struct field **fields;            /* in the order asked for, without repeats */
+    int count;
+    unsigned need;                          /* union of the fields' NEED_* bits */
+};
+
+struct options {
+    long int noffset;                       /* -n: offset to next header, or -1 to read it from the MZ header */
+    int recursive;                          /* -r: descend into directories */
+    int jobs;                               /* -j: worker threads for multi-file scans, 0 for one per core */
+    int summary;                            /* -s: summarise relocation tables rather than list every entry */
+    enum out_format format;                 /* --format */
+    const struct field_plan *fields;        /* --fields, or NULL for the full report */
+    unsigned need;                          /* NEED_* tables to read */
+    int stats;                              /* --stats: report what each parser phase cost */
+    struct cache *cache;                    /* --cache, or NULL */
+    unsigned hash;                          /* --hash: HASH_* to show for each segment, object and module */
+    int verify;                             /* --verify: check the stored checksums */
+};
+
+const char *le_forwarder_ref(struct THIS *this, const struct exe_le_entry *ent, char *buf);
+
+void print_text(struct THIS *this);
+void print_mz_header(struct THIS *this);
+void print_mz_relocs(struct THIS *this);
+void print_next_header(struct THIS *this);
+void print_ne(struct THIS *this);
+void print_ne_header(struct THIS *this);
+void print_ne_modules(struct THIS *this);
+void print_ne_segments(struct THIS *this);
+void print_ne_relocs(struct THIS *this);
+void print_ne_resources(struct THIS *this);
+void print_ne_exports(struct THIS *this);
+void print_le(struct THIS *this);
+void print_le_header(struct THIS *this);
+void print_le_objects(struct THIS *this);
+void print_le_pages(struct THIS *this);
+void print_le_names(struct THIS *this, const char *title, const struct exe_le_name *names, int count);
+void print_le_entries(struct THIS *this);
+void print_le_imports(struct THIS *this);
+void print_le_fixups(struct THIS *this);
+void print_w3(struct THIS *this);
+void print_w4(struct THIS *this);
+void print_pe(struct THIS *this);
+void print_pe_header(struct THIS *this);
+void print_pe_dirs(struct THIS *this);
+void print_pe_sections(struct THIS *this);
+void print_pe_imports(struct THIS *this);
+void print_pe_exports(struct THIS *this);
+void print_json(struct THIS *this);
+void json_mz(struct THIS *this);
+void json_ne(struct THIS *this);
+void json_le(struct THIS *this);
+void json_w3(struct THIS *this);
+void json_pe(struct THIS *this);
+void print_fields(struct THIS *this);
+struct field_plan *compile_fields(const char *spec);
+void free_fields(struct field_plan *plan);
+
+void oprintf(struct outbuf *out, const char *format, ...);
+void out_flush(struct outbuf *out, FILE *fp);
+void json_open(struct outbuf *out, const char *key, char bracket);
+void json_close(struct outbuf *out, char bracket);
+void json_uint(struct outbuf *out, const char *key, uint64_t value);
+void json_int(struct outbuf *out, const char *key, int64_t value);
+void json_bool(struct outbuf *out, const char *key, int value);
+void json_str(struct outbuf *out, const char *key, const char *s);
+void json_strn(struct outbuf *out, const char *key, const char *s, size_t len);
+void print_hash(struct THIS *this, int (*hashfn)(struct THIS *, int, unsigned, struct exe_hash *), int i);
+void json_hash(struct THIS *this, int (*hashfn)(struct THIS *, int, unsigned, struct exe_hash *), int i);
+void print_checksums(struct THIS *this);
+void json_checksums(struct THIS *this);
+void print_stats(struct THIS *this);
+void json_stats(struct THIS *this);
+int scan_file(const char *fname, const struct options *opts, struct outbuf *out, struct exe_stats *total, int worker);
+void display_help(void);
+int main(int argc, char *argv[]);
+
+/* printf() into the file's output buffer. */
+void oprintf(struct outbuf *out, const char *format, ...) {
+    va_list ap;
+    size_t need;
+    int n;
+
+    va_start(ap, format);
+    n = vsnprintf(out->buf ? out->buf + out->len : NULL, out->buf ? out->cap - out->len : 0, format, ap);
+    va_end(ap);
+    if (n < 0) return;
+    need = out->len + (size_t) n + 1;
+    if (need > out->cap) {
+        if (out->cap < 4096) out->cap = 4096;
+        while (out->cap < need) out->cap *= 2;
+        if (!(out->buf = realloc(out->buf, out->cap))) err(1, "Cannot allocate memory");
+        va_start(ap, format);
+        vsnprintf(out->buf + out->len, out->cap - out->len, format, ap);
+        va_end(ap);
+    }
+    out->len += (size_t) n;
+}
+
+/* One fwrite() per flush, so reports from concurrent workers never interleave. */
+void out_flush(struct outbuf *out, FILE *fp) {
+    if (out->len) fwrite(out->buf, 1, out->len, fp);
+    out->len = 0;
+}
+
+/*
+ * A small JSON writer on top of oprintf(). Each value is preceded by a
+ * comma unless it is the first at its depth; in pretty mode every value
+ * also starts a new, indented line. key is NULL inside arrays.
+ */
+static void json_key(struct outbuf *out, const char *key) {
+    if (out->depth && out->depth < JSON_MAX_DEPTH && !(out->first & (1UL << out->depth))) oprintf(out, ",");
+    if (out->depth < JSON_MAX_DEPTH) out->first &= ~(1UL << out->depth);
+    if (out->pretty && out->depth) oprintf(out, "\n%*s", out->depth * 2, "");
+    if (key) oprintf(out, out->pretty ? "\"%s\": " : "\"%s\":", key);
+}
+
+void json_open(struct outbuf *out, const char *key, char bracket) {
+    json_key(out, key);
+    oprintf(out, "%c", bracket);
+    out->depth++;
+    if (out->depth < JSON_MAX_DEPTH) out->first |= 1UL << out->depth;
+}
+
+void json_close(struct outbuf *out, char bracket) {
+    int empty = out->depth < JSON_MAX_DEPTH && (out->first & (1UL << out->depth));
+
+    out->depth--;
+    if (out->pretty && !empty) oprintf(out, "\n%*s", out->depth * 2, "");
+    oprintf(out, "%c", bracket);
+}
+
+void json_uint(struct outbuf *out, const char *key, uint64_t value) {
+    json_key(out, key);
+    oprintf(out, "%"PRIu64, value);
+}
+
+void json_int(struct outbuf *out, const char *key, int64_t value) {
+    json_key(out, key);
+    oprintf(out, "%"PRId64, value);
+}
+
+void json_bool(struct outbuf *out, const char *key, int value) {
+    json_key(out, key);
+    oprintf(out, "%s", value ? "true" : "false");
+}
+
+/* Strings from the file are in whatever code page the linker used; bytes above 0x7F are passed through as U+0080..U+00FF. */
+void json_strn(struct outbuf *out, const char *key, const char *s, size_t len) {
+    const unsigned char *p = (const unsigned char *) s;
+    size_t i;
+
+    json_key(out, key);
+    oprintf(out, "\"");
+    for (i = 0; i < len; i++) {
+        if (p[i] == '"' || p[i] == '\\')
+            oprintf(out, "\\%c", p[i]);
+        else if (p[i] < 0x20 || p[i] >= 0x7F)
+            oprintf(out, "\\u%04x", p[i]);
+        else
+            oprintf(out, "%c", p[i]);
+    }
+    oprintf(out, "\"");
+}
+
+void json_str(struct outbuf *out, const char *key, const char *s) {
+    json_strn(out, key, s, strlen(s));
+}
+
+static const char *ne_raddr_name(uint8_t type) {
+    switch (type & RADDR_MASK) {
+        case RADDR_LOWBYTE:     return "LOBYTE";
+        case RADDR_SELECTOR:    return "SELECTOR";
+        case RADDR_POINTER32:   return "FARPTR";
+        case RADDR_OFFSET16:    return "OFFSET";
+        case RADDR_POINTER48:   return "FARPTR48";
+        case RADDR_OFFSET32:    return "OFFSET32";
+        default:                return "UNKNOWN";
+    }
+}
+
+static const char *ne_osfixup_name(uint16_t type) {
+    switch (type) {
+        case OSFIXUP_FIARQQ:    return "FIARQQ/FJARQQ";
+        case OSFIXUP_FISRQQ:    return "FISRQQ/FJSRQQ";
+        case OSFIXUP_FICRQQ:    return "FICRQQ/FJCRQQ";
+        case OSFIXUP_FIERQQ:    return "FIERQQ";
+        case OSFIXUP_FIDRQQ:    return "FIDRQQ";
+        case OSFIXUP_FIWRQQ:    return "FIWRQQ";
+        default:                return "unknown";
+    }
+}
+
+static const char *ne_data_type_name(uint8_t type) {
+    switch (type) {
+        case DATA_SINGLEDATA:   return "SINGLEDATA";
+        case DATA_MULTIPLEDATA: return "MULTIPLEDATA";
+        case DATA_AUTODATA:     return "AUTODATA";
+        default:                return "Not indicated";
+    }
+}
+
+static const char *ne_app_type_name(uint8_t type) {
+    switch (type) {
+        case APP_FULLSCREEN:    return "OS/2 Fullscreen CUI application";
+        case APP_COMPATIBLE:    return "OS/2 Presentation Manager compatible CUI application";
+        case APP_WINPM:         return "Windows or Presentation Manager GUI application";
+        default:                return "Not indicated";
+    }
+}
+
+static const char *ne_target_os_name(uint8_t os) {
+    switch (os) {
+        case OS_OS2:            return "OS/2";
+        case OS_WINDOWS:        return "Windows";
+        case OS_MSDOS:          return "MT MS-DOS 4.0";
+        case OS_WIN386:         return "Windows/386";
+        case OS_BOSS:           return "Borland Operating System Services or HX Extender DPMI-16";
+        case OS_HX:             return "HX Extender DPMI-32";
+        case OS_PHARLAP286OS2:  return "Phar Lap 286|DOS-Extender (OS/2)";
+        case OS_PHARLAP286WIN:  return "Phar Lap 286|DOS-Extender (Windows)";
+        default:                return "Unknown";
+    }
+}
+
+static int compare_u16(const void *a, const void *b) {
+    return (int) *(const uint16_t *) a - (int) *(const uint16_t *) b;
+}
+
+/* Number of relocations that patch the same linear address as the given one. */
+static int mz_reloc_hits(struct THIS *this, uint32_t linear) {
+    int lo = 0, hi = this->mz_relocCount, mid, n = 0;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (this->mzrelocs[mid] < linear) lo = mid + 1; else hi = mid;
+    }
+    while (lo < this->mz_relocCount && this->mzrelocs[lo++] == linear) n++;
+    return n;
+}
+
+/* The packer's name, with PKLITE's version and options, into buf (32 bytes). */
+static const char *mz_packer_desc(struct THIS *this, char *buf) {
+    uint16_t v = 0;
+    int packer = mz_packer(this, &v);
+
+    if (packer != MZ_PACKER_PKLITE) return mz_packer_names[packer];
+    sprintf(buf, "%s %u.%02u%s%s", mz_packer_names[packer], (v >> 8) & 0x0F, v & 0xFF,
+        v & PKLITE_EXTRA ? ", extra" : "", v & PKLITE_LARGE ? ", large" : "");
+    return buf;
+}
+
+/*
+ * Text output
+ */
+
+void print_mz_header(struct THIS *this) {
+    const uint32_t mz_page_size = 512;
+    const uint32_t mz_paragraph_size = 16;
+    uint32_t memuse;
+    char buf[32];
+
+    oprintf(this->out, "%s:\n", this->fname);
+    oprintf(this->out, "DOS executable with magic:\t%c%c (0x%"PRIx8"%"PRIx8")\n", this->mz->magic[0], this->mz->magic[1], this->mz->magic[1], this->mz->magic[0]);
+    oprintf(this->out, "Number of executable pages:\t0x%04"PRIx16" (%"PRIu32"+ bytes)\n", this->mz->pageCount, ((this->mz->pageCount - 1) * mz_page_size));
+    oprintf(this->out, "Size of final page:\t\t0x%08"PRIx16" (%"PRIu16" bytes)\n", this->mz->lastPageSize, this->mz->lastPageSize);
+    memuse = (((this->mz->pageCount - 1) * mz_page_size) + this->mz->lastPageSize);
+    oprintf(this->out, "Total code size:\t\t0x%08"PRIx32" (%"PRIu32" bytes)\n", memuse, memuse);
+    oprintf(this->out, "Total relocation entries:\t0x%04"PRIx16"\n", this->mz->relocationEntries);
+    oprintf(this->out, "Header size in paragraphs:\t0x%04"PRIx16" (%"PRIu32" bytes)\n", this->mz->hdrSize, (this->mz->hdrSize * mz_paragraph_size));
+    oprintf(this->out, "Minimum heap in paragraphs:\t0x%04"PRIx16" (%"PRIu32" bytes)\n", this->mz->minMemory, (this->mz->minMemory * mz_paragraph_size));
+    oprintf(this->out, "Maximum heap in paragraphs:\t0x%04"PRIx16" (%"PRIu32" bytes)\n", this->mz->maxMemory, (this->mz->maxMemory * mz_paragraph_size));
+    memuse += (this->mz->minMemory * mz_paragraph_size);
+    oprintf(this->out, "Minimum memory to load:\t\t%"PRIu32" bytes\n", memuse);
+    oprintf(this->out, "Initial CS:IP (entrypoint):\t%04"PRIx16":%04"PRIx16"\n", this->mz->initCodeSeg, this->mz->initInstPtr);
+    oprintf(this->out, "Initial SS:SP (stack):\t\t%04"PRIx16":%04"PRIx16"\n", this->mz->stackSegment, this->mz->stackPointer);
+    oprintf(this->out, "Checksum:\t\t\t0x%04"PRIx16"\n", this->mz->checksum);
+    oprintf(this->out, "Relocation table offset:\t0x%04"PRIx16"\n", this->mz->relocationOffset);
+    oprintf(this->out, "Overlay:\t\t\t0x%04"PRIx16"\n", this->mz->overlayNumber);
+    if (this->need & NEED_MZ_PACKER && mz_packer(this, NULL)) oprintf(this->out, "Packed with:\t\t\t%s\n", mz_packer_desc(this, buf));
+    oprintf(this->out, "\n");
+}
+
+/* With -s only the per-segment histogram and the duplicate/out-of-image counts are printed. */
+void print_mz_relocs(struct THIS *this) {
+    const struct exe_mz_reloc *reloc = this->mzreltab;
+    uint16_t *segs;
+    uint32_t imagesz, linear;
+    int count = this->mz_relocCount, i, run, hits;
+
+    oprintf(this->out, "MZ EXE relocaton table\n"
+           "Number of relocations: %d\n", this->mz->relocationEntries);
+    if (!count) return;
+
+    if (!this->opts->summary) {
+        imagesz = mz_image_size(this);
+        for (i = 0; i < count; i++) {
+            linear = ((uint32_t) reloc[i].segment << 4) + reloc[i].offset;
+            hits = this->mz_relocDups ? mz_reloc_hits(this, linear) : 1;
+            oprintf(this->out, "  [%d] %04x:%04x%s%s\n", i, reloc[i].segment, reloc[i].offset,
+                hits > 1 ? " (duplicate)" : "", linear + 2 > imagesz ? " (outside image)" : "");
+        }
+        return;
+    }
+
+    if (!(segs = malloc(sizeof(uint16_t) * count))) err(1, "Cannot allocate memory");
+    for (i = 0; i < count; i++)
+        segs[i] = reloc[i].segment;
+    qsort(segs, count, sizeof(uint16_t), compare_u16);
+    oprintf(this->out, "  Segment   Relocations\n");
+    for (i = 0; i < count; i += run) {
+        for (run = 1; i + run < count && segs[i + run] == segs[i]; run++);
+        oprintf(this->out, "  0x%04"PRIx16"    %6d\n", segs[i], run);
+    }
+    free(segs);
+    oprintf(this->out, "  Lowest fixup:\t\t0x%05"PRIx32"\n", this->mzrelocs[0]);
+    oprintf(this->out, "  Highest fixup:\t0x%05"PRIx32"\n", this->mzrelocs[count - 1]);
+    oprintf(this->out, "  Duplicates:\t\t%lu\n", this->mz_relocDups);
+    oprintf(this->out, "  Outside image:\t%lu\n", this->mz_relocOutside);
+}
+
+void print_ne_header(struct THIS *this) {
+    oprintf(this->out, "New Executable with magic:\t%c%c\n", this->ne->magic[0], this->ne->magic[1]);
+    oprintf(this->out, "Linker version:\t\t\t%"PRIu8".%"PRIu8"\n", this->ne->linkerMajor, this->ne->linkerMinor);
+    oprintf(this->out, "Entry table offset:\t\t0x%04" PRIx16 " (File offset 0x%08" PRIx32 ")\n", this->ne->entryTableOffset, ((uint32_t) this->ne->entryTableOffset + this->mzx->nextHeader));
+    oprintf(this->out, "Entry table size:\t\t0x%04"PRIx16" (%"PRIu16" bytes)\n", this->ne->entryTableSize, this->ne->entryTableSize);
+    oprintf(this->out, "Header CRC:\t\t\t0x%08"PRIx32"\n", this->ne->fileCrc);
+    oprintf(this->out, ".EXE Flags:\t\t\t0x%02"PRIx8"\n", this->ne->progFlags);
+    oprintf(this->out, " - Data Segment Model:\t\t%s\n", ne_data_type_name(this->ne->dataType));
+    oprintf(this->out, " - Global initialization:\t%s\n", this->ne->globalInit ? "true" : "false");
+    oprintf(this->out, " - Protected Mode only:\t\t%s\n", this->ne->pmModeOnly ? "true" : "false");
+    oprintf(this->out, " - 8086 opcodes used:\t\t%s\n", this->ne->ops8086 ? "true" : "false");
+    oprintf(this->out, " - 80286 opcodes used:\t\t%s\n", this->ne->ops80286 ? "true" : "false");
+    oprintf(this->out, " - 80386 opcodes used:\t\t%s\n", this->ne->ops80386 ? "true" : "false");
+    oprintf(this->out, " - FPU/80x87 opcodes used:\t%s\n", this->ne->ops80x87 ? "true" : "false");
+    oprintf(this->out, "Application flags:\t\t0x%02"PRIx8"\n", this->ne->appFlags);
+    oprintf(this->out, " - Application type:\t\t%s\n", ne_app_type_name(this->ne->appType));
+    oprintf(this->out, " - OS/2 Family executable:\t%s\n", this->ne->os2FamExec ? "true" : "false");
+    oprintf(this->out, " - Is executable:\t\t%s\n", this->ne->executable ? "true" : "false");
+    oprintf(this->out, " - Generated with link errors:\t%s\n", this->ne->linkErrors ? "true" : "false");
+    oprintf(this->out, " - Is library (DLL or driver):\t%s\n", this->ne->libraryBit ? "true" : "false");
+    oprintf(this->out, "AUTODATA segment address:\t0x%04"PRIx16"\n", this->ne->autoDataSegAddr);
+    oprintf(this->out, "Initial heap size:\t\t0x%04"PRIx16"\n", this->ne->initHeapSize);
+    oprintf(this->out, "Initial stack size:\t\t0x%04"PRIx16"\n", this->ne->initStackSize);
+    oprintf(this->out, "Initial CS:IP (entrypoint):\t%04"PRIx16":%04"PRIx16"\n", (this->ne->entryPoint >> 16), (this->ne->entryPoint & 0xFFFF));
+    oprintf(this->out, "Initial SS:SP (stack):\t\t%04"PRIx16":%04"PRIx16"\n", (this->ne->initStackPtr >> 16), (this->ne->initStackPtr & 0xFFFF));
+    oprintf(this->out, "Segment count:\t\t\t0x%04"PRIx16" (%"PRIu16")\n", this->ne->segmentCount, this->ne->segmentCount);
+    oprintf(this->out, "Module reference count:\t\t%04"PRIx16" (%"PRIu16")\n", this->ne->modRefCount, this->ne->modRefCount);
+    oprintf(this->out, "Non-resident name table size:\t0x%04"PRIx16" (%"PRIu16" bytes)\n", this->ne->nonResidentTableSize, this->ne->nonResidentTableSize);
+    oprintf(this->out, "Offset of segment table:\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->segmentTableOffset, (this->ne->segmentTableOffset + this->mzx->nextHeader));
+    oprintf(this->out, "Offset of resource table:\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->resourceTableOffset, (this->ne->resourceTableOffset + this->mzx->nextHeader));
+    oprintf(this->out, "Offset of resident name table:\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->residentNamesTableOffset, (this->ne->residentNamesTableOffset + this->mzx->nextHeader));
+    oprintf(this->out, "Offset of module table:\t\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->modulesTableOffset, (this->ne->modulesTableOffset + this->mzx->nextHeader));
+    oprintf(this->out, "Offset of imported names table:\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->importedNamesTableOffset, (this->ne->importedNamesTableOffset + this->mzx->nextHeader));
+    oprintf(this->out, "Non-resident names table:\t0x%08"PRIx32" (File offset)\n", this->ne->nonResidentTableOffset);
+    oprintf(this->out, "Movable entry points:\t\t0x%08"PRIx32" (%"PRIu32")\n", this->ne->movableEntryPoints, this->ne->movableEntryPoints);
+    oprintf(this->out, "Offset shift count:\t\t0x%04"PRIx16" (%"PRIu16")\n", this->ne->offsetShiftCount, this->ne->offsetShiftCount);
+    oprintf(this->out, "Resource table size:\t\t0x%04"PRIx16" (%"PRIu16")\n", this->ne->resourceTableSize, this->ne->resourceTableSize);
+    oprintf(this->out, "Target operating system:\t%s (0x%02"PRIx8")\n", ne_target_os_name(this->ne->targetOS), this->ne->targetOS);
+    oprintf(this->out, "Executable flags:\t\t%s%s%s%s\n", 
+        this->ne->os2LFN ? "LONGFILENAME " : "",
+        this->ne->os2PMode ? "PROTECTEDMODE " : "",
+        this->ne->os2Fonts ? "PROPORTIONALFONTS " : "",
+        this->ne->fastLoad ? "GANGLOADAREA " : ""); 
+    if(this->ne->fastLoad) { 
+        oprintf(this->out, "GangLoad/FastLoad area offset:\t0x%04"PRIx16"\n", this->ne->returnThunksOffset);
+        oprintf(this->out, "GangLoad/FastLoad area size:\t0x%04"PRIx16"\n", this->ne->segmentReferenceOffset);        
+    }
+    oprintf(this->out, "Windows version:\t\t%"PRIu8".%"PRIu8" (0x%04"PRIx16")\n", this->ne->windowsVersionMajor, this->ne->windowsVersionMinor, this->ne->windowsVersion);
+}
+
+void print_ne_modules(struct THIS *this) {
+    int i;
+
+    oprintf(this->out,
+        "\n\n"
+        "Imported modules:\n"
+        "-----------------\n"
+    );
+    for(i=0;i<this->ne_moduleCount;i++)
+        oprintf(this->out, "  [%2d]: %.*s\n", i+1, this->nemods[i].size, this->nemods[i].name);
+}
+
+void print_ne_segments(struct THIS *this) {
+    uint32_t seg, segsz, minalloc;
+
+    oprintf(this->out, "\n\n");
+    for(int i = 0; this->nesegs && i < this->ne->segmentCount; i++) {
+        oprintf(this->out, "Segment %d: %s%s%s%s%s%s%s%s%s\n", i,
+            this->nesegs[i].segType ? "DATA " : "CODE ",
+            this->nesegs[i].iterated ? "ITERATED " : "",
+            this->nesegs[i].allocated ? "ALLOCATED " : "",
+            this->nesegs[i].loaded ? "LOADED " : "",
+            this->nesegs[i].relocatable ? "MOVEABLE " : "",
+            this->nesegs[i].shared ? "PURE " : "IMPURE ",
+            this->nesegs[i].preload ? "PRELOAD " : "",
+            this->nesegs[i].relocations ? "RELOCINFO " : "",
+            this->nesegs[i].discardable ? "DISCARD " : ""
+        );
+        oprintf(this->out, "  Offset      (file)   Length   (dec)     Mem \n");
+        /* While the underlying structures contain 16-bit values, 32-bit values are used in RAM to account for the case of a value of zero, equal to 0x10000. */
+        seg = this->nesegs[i].segmentOffset;
+        segsz = (uint32_t) this->nesegs[i].segmentSize ? this->nesegs[i].segmentSize : 0x10000;
+        minalloc = (uint32_t) this->nesegs[i].minimumAllocation ? this->nesegs[i].minimumAllocation : 0x10000;
+        oprintf(this->out, "  0x%04"PRIx32"  0x%08"PRIx32"   0x%04"PRIx32"   %5"PRIu32"  0x%04"PRIx32"\n",
+            seg,
+            ne_segment_offset(this, i),
+            segsz,
+            segsz,
+            minalloc);
+        if (this->opts->hash) {
+            print_hash(this, ne_segment_hash, i);
+            /* The segment as loaded, relocations applied; see ne_load_segments() */
+            if (!this->neimages) ne_load_segments(this, this->opts->jobs);
+            if (this->neimages) {
+                oprintf(this->out, "  Loaded: %"PRIu32" bytes, %lu relocations applied, %lu left\n",
+                    this->neimages[i].size, this->neimages[i].applied, this->neimages[i].unresolved);
+                print_hash(this, ne_image_hash, i);
+            }
+        }
+        oprintf(this->out, "\n");
+    }
+}
+
+/* With -s the per-entry listing is left out and only the statistics are printed. */
+void print_ne_relocs(struct THIS *this) {
+    const struct exe_ne_reloc *r;
+    struct ne_segrelocs *sr;
+    char name[NE_IMPORT_REF_MAX];
+    int i, j;
+
+    for (i = 0; this->nerelocs && i < this->ne->segmentCount; i++) {
+        sr = &this->nerelocs[i];
+        if (!sr->present) continue;
+        oprintf(this->out, "Relocations for segment %d (%"PRIu16" entries at file offset 0x%08"PRIx32"):\n", i, sr->count, sr->fileOffset);
+        for (j = 0; !this->opts->summary && j < sr->count; j++) {
+            r = &sr->relocs[j];
+            oprintf(this->out, "  [%4d] %-8s  0x%04"PRIx16"  ", j, ne_raddr_name(r->addressType), r->offset);
+            switch (r->relocationType & RELTYPE_MASK) {
+                case RELTYPE_INTREF:
+                    if (r->segment == NE_MOVABLE_SEGMENT)
+                        oprintf(this->out, "entry #%"PRIu16" (movable)", r->ordinal);
+                    else
+                        oprintf(this->out, "segment %"PRIu8":%04"PRIx16, r->segment, r->ordinal);
+                    break;
+                case RELTYPE_IMPORD:
+                    oprintf(this->out, "%s", ne_import_ref(this, r->moduleReference, 0, r->importOrdinal, name));
+                    break;
+                case RELTYPE_IMPNAME:
+                    oprintf(this->out, "%s", ne_import_ref(this, r->moduleReference, 1, r->importNameOffset, name));
+                    break;
+                case RELTYPE_OSFIXUP:
+                    oprintf(this->out, "OS fixup %s", ne_osfixup_name(r->osFixupType));
+                    break;
+            }
+            oprintf(this->out, "%s\n", (r->relocationType & RELFLAG_ADDITIVE) ? " (additive)" : "");
+        }
+        oprintf(this->out, "  %"PRIu16" entries, %lu locations: %lu internal, %lu by ordinal, %lu by name, %lu OS fixups, %lu additive\n",
+            sr->count, sr->sites, sr->byType[RELTYPE_INTREF], sr->byType[RELTYPE_IMPORD], sr->byType[RELTYPE_IMPNAME], sr->byType[RELTYPE_OSFIXUP], sr->additive);
+        if (sr->ntop) {
+            oprintf(this->out, "  Most referenced imports:");
+            for (j = 0; j < sr->ntop; j++)
+                oprintf(this->out, "%s %s (%lu)", j ? "," : "",
+                    ne_import_ref(this, NE_IMPORT_KEY_MODULE(sr->top[j]), NE_IMPORT_KEY_BYNAME(sr->top[j]), NE_IMPORT_KEY_VALUE(sr->top[j]), name), sr->topcount[j]);
+            oprintf(this->out, "\n");
+        }
+        oprintf(this->out, "\n");
+    }
+}
+
+void print_ne(struct THIS *this) {
+    if (!this->ne) return;
+    print_ne_header(this);
+    print_ne_modules(this);
+    print_ne_segments(this);
+    print_ne_relocs(this);
+    print_ne_resources(this);
+    print_ne_exports(this);
+}
+
+static const char *ne_entry_kind(const struct exe_ne_export *exp) {
+    if (exp->segment == NE_BUNDLE_CONSTANT) return "CONSTANT";
+    return exp->movable ? "MOVABLE" : "FIXED";
+}
+
+void print_ne_exports(struct THIS *this) {
+    const struct exe_ne_export *exp;
+    int i, used = 0, exported = 0;
+
+    if (this->ne_moduleName.size) oprintf(this->out, "Module name:\t\t\t%.*s\n", (int) this->ne_moduleName.size, this->ne_moduleName.name);
+    if (this->ne_description.size) oprintf(this->out, "Module description:\t\t%.*s\n", (int) this->ne_description.size, this->ne_description.name);
+    for (i = 0; i < this->ne_exportCount; i++) {
+        if (!this->neexps[i].segment) continue;
+        used++;
+        if (this->neexps[i].flags & NE_ENTRY_EXPORTED) exported++;
+    }
+    if (!used) {
+        if (this->ne_moduleName.size || this->ne_description.size) oprintf(this->out, "\n");
+        return;
+    }
+    oprintf(this->out, "Entry table (%d entries, %d exported, %d names):\n", used, exported, this->ne_nameCount);
+    for (i = 0; !this->opts->summary && i < this->ne_exportCount; i++) {
+        exp = &this->neexps[i];
+        if (!exp->segment) continue;
+        oprintf(this->out, "  [%5"PRIu16"] %-8s  ", exp->ordinal, ne_entry_kind(exp));
+        if (exp->segment == NE_BUNDLE_CONSTANT) oprintf(this->out, "  = 0x%04"PRIx16, exp->offset);
+        else oprintf(this->out, "%3"PRIu8":%04"PRIx16, exp->segment, exp->offset);
+        oprintf(this->out, "%s%s", exp->flags & NE_ENTRY_EXPORTED ? " EXPORTED" : "", exp->flags & NE_ENTRY_SHARED ? " SHARED" : "");
+        if (exp->flags >> 3) oprintf(this->out, " (%d parameter words)", exp->flags >> 3);
+        if (exp->size) oprintf(this->out, "  %.*s%s", (int) exp->size, exp->name, exp->resident ? "" : " (non-resident)");
+        oprintf(this->out, "\n");
+    }
+    oprintf(this->out, "\n");
+}
+
+/* A resource type as RT_VERSION, #16 or its name, or a resource as 1 or its name, into buf; returns the length. */
+static int ne_resource_label(char *buf, uint16_t id, const char *name, uint8_t len, int istype) {
+    if (name) return sprintf(buf, "%.*s", (int) len, name);
+    if (istype && ne_resource_type_name(id)) return sprintf(buf, "%s", ne_resource_type_name(id));
+    return sprintf(buf, istype ? "#%"PRIu16 : "%"PRIu16, id);
+}
+
+void print_ne_resources(struct THIS *this) {
+    const struct ne_resource *r;
+    char type[260], name[260];
+    int i;
+
+    if (!this->ne_resourceCount) return;
+    oprintf(this->out, "Resources (alignment shift %"PRIu16"):\n", this->ne_resShift);
+    oprintf(this->out, "  Type             Name             Offset      Length\n");
+    for (i = 0; i < this->ne_resourceCount; i++) {
+        r = &this->neres[i];
+        ne_resource_label(type, r->type, r->typeName, r->typeNameLen, 1);
+        ne_resource_label(name, r->id, r->name, r->nameLen, 0);
+        oprintf(this->out, "  %-16s %-16s 0x%08"PRIx32"  %8"PRIu32"  %s%s%s\n", type, name, r->fileOffset, r->size,
+            r->flags & NE_RES_MOVEABLE ? "MOVEABLE " : "",
+            r->flags & NE_RES_PURE ? "PURE " : "",
+            r->flags & NE_RES_PRELOAD ? "PRELOAD " : "");
+    }
+    oprintf(this->out, "\n");
+}
+
+static const char *le_cpu_name(uint16_t cpu) {
+    switch (cpu) {
+        case CPU_286:           return "80286";
+        case CPU_386:           return "80386";
+        case CPU_486:           return "80486";
+        case CPU_586:           return "Pentium";
+        default:                return "Unknown";
+    }
+}
+
+static const char *le_os_name(uint16_t os) {
+    switch (os) {
+        case LE_OS_OS2:         return "OS/2";
+        case LE_OS_WIN16:       return "Windows";
+        case LE_OS_DOS4:        return "MT MS-DOS 4.0";
+        case LE_OS_WINDOWS:     return "Windows 386 (VxD)";
+        case LE_OS_PN:          return "IBM Microkernel Personality Neutral";
+        default:                return "Unknown";
+    }
+}
+
+static const char *le_module_type_name(uint8_t type) {
+    switch (type) {
+        case LE_MOD_PROGRAM:    return "Program";
+        case LE_MOD_LIBRARY:    return "Library";
+        case LE_MOD_PROTLIBRARY: return "Protected memory library";
+        case LE_MOD_PDD:        return "Physical device driver";
+        case LE_MOD_VDD:        return "Virtual device driver";
+        default:                return "Unknown";
+    }
+}
+
+static const char *le_page_type_name(uint16_t type) {
+    switch (type) {
+        case LE_PAGE_LEGAL:     return "LEGAL";
+        case LE_PAGE_ITERATED:  return "ITERATED";
+        case LE_PAGE_INVALID:   return "INVALID";
+        case LE_PAGE_ZEROFILL:  return "ZEROFILL";
+        case LE_PAGE_RANGE:     return "RANGE";
+        case LE_PAGE_COMPRESSED: return "COMPRESSED";
+        default:                return "UNKNOWN";
+    }
+}
+
+static const char *le_bundle_type_name(uint8_t type) {
+    switch (type) {
+        case LE_BUNDLE_ENTRY16: return "16-bit";
+        case LE_BUNDLE_GATE286: return "286 gate";
+        case LE_BUNDLE_ENTRY32: return "32-bit";
+        case LE_BUNDLE_FORWARDER: return "forwarder";
+        default:                return "unused";
+    }
+}
+
+static const char *le_fixup_source_name(uint8_t type) {
+    switch (type & LE_FIXUP_SOURCE_MASK) {
+        case LE_FIXUP_BYTE:     return "BYTE";
+        case LE_FIXUP_SELECTOR16: return "SELECTOR";
+        case LE_FIXUP_FAR16:    return "FARPTR";
+        case LE_FIXUP_OFFSET16: return "OFFSET";
+        case LE_FIXUP_FAR48:    return "FARPTR48";
+        case LE_FIXUP_OFFSET32: return "OFFSET32";
+        case LE_FIXUP_RELATIVE32: return "RELATIVE32";
+        default:                return "UNKNOWN";
+    }
+}
+
+/* Formats MODULE.ordinal or MODULE.NAME for an import from module (from 1) into buf, which should hold NE_IMPORT_REF_MAX bytes. */
+static const char *le_import_ref(struct THIS *this, uint16_t module, int byordinal, uint32_t value, char *buf) {
+    const struct exe_le_name *proc;
+    int n;
+
+    le_load(this, LE_HAVE_IMPORTS);
+    if (module >= 1 && module <= this->le_impmodCount)
+        n = sprintf(buf, "%.*s", this->leimpmods[module - 1].size, this->leimpmods[module - 1].name);
+    else
+        n = sprintf(buf, "#%"PRIu16, module);
+    if (byordinal)
+        sprintf(buf + n, ".%"PRIu32, value);
+    else if ((proc = le_import_proc(this, value)))
+        sprintf(buf + n, ".%.*s", proc->size, proc->name);
+    else
+        sprintf(buf + n, ".<name at 0x%04"PRIx32">", value);
+    return buf;
+}
+
+/* Formats MODULE.ordinal or MODULE.NAME for a forwarder into buf, which should hold NE_IMPORT_REF_MAX bytes. */
+const char *le_forwarder_ref(struct THIS *this, const struct exe_le_entry *ent, char *buf) {
+    return le_import_ref(this, ent->object, ent->flags & LE_ENTRY_BYORDINAL, ent->offset, buf);
+}
+
+/* Formats what fixup i points at into buf, which should hold NE_IMPORT_REF_MAX bytes. */
+static const char *le_fixup_ref(struct THIS *this, uint32_t i, char *buf) {
+    const struct le_fixups *fx = &this->lefix;
+
+    switch (fx->targetFlags[i] & LE_TARGET_MASK) {
+        case LE_TARGET_INTERNAL:
+            if ((fx->sourceType[i] & LE_FIXUP_SOURCE_MASK) == LE_FIXUP_SELECTOR16)
+                sprintf(buf, "object %"PRIu16, fx->target[i]);
+            else
+                sprintf(buf, "object %"PRIu16":%08"PRIx32, fx->target[i], fx->value[i]);
+            return buf;
+        case LE_TARGET_IMPORD:
+            return le_import_ref(this, fx->target[i], 1, fx->value[i], buf);
+        case LE_TARGET_IMPNAME:
+            return le_import_ref(this, fx->target[i], 0, fx->value[i], buf);
+        default:
+            sprintf(buf, "entry #%"PRIu16, fx->target[i]);
+            return buf;
+    }
+}
+
+void print_le_header(struct THIS *this) {
+    const struct exe_le_header *le = this->le;
+    static const char *pm[] = { "Not indicated", "Incompatible", "Compatible", "Uses the PM API" };
+    int islx = this->kind == EXE_LX;
+
+    oprintf(this->out, "Linear Executable with magic:\t%c%c\n", le->magic[0], le->magic[1]);
+    oprintf(this->out, "Byte order:\t\t\t%s-endian\n", le->byteOrder ? "big" : "little");
+    oprintf(this->out, "Word order:\t\t\t%s-endian\n", le->wordOrder ? "big" : "little");
+    oprintf(this->out, "Format level:\t\t\t%"PRIu32"\n", le->level);
+    oprintf(this->out, "CPU type:\t\t\t%s (0x%02"PRIx16")\n", le_cpu_name(le->cpuType), le->cpuType);
+    oprintf(this->out, "Target operating system:\t%s (0x%02"PRIx16")\n", le_os_name(le->osType), le->osType);
+    oprintf(this->out, "Module version:\t\t\t0x%08"PRIx32"\n", le->version);
+    oprintf(this->out, "Module flags:\t\t\t0x%08"PRIx32"\n", le->flags);
+    oprintf(this->out, " - Per-process initialization:\t%s\n", le->libInit ? "true" : "false");
+    oprintf(this->out, " - No internal fixups:\t\t%s\n", le->noInternalFixups ? "true" : "false");
+    oprintf(this->out, " - No external fixups:\t\t%s\n", le->noExternalFixups ? "true" : "false");
+    oprintf(this->out, " - Presentation Manager:\t%s\n", pm[(le->flags >> 8) & 3]);
+    oprintf(this->out, " - Module not loadable:\t\t%s\n", le->moduleNotLoaded ? "true" : "false");
+    oprintf(this->out, " - Module type:\t\t\t%s\n", le_module_type_name(le->moduleType));
+    oprintf(this->out, " - Per-process termination:\t%s\n", le->libTerm ? "true" : "false");
+    oprintf(this->out, "Number of pages:\t\t0x%08"PRIx32" (%"PRIu32")\n", le->pages, le->pages);
+    oprintf(this->out, "Initial CS:EIP (entrypoint):\tobject %"PRIu32":%08"PRIx32"\n", le->startingObject, le->entryPoint);
+    oprintf(this->out, "Initial SS:ESP (stack):\t\tobject %"PRIu32":%08"PRIx32"\n", le->stackObject, le->stackPointer);
+    oprintf(this->out, "Page size:\t\t\t0x%08"PRIx32" (%"PRIu32" bytes)\n", le->pageSize, le->pageSize);
+    if (islx)
+        oprintf(this->out, "Page offset shift:\t\t%"PRIu32"\n", le->pageShift);
+    else
+        oprintf(this->out, "Size of final page:\t\t0x%08"PRIx32" (%"PRIu32" bytes)\n", le->lastPage, le->lastPage);
+    oprintf(this->out, "Fixup section size:\t\t0x%08"PRIx32" (checksum 0x%08"PRIx32")\n", le->fixupSize, le->fixupChecksum);
+    oprintf(this->out, "Loader section size:\t\t0x%08"PRIx32" (checksum 0x%08"PRIx32")\n", le->loaderSize, le->loaderChecksum);
+    oprintf(this->out, "Offset of object table:\t\t0x%08"PRIx32" (%"PRIu32" objects)\n", le->objectTableOffset, le->objectCount);
+    oprintf(this->out, "Offset of object page map:\t0x%08"PRIx32"\n", le->objectMapOffset);
+    oprintf(this->out, "Offset of iterated data map:\t0x%08"PRIx32"\n", le->idataMapOffset);
+    oprintf(this->out, "Offset of resource table:\t0x%08"PRIx32" (%"PRIu32" resources)\n", le->resourceOffset, le->resourceCount);
+    oprintf(this->out, "Offset of resident name table:\t0x%08"PRIx32"\n", le->residentNameTableOffset);
+    oprintf(this->out, "Offset of entry table:\t\t0x%08"PRIx32"\n", le->entryTableOffset);
+    oprintf(this->out, "Offset of module directives:\t0x%08"PRIx32" (%"PRIu32" directives)\n", le->moduleDirectiveOffset, le->moduleDirectiveCount);
+    oprintf(this->out, "Offset of fixup page table:\t0x%08"PRIx32"\n", le->fixupPageTableOffset);
+    oprintf(this->out, "Offset of fixup record table:\t0x%08"PRIx32"\n", le->fixupRecordTableOffset);
+    oprintf(this->out, "Offset of import module table:\t0x%08"PRIx32" (%"PRIu32" modules)\n", le->importModuleNameTableOffset, le->importModuleNameTableCount);
+    oprintf(this->out, "Offset of import proc table:\t0x%08"PRIx32"\n", le->importProcNameTableOffset);
+    oprintf(this->out, "Offset of page checksum table:\t0x%08"PRIx32"\n", le->pageChecksumTableOffset);
+    oprintf(this->out, "Data pages:\t\t\t0x%08"PRIx32" (File offset)\n", le->dataPagesOffset);
+    oprintf(this->out, "Preload pages:\t\t\t%"PRIu32"\n", le->preloadPageCount);
+    oprintf(this->out, "Non-resident names table:\t0x%08"PRIx32" (File offset, %"PRIu32" bytes)\n", le->nonresidentNameTableOffset, le->nonresidentNameTableSize);
+    oprintf(this->out, "Automatic data object:\t\t%"PRIu32"\n", le->autodataObject);
+    oprintf(this->out, "Debug information:\t\t0x%08"PRIx32" (File offset, %"PRIu32" bytes)\n", le->debugSymbolsfOffset, le->debugSymbolsfSize);
+    oprintf(this->out, "Instance pages:\t\t\t%"PRIu32" preload, %"PRIu32" demand\n", le->instancePagePreloadCount, le->instancePageDemandLoadCount);
+    oprintf(this->out, "Heap size:\t\t\t0x%08"PRIx32"\n", le->heapSize);
+    oprintf(this->out, "Stack size:\t\t\t0x%08"PRIx32"\n", le->stackSize);
+    if (!islx && le->osType == LE_OS_WINDOWS) {
+        oprintf(this->out, "VxD version resource:\t\t0x%08"PRIx32" (File offset, %"PRIu32" bytes)\n", le->windowsResourceOffset, le->windowsResourceSize);
+        oprintf(this->out, "VxD device ID:\t\t\t0x%04"PRIx16"\n", le->windowsDeviceID);
+        oprintf(this->out, "DDK version:\t\t\t%"PRIu8".%02"PRIu8"\n", le->windowsDDKVersion >> 8, le->windowsDDKVersion & 0xFF);
+    }
+}
+
+void print_le_objects(struct THIS *this) {
+    const struct exe_le_object *obj;
+    int i;
+
+    oprintf(this->out, "\n\n");
+    for (i = 0; i < this->le_objectCount; i++) {
+        obj = &this->leobjs[i];
+        oprintf(this->out, "Object %d: %s%s%s%s%s%s%s%s%s%s%s%s%s%s\n", i + 1,
+            obj->flags & LE_OBJ_READABLE ? "READABLE " : "",
+            obj->flags & LE_OBJ_WRITABLE ? "WRITABLE " : "",
+            obj->flags & LE_OBJ_EXECUTABLE ? "EXECUTABLE " : "",
+            obj->flags & LE_OBJ_RESOURCE ? "RESOURCE " : "",
+            obj->flags & LE_OBJ_DISCARDABLE ? "DISCARD " : "",
+            obj->flags & LE_OBJ_SHARED ? "SHARED " : "",
+            obj->flags & LE_OBJ_PRELOAD ? "PRELOAD " : "",
+            obj->flags & LE_OBJ_INVALID ? "INVALID " : "",
+            obj->flags & LE_OBJ_ZEROFILL ? "ZEROFILL " : "",
+            obj->flags & LE_OBJ_RESIDENT ? "RESIDENT " : "",
+            obj->flags & LE_OBJ_LONGLOCKABLE ? "LONGLOCKABLE " : "",
+            obj->flags & LE_OBJ_ALIAS16 ? "ALIAS16 " : "",
+            obj->flags & LE_OBJ_BIG ? "USE32 " : "USE16 ",
+            obj->flags & LE_OBJ_CONFORMING ? "CONFORMING " : ""
+        );
+        oprintf(this->out, "  Base        Size        Flags       Pages\n");
+        oprintf(this->out, "  0x%08"PRIx32"  0x%08"PRIx32"  0x%08"PRIx32"  %"PRIu32"-%"PRIu32" (%"PRIu32")\n",
+            obj->relocBase, obj->virtualSize, obj->flags,
+            obj->pageMapIndex, obj->pageMapIndex + obj->pageMapEntries - (obj->pageMapEntries ? 1 : 0), obj->pageMapEntries);
+        if (this->opts->hash) {
+            print_hash(this, le_object_hash, i);
+            /* The pages as the loader would have them, compressed ones expanded; see le_expand_pages() */
+            le_expand_pages(this, this->opts->jobs);
+            if (this->leimage) {
+                oprintf(this->out, "  Expanded: %"PRIu32" pages of %"PRIu32" bytes\n", obj->pageMapEntries, this->le->pageSize);
+                print_hash(this, le_image_hash, i);
+            }
+        }
+        oprintf(this->out, "\n");
+    }
+}
+
+/* With -s only the number of pages of each type is printed. */
+void print_le_pages(struct THIS *this) {
+    const struct le_page *pg;
+    unsigned long bytype[LE_PAGE_COMPRESSED + 2] = { 0 };
+    int i;
+
+    le_load(this, LE_HAVE_PAGES);
+    oprintf(this->out, "Object page map (%d pages):\n", this->le_pageCount);
+    if (!this->opts->summary)
+        oprintf(this->out, "  Page    Object  File offset  Size    Type\n");
+    for (i = 0; i < this->le_pageCount; i++) {
+        pg = &this->lepages[i];
+        bytype[pg->flags <= LE_PAGE_COMPRESSED ? pg->flags : LE_PAGE_COMPRESSED + 1]++;
+        if (!this->opts->summary)
+            oprintf(this->out, "  [%4d]  %6"PRIu32"  0x%08"PRIx32"   0x%04"PRIx32"  %s\n", i + 1, le_page_object(this, i + 1), pg->fileOffset, pg->size, le_page_type_name(pg->flags));
+    }
+    if (this->opts->summary) {
+        for (i = 0; i <= LE_PAGE_COMPRESSED + 1; i++)
+            if (bytype[i]) oprintf(this->out, "  %-12s%lu\n", le_page_type_name(i), bytype[i]);
+    }
+    oprintf(this->out, "\n");
+}
+
+void print_le_names(struct THIS *this, const char *title, const struct exe_le_name *names, int count) {
+    int i;
+
+    oprintf(this->out, "%s:\n", title);
+    for (i = 0; i < count; i++)
+        oprintf(this->out, "  [%4"PRIu16"] %.*s\n", names[i].ordinal, names[i].size, names[i].name);
+    oprintf(this->out, "\n");
+}
+
+/* With -s only the count of entry points is printed. */
+void print_le_entries(struct THIS *this) {
+    const struct exe_le_entry *ent;
+    char name[NE_IMPORT_REF_MAX];
+    int i, exported = 0;
+
+    le_load(this, LE_HAVE_ENTRIES);
+    for (i = 0; i < this->le_entryCount; i++)
+        if (this->leents[i].type != LE_BUNDLE_FORWARDER && (this->leents[i].flags & LE_ENTRY_EXPORTED)) exported++;
+    oprintf(this->out, "Entry table (%d entries, %d exported):\n", this->le_entryCount, exported);
+    for (i = 0; !this->opts->summary && i < this->le_entryCount; i++) {
+        ent = &this->leents[i];
+        oprintf(this->out, "  [%4"PRIu16"] %-9s  ", ent->ordinal, le_bundle_type_name(ent->type));
+        switch (ent->type) {
+            case LE_BUNDLE_FORWARDER:
+                oprintf(this->out, "%s\n", le_forwarder_ref(this, ent, name));
+                continue;
+            case LE_BUNDLE_ENTRY32:
+                oprintf(this->out, "%4"PRIu16":%08"PRIx32, ent->object, ent->offset);
+                break;
+            case LE_BUNDLE_GATE286:
+                oprintf(this->out, "%4"PRIu16":%04"PRIx32" gate 0x%04"PRIx16, ent->object, ent->offset, ent->callgate);
+                break;
+            default:
+                oprintf(this->out, "%4"PRIu16":%04"PRIx32, ent->object, ent->offset);
+                break;
+        }
+        oprintf(this->out, "%s%s", ent->flags & LE_ENTRY_EXPORTED ? " EXPORTED" : "", ent->flags & LE_ENTRY_SHARED ? " SHARED" : "");
+        if (ent->flags >> 3) oprintf(this->out, " (%d parameter words)", ent->flags >> 3);
+        oprintf(this->out, "\n");
+    }
+    oprintf(this->out, "\n");
+}
+
+void print_le_imports(struct THIS *this) {
+    int i;
+
+    le_load(this, LE_HAVE_IMPORTS);
+    oprintf(this->out,
+        "Imported modules:\n"
+        "-----------------\n"
+    );
+    for (i = 0; i < this->le_impmodCount; i++)
+        oprintf(this->out, "  [%2d]: %.*s\n", i + 1, this->leimpmods[i].size, this->leimpmods[i].name);
+    oprintf(this->out, "\nImported procedure names:\n");
+    for (i = 0; i < this->le_impprocCount; i++)
+        oprintf(this->out, "  0x%04"PRIx32": %.*s\n", this->leimpprocs[i].offset, this->leimpprocs[i].size, this->leimpprocs[i].name);
+    oprintf(this->out, "\n");
+}
+
+/* With -s only the counts by source and target type are printed. */
+void print_le_fixups(struct THIS *this) {
+    const struct le_fixups *fx = &this->lefix;
+    unsigned long bysource[LE_FIXUP_RELATIVE32 + 2] = { 0 }, bytarget[4] = { 0 }, additive = 0;
+    char name[NE_IMPORT_REF_MAX];
+    uint32_t i;
+    int page = 0, j;
+
+    le_load_fixups(this, this->opts->jobs);
+    oprintf(this->out, "Fixups (%"PRIu32" locations):\n", fx->count);
+    if (!this->opts->summary && fx->count)
+        oprintf(this->out, "  Page    Offset   Type        Target\n");
+    for (i = 0; i < fx->count; i++) {
+        while (fx->pageStart[page + 1] <= i) page++;
+        bysource[(fx->sourceType[i] & LE_FIXUP_SOURCE_MASK) <= LE_FIXUP_RELATIVE32 ? fx->sourceType[i] & LE_FIXUP_SOURCE_MASK : LE_FIXUP_RELATIVE32 + 1]++;
+        bytarget[fx->targetFlags[i] & LE_TARGET_MASK]++;
+        if (fx->targetFlags[i] & LE_TARGET_ADDITIVE) additive++;
+        if (this->opts->summary) continue;
+        oprintf(this->out, "  [%4d]  %s0x%03"PRIx16"  %-10s  %s", page + 1, fx->source[i] < 0 ? "-" : " ",
+            (uint16_t) (fx->source[i] < 0 ? -fx->source[i] : fx->source[i]), le_fixup_source_name(fx->sourceType[i]), le_fixup_ref(this, i, name));
+        if (fx->targetFlags[i] & LE_TARGET_ADDITIVE) oprintf(this->out, " +0x%"PRIx32, fx->additive[i]);
+        oprintf(this->out, "%s\n", fx->sourceType[i] & LE_FIXUP_ALIAS ? " (alias)" : "");
+    }
+    if (this->opts->summary) {
+        for (j = 0; j <= LE_FIXUP_RELATIVE32 + 1; j++)
+            if (bysource[j]) oprintf(this->out, "  %-12s%lu\n", le_fixup_source_name(j), bysource[j]);
+    }
+    oprintf(this->out, "  %"PRIu32" locations: %lu internal, %lu by ordinal, %lu by name, %lu by entry, %lu additive\n\n",
+        fx->count, bytarget[LE_TARGET_INTERNAL], bytarget[LE_TARGET_IMPORD], bytarget[LE_TARGET_IMPNAME], bytarget[LE_TARGET_ENTRY], additive);
+}
+
+void print_le(struct THIS *this) {
+    if (!this->le) return;
+    print_le_header(this);
+    print_le_objects(this);
+    print_le_pages(this);
+    le_load(this, LE_HAVE_RESNAMES | LE_HAVE_NONRESNAMES);
+    print_le_names(this, "Resident names", this->leresnames, this->le_resnameCount);
+    print_le_names(this, "Non-resident names", this->lenonresnames, this->le_nonresnameCount);
+    print_le_entries(this);
+    print_le_imports(this);
+    print_le_fixups(this);
+}
+
+static const char *pe_machine_name(uint16_t machine) {
+    switch (machine) {
+        case PE_MACHINE_I386:       return "Intel 386";
+        case PE_MACHINE_R3000:      return "MIPS R3000";
+        case PE_MACHINE_R4000:      return "MIPS R4000";
+        case PE_MACHINE_R10000:     return "MIPS R10000";
+        case PE_MACHINE_WCEMIPSV2:  return "MIPS WCE v2";
+        case PE_MACHINE_ALPHA:      return "Alpha AXP";
+        case PE_MACHINE_SH3:        return "Hitachi SH3";
+        case PE_MACHINE_SH3DSP:     return "Hitachi SH3 DSP";
+        case PE_MACHINE_SH4:        return "Hitachi SH4";
+        case PE_MACHINE_SH5:        return "Hitachi SH5";
+        case PE_MACHINE_ARM:        return "ARM";
+        case PE_MACHINE_THUMB:      return "ARM Thumb";
+        case PE_MACHINE_ARMNT:      return "ARM Thumb-2";
+        case PE_MACHINE_AM33:       return "Matsushita AM33";
+        case PE_MACHINE_POWERPC:    return "PowerPC";
+        case PE_MACHINE_POWERPCFP:  return "PowerPC with FPU";
+        case PE_MACHINE_IA64:       return "Itanium";
+        case PE_MACHINE_MIPS16:     return "MIPS16";
+        case PE_MACHINE_ALPHA64:    return "Alpha AXP 64-bit";
+        case PE_MACHINE_MIPSFPU:    return "MIPS with FPU";
+        case PE_MACHINE_MIPSFPU16:  return "MIPS16 with FPU";
+        case PE_MACHINE_EBC:        return "EFI byte code";
+        case PE_MACHINE_RISCV32:    return "RISC-V 32-bit";
+        case PE_MACHINE_RISCV64:    return "RISC-V 64-bit";
+        case PE_MACHINE_AMD64:      return "x86-64";
+        case PE_MACHINE_M32R:       return "Mitsubishi M32R";
+        case PE_MACHINE_ARM64:      return "ARM64";
+        default:                    return "Unknown";
+    }
+}
+
+static const char *pe_subsystem_name(uint16_t subsystem) {
+    switch (subsystem) {
+        case PE_SUBSYS_NATIVE:              return "Native";
+        case PE_SUBSYS_WINDOWS_GUI:         return "Windows GUI";
+        case PE_SUBSYS_WINDOWS_CUI:         return "Windows console";
+        case PE_SUBSYS_OS2_CUI:             return "OS/2 console";
+        case PE_SUBSYS_POSIX_CUI:           return "POSIX console";
+        case PE_SUBSYS_NATIVE_WINDOWS:      return "Windows 9x native driver";
+        case PE_SUBSYS_WINDOWS_CE_GUI:      return "Windows CE GUI";
+        case PE_SUBSYS_EFI_APPLICATION:     return "EFI application";
+        case PE_SUBSYS_EFI_BOOT_DRIVER:     return "EFI boot service driver";
+        case PE_SUBSYS_EFI_RUNTIME_DRIVER:  return "EFI runtime driver";
+        case PE_SUBSYS_EFI_ROM:             return "EFI ROM";
+        case PE_SUBSYS_XBOX:                return "Xbox";
+        case PE_SUBSYS_WINDOWS_BOOT:        return "Windows boot application";
+        default:                            return "Unknown";
+    }
+}
+
+static const char *pe_dir_names[PE_DIR_COUNT] = {
+    "Export", "Import", "Resource", "Exception", "Security", "Base relocation", "Debug", "Architecture",
+    "Global pointer", "TLS", "Load config", "Bound import", "IAT", "Delay import", "CLR runtime", "Reserved"
+};
+
+/* Printable length of a section name: up to eight characters, NUL padded. */
+static int pe_section_name_len(const struct exe_pe_section *sec) {
+    int n;
+
+    for (n = 0; n < 8 && sec->name[n]; n++);
+    return n;
+}
+
+void print_pe_header(struct THIS *this) {
+    const struct exe_pe_header *pe = this->pe;
+    uint16_t c = pe->characteristics, d;
+
+    oprintf(this->out, "Portable Executable with magic:\t%c%c\n", pe->magic[0], pe->magic[1]);
+    oprintf(this->out, "Machine:\t\t\t%s (0x%04"PRIx16")\n", pe_machine_name(pe->machine), pe->machine);
+    oprintf(this->out, "Number of sections:\t\t%"PRIu16"\n", pe->numberOfSections);
+    oprintf(this->out, "Time/date stamp:\t\t0x%08"PRIx32"\n", pe->timeDateStamp);
+    oprintf(this->out, "Symbol table:\t\t\t0x%08"PRIx32" (File offset, %"PRIu32" symbols)\n", pe->pointerToSymbolTable, pe->numberOfSymbols);
+    oprintf(this->out, "Optional header size:\t\t0x%04"PRIx16" (%"PRIu16" bytes)\n", pe->sizeOfOptionalHeader, pe->sizeOfOptionalHeader);
+    oprintf(this->out, "Characteristics:\t\t0x%04"PRIx16"\n", c);
+    oprintf(this->out, " - Flags:\t\t\t%s%s%s%s%s%s%s%s%s%s%s%s%s\n",
+        c & PE_FILE_EXECUTABLE_IMAGE ? "EXECUTABLE " : "",
+        c & PE_FILE_DLL ? "DLL " : "",
+        c & PE_FILE_SYSTEM ? "SYSTEM " : "",
+        c & PE_FILE_32BIT_MACHINE ? "32BIT " : "",
+        c & PE_FILE_LARGE_ADDRESS_AWARE ? "LARGEADDRESSAWARE " : "",
+        c & PE_FILE_RELOCS_STRIPPED ? "RELOCSSTRIPPED " : "",
+        c & PE_FILE_LINE_NUMS_STRIPPED ? "LINENUMSSTRIPPED " : "",
+        c & PE_FILE_LOCAL_SYMS_STRIPPED ? "LOCALSYMSSTRIPPED " : "",
+        c & PE_FILE_DEBUG_STRIPPED ? "DEBUGSTRIPPED " : "",
+        c & PE_FILE_AGGRESSIVE_WS_TRIM ? "AGGRESSIVEWSTRIM " : "",
+        c & PE_FILE_REMOVABLE_RUN_FROM_SWAP ? "REMOVABLERUNFROMSWAP " : "",
+        c & PE_FILE_NET_RUN_FROM_SWAP ? "NETRUNFROMSWAP " : "",
+        c & PE_FILE_UP_SYSTEM_ONLY ? "UPSYSTEMONLY " : "");
+    if (!this->pe32 && !this->pe64) return;
+
+#define PE_OPT(field) (this->pe32 ? (uint64_t) this->pe32->field : (uint64_t) this->pe64->field)
+    oprintf(this->out, "Optional header magic:\t\t0x%04"PRIx16" (%s)\n", (uint16_t) PE_OPT(magic), this->pe32 ? "PE32" : "PE32+");
+    oprintf(this->out, "Linker version:\t\t\t%"PRIu8".%"PRIu8"\n", (uint8_t) PE_OPT(linkerMajor), (uint8_t) PE_OPT(linkerMinor));
+    oprintf(this->out, "Size of code:\t\t\t0x%08"PRIx32"\n", (uint32_t) PE_OPT(sizeOfCode));
+    oprintf(this->out, "Size of initialized data:\t0x%08"PRIx32"\n", (uint32_t) PE_OPT(sizeOfInitializedData));
+    oprintf(this->out, "Size of uninitialized data:\t0x%08"PRIx32"\n", (uint32_t) PE_OPT(sizeOfUninitializedData));
+    oprintf(this->out, "Entry point:\t\t\t0x%08"PRIx32" (RVA)\n", (uint32_t) PE_OPT(addressOfEntryPoint));
+    oprintf(this->out, "Base of code:\t\t\t0x%08"PRIx32"\n", (uint32_t) PE_OPT(baseOfCode));
+    if (this->pe32)
+        oprintf(this->out, "Base of data:\t\t\t0x%08"PRIx32"\n", this->pe32->baseOfData);
+    oprintf(this->out, "Image base:\t\t\t0x%0*"PRIx64"\n", this->pe32 ? 8 : 16, PE_OPT(imageBase));
+    oprintf(this->out, "Section alignment:\t\t0x%08"PRIx32"\n", (uint32_t) PE_OPT(sectionAlignment));
+    oprintf(this->out, "File alignment:\t\t\t0x%08"PRIx32"\n", (uint32_t) PE_OPT(fileAlignment));
+    oprintf(this->out, "Operating system version:\t%"PRIu16".%"PRIu16"\n", (uint16_t) PE_OPT(osMajor), (uint16_t) PE_OPT(osMinor));
+    oprintf(this->out, "Image version:\t\t\t%"PRIu16".%"PRIu16"\n", (uint16_t) PE_OPT(imageMajor), (uint16_t) PE_OPT(imageMinor));
+    oprintf(this->out, "Subsystem version:\t\t%"PRIu16".%"PRIu16"\n", (uint16_t) PE_OPT(subsystemMajor), (uint16_t) PE_OPT(subsystemMinor));
+    oprintf(this->out, "Win32 version value:\t\t0x%08"PRIx32"\n", (uint32_t) PE_OPT(win32VersionValue));
+    oprintf(this->out, "Size of image:\t\t\t0x%08"PRIx32" (%"PRIu32" bytes)\n", (uint32_t) PE_OPT(sizeOfImage), (uint32_t) PE_OPT(sizeOfImage));
+    oprintf(this->out, "Size of headers:\t\t0x%08"PRIx32" (%"PRIu32" bytes)\n", (uint32_t) PE_OPT(sizeOfHeaders), (uint32_t) PE_OPT(sizeOfHeaders));
+    oprintf(this->out, "Checksum:\t\t\t0x%08"PRIx32"\n", (uint32_t) PE_OPT(checkSum));
+    oprintf(this->out, "Subsystem:\t\t\t%s (%"PRIu16")\n", pe_subsystem_name((uint16_t) PE_OPT(subsystem)), (uint16_t) PE_OPT(subsystem));
+    d = (uint16_t) PE_OPT(dllCharacteristics);
+    oprintf(this->out, "DLL characteristics:\t\t0x%04"PRIx16"\n", d);
+    oprintf(this->out, " - Flags:\t\t\t%s%s%s%s%s%s%s%s%s%s%s\n",
+        d & PE_DLL_HIGH_ENTROPY_VA ? "HIGHENTROPYVA " : "",
+        d & PE_DLL_DYNAMIC_BASE ? "DYNAMICBASE " : "",
+        d & PE_DLL_FORCE_INTEGRITY ? "FORCEINTEGRITY " : "",
+        d & PE_DLL_NX_COMPAT ? "NXCOMPAT " : "",
+        d & PE_DLL_NO_ISOLATION ? "NOISOLATION " : "",
+        d & PE_DLL_NO_SEH ? "NOSEH " : "",
+        d & PE_DLL_NO_BIND ? "NOBIND " : "",
+        d & PE_DLL_APPCONTAINER ? "APPCONTAINER " : "",
+        d & PE_DLL_WDM_DRIVER ? "WDMDRIVER " : "",
+        d & PE_DLL_GUARD_CF ? "GUARDCF " : "",
+        d & PE_DLL_TERMINAL_SERVER_AWARE ? "TERMINALSERVERAWARE " : "");
+    oprintf(this->out, "Stack reserve/commit:\t\t0x%"PRIx64"/0x%"PRIx64"\n", PE_OPT(sizeOfStackReserve), PE_OPT(sizeOfStackCommit));
+    oprintf(this->out, "Heap reserve/commit:\t\t0x%"PRIx64"/0x%"PRIx64"\n", PE_OPT(sizeOfHeapReserve), PE_OPT(sizeOfHeapCommit));
+    oprintf(this->out, "Loader flags:\t\t\t0x%08"PRIx32"\n", (uint32_t) PE_OPT(loaderFlags));
+    oprintf(this->out, "Number of data directories:\t%"PRIu32"\n", (uint32_t) PE_OPT(numberOfRvaAndSizes));
+#undef PE_OPT
+}
+
+void print_pe_dirs(struct THIS *this) {
+    int i;
+
+    oprintf(this->out,
+        "\n\n"
+        "Data directories:\n"
+        "       Directory         RVA         Size\n"
+    );
+    for (i = 0; i < this->pe_dirCount; i++)
+        oprintf(this->out, "  [%2d] %-16s  0x%08"PRIx32"  0x%08"PRIx32"\n", i, i < PE_DIR_COUNT ? pe_dir_names[i] : "",
+            this->pedirs[i].virtualAddress, this->pedirs[i].size);
+}
+
+void print_pe_sections(struct THIS *this) {
+    const struct exe_pe_section *sec;
+    uint32_t c;
+    int i;
+
+    oprintf(this->out, "\n\n");
+    for (i = 0; i < this->pe_sectionCount; i++) {
+        sec = &this->pesecs[i];
+        c = sec->characteristics;
+        oprintf(this->out, "Section %d: %.*s %s%s%s%s%s%s%s%s%s\n", i + 1, pe_section_name_len(sec), sec->name,
+            c & PE_SCN_CNT_CODE ? "CODE " : "",
+            c & PE_SCN_CNT_INITIALIZED_DATA ? "DATA " : "",
+            c & PE_SCN_CNT_UNINITIALIZED_DATA ? "BSS " : "",
+            c & PE_SCN_MEM_READ ? "READ " : "",
+            c & PE_SCN_MEM_WRITE ? "WRITE " : "",
+            c & PE_SCN_MEM_EXECUTE ? "EXECUTE " : "",
+            c & PE_SCN_MEM_SHARED ? "SHARED " : "",
+            c & PE_SCN_MEM_DISCARDABLE ? "DISCARD " : "",
+            c & PE_SCN_MEM_NOT_PAGED ? "NONPAGED " : "");
+        oprintf(this->out, "  RVA         Virt. size  File offset File size   Flags\n");
+        oprintf(this->out, "  0x%08"PRIx32"  0x%08"PRIx32"  0x%08"PRIx32"  0x%08"PRIx32"  0x%08"PRIx32"\n\n",
+            sec->virtualAddress, sec->virtualSize, sec->pointerToRawData, sec->sizeOfRawData, c);
+    }
+}
+
+/* With -s only the number of functions imported from each module is printed. */
+void print_pe_imports(struct THIS *this) {
+    const struct exe_pe_module *mod;
+    const struct exe_pe_import *imp;
+    int i, j;
+
+    pe_load(this, PE_HAVE_IMPORTS);
+    if (!this->pe_moduleCount) return;
+    oprintf(this->out,
+        "Imported modules:\n"
+        "-----------------\n"
+    );
+    for (i = 0; i < this->pe_moduleCount; i++) {
+        mod = &this->pemods[i];
+        oprintf(this->out, "  [%2d]: %.*s (%d functions%s)\n", i + 1, (int) mod->nameLen, mod->name, mod->count, mod->delay ? ", delay loaded" : "");
+        for (j = 0; !this->opts->summary && j < mod->count; j++) {
+            imp = &this->peimps[mod->first + j];
+            if (imp->name)
+                oprintf(this->out, "        %5"PRIu16"  %.*s\n", imp->hint, (int) imp->nameLen, imp->name);
+            else
+                oprintf(this->out, "        Ordinal %"PRIu16"\n", imp->hint);
+        }
+    }
+    oprintf(this->out, "\n");
+}
+
+/* With -s only the export directory itself is printed. */
+void print_pe_exports(struct THIS *this) {
+    const struct exe_pe_export *exp;
+    int i;
+
+    pe_load(this, PE_HAVE_EXPORTS);
+    if (!this->peexpdir) return;
+    oprintf(this->out, "Exports from %.*s (%d entries, ordinal base %"PRIu32", %"PRIu32" names):\n",
+        (int) this->pe_expNameLen, this->pe_expName ? this->pe_expName : "", this->pe_exportCount, this->peexpdir->base, this->peexpdir->numberOfNames);
+    for (i = 0; !this->opts->summary && i < this->pe_exportCount; i++) {
+        exp = &this->peexps[i];
+        oprintf(this->out, "  [%4"PRIu32"] 0x%08"PRIx32, exp->ordinal, exp->rva);
+        if (exp->name) oprintf(this->out, "  %.*s", (int) exp->nameLen, exp->name);
+        if (exp->forwarder) oprintf(this->out, "  -> %.*s", (int) exp->forwarderLen, exp->forwarder);
+        oprintf(this->out, "\n");
+    }
+    oprintf(this->out, "\n");
+}
+
+void print_pe(struct THIS *this) {
+    if (!this->pe) return;
+    print_pe_header(this);
+    print_pe_dirs(this);
+    print_pe_sections(this);
+    print_pe_imports(this);
+    print_pe_exports(this);
+}
+
+void print_w3(struct THIS *this) {
+    const struct THIS *le;
+    int i;
+
+    w3_load_modules(this, this->opts->jobs);
+    if (!this->w3) return;
+    oprintf(this->out, "VMM version: %"PRIu8".%"PRIu8" (0x%04"PRIx16")\n", this->w3->vmm_major, this->w3->vmm_minor, this->w3->vmm_version);
+    oprintf(this->out,
+        "VxD Module Table:\n"
+        "   ID   Name          Offset      Size       (dec)\n"
+        "------------------------------------------------------\n"
+    );
+    for(int i=0; i<this->wx_modcount; i++) {
+        oprintf(this->out, "  [%02x] \"%.8s\"     0x%08"PRIx32"  0x%08"PRIx32" (%"PRIu32" bytes)\n", i, this->w3mods[i].name, this->w3mods[i].offset, this->w3mods[i].size, this->w3mods[i].size);
+        if (this->opts->hash) print_hash(this, w3_module_hash, i);
+    }
+    if (!this->wxles) return;
+    oprintf(this->out,
+        "\nVxD inventory:\n"
+        "   ID   Module      Type  Device ID  DDK    Objects  Pages  Entries\n"
+        "--------------------------------------------------------------------\n"
+    );
+    for (i = 0; i < this->wx_modcount; i++) {
+        if (!(le = this->wxles[i]) || !le->le) {
+            oprintf(this->out, "  [%02x] (not an LE VxD)\n", i);
+            continue;
+        }
+        oprintf(this->out, "  [%02x] %-10.*s  %-4s  0x%04"PRIx16"     %"PRIu8".%02"PRIu8"  %7d  %5d  %7d\n", i,
+            le->le_resnameCount ? le->leresnames[0].size : 0, le->le_resnameCount ? le->leresnames[0].name : "",
+            exe_kind_names[le->kind], le->le->windowsDeviceID, le->le->windowsDDKVersion >> 8, le->le->windowsDDKVersion & 0xFF,
+            le->le_objectCount, le->le_pageCount, le->le_entryCount);
+    }
+}
+
+void print_w4(struct THIS *this) {
+    uint32_t i, bytes = 0;
+
+    if (!this->w4) return;
+    w3_load_modules(this, this->opts->jobs);
+    for (i = 0; i + 1 < (uint32_t) this->w4_chunkCount; i++)
+        bytes += this->w4chunks[i + 1] - this->w4chunks[i];
+    if (this->w4_chunkCount && this->w4chunks[i] < this->size) bytes += this->size - this->w4chunks[i];
+    oprintf(this->out, "Compressed chunks:\t\t%d of 0x%04"PRIx16" bytes, %"PRIu32" bytes in the file\n", this->w4_chunkCount, this->w4->chunkSize, bytes);
+    oprintf(this->out, "Expanded W3 image:\t\t%lu bytes\n\n", (unsigned long) this->wx_imageSize);
+    print_w3(this);
+}
+
+/* --hash: the hashes of segment, object or module i as a line of their own */
+void print_hash(struct THIS *this, int (*hashfn)(struct THIS *, int, unsigned, struct exe_hash *), int i) {
+    struct exe_hash h;
+    int j;
+
+    hashfn(this, i, this->opts->hash, &h);
+    oprintf(this->out, " ");
+    if (h.what & HASH_XXH64) oprintf(this->out, " XXH64: %016"PRIx64, h.xxh64);
+    if (h.what & HASH_SHA256) {
+        oprintf(this->out, " SHA-256: ");
+        for (j = 0; j < SHA256_SIZE; j++) oprintf(this->out, "%02x", h.sha256[j]);
+    }
+    oprintf(this->out, " (%"PRIu32" bytes)\n", h.bytes);
+}
+
+/* Hex strings, as a JSON number cannot be trusted with 64 bits. */
+void json_hash(struct THIS *this, int (*hashfn)(struct THIS *, int, unsigned, struct exe_hash *), int i) {
+    struct exe_hash h;
+    char hex[2 * SHA256_SIZE + 1];
+    int j;
+
+    hashfn(this, i, this->opts->hash, &h);
+    json_uint(this->out, "hashedBytes", h.bytes);
+    if (h.what & HASH_XXH64) {
+        sprintf(hex, "%016"PRIx64, h.xxh64);
+        json_str(this->out, "xxh64", hex);
+    }
+    if (h.what & HASH_SHA256) {
+        for (j = 0; j < SHA256_SIZE; j++) sprintf(hex + 2 * j, "%02x", h.sha256[j]);
+        json_str(this->out, "sha256", hex);
+    }
+}
+
+static const char *const check_names[] = { "absent", "valid", "invalid" };
+
+static void print_checksum(struct THIS *this, const char *label, const struct exe_checksum *sum, int digits) {
+    oprintf(this->out, "%s%s", label, check_names[sum->status]);
+    if (sum->status == EXE_CHECK_VALID) oprintf(this->out, " (0x%0*"PRIx32")", digits, sum->stored);
+    else if (sum->status == EXE_CHECK_INVALID) oprintf(this->out, " (stored 0x%0*"PRIx32", computed 0x%0*"PRIx32")", digits, sum->stored, digits, sum->computed);
+    oprintf(this->out, "\n");
+}
+
+/* --verify: every checksum the file carries, and whether it holds */
+void print_checksums(struct THIS *this) {
+    struct exe_checksum sum;
+    unsigned long counts[3] = { 0, 0, 0 };
+    int i, status;
+
+    oprintf(this->out, "Checksums:\n");
+    mz_checksum(this, &sum);
+    print_checksum(this, "  DOS header checksum:\t", &sum, 4);
+    if (this->ne) {
+        ne_checksum(this, &sum);
+        print_checksum(this, "  NE file CRC:\t\t", &sum, 8);
+    }
+    if (this->le) {
+        status = le_page_checksums(this, this->opts->jobs);
+        oprintf(this->out, "  Page checksums:\t%s", check_names[status]);
+        if (this->lesums) {
+            for (i = 0; i < this->le_pageCount; i++) counts[this->lesums[i].status]++;
+            oprintf(this->out, " (%lu valid, %lu invalid, %lu absent)", counts[EXE_CHECK_VALID], counts[EXE_CHECK_INVALID], counts[EXE_CHECK_ABSENT]);
+        }
+        oprintf(this->out, "\n");
+        for (i = 0; this->lesums && !this->opts->summary && i < this->le_pageCount; i++)
+            if (this->lesums[i].status == EXE_CHECK_INVALID)
+                oprintf(this->out, "    Page 0x%04x: stored 0x%08"PRIx32", computed 0x%08"PRIx32"\n", i + 1, this->lesums[i].stored, this->lesums[i].computed);
+    }
+}
+
+static void json_checksum(struct THIS *this, const char *key, const struct exe_checksum *sum) {
+    json_open(this->out, key, '{');
+    json_str(this->out, "status", check_names[sum->status]);
+    json_uint(this->out, "stored", sum->stored);
+    json_uint(this->out, "computed", sum->computed);
+    json_close(this->out, '}');
+}
+
+void json_checksums(struct THIS *this) {
+    struct outbuf *o = this->out;
+    struct exe_checksum sum;
+    int i, status;
+
+    json_open(o, "checksums", '{');
+    mz_checksum(this, &sum);
+    json_checksum(this, "mz", &sum);
+    if (this->ne) {
+        ne_checksum(this, &sum);
+        json_checksum(this, "ne", &sum);
+    }
+    if (this->le) {
+        status = le_page_checksums(this, this->opts->jobs);
+        json_str(o, "pages", check_names[status]);
+        if (this->lesums) {
+            /* Only the pages that fail; a clean file stays small. */
+            json_open(o, "invalidPages", '[');
+            for (i = 0; i < this->le_pageCount; i++) {
+                if (this->lesums[i].status != EXE_CHECK_INVALID) continue;
+                json_open(o, NULL, '{');
+                json_uint(o, "page", i + 1);
+                json_uint(o, "stored", this->lesums[i].stored);
+                json_uint(o, "computed", this->lesums[i].computed);
+                json_close(o, '}');
+            }
+            json_close(o, ']');
+        }
+    }
+    json_close(o, '}');
+}
+
+void print_next_header(struct THIS *this) {
+    const char *what;
+
+    if (!this->nextMagic) return;
+    switch (this->kind) {
+        case EXE_NE: what = "New"; break;
+        case EXE_PE: what = "Portable"; break;
+        case EXE_LE:
+        case EXE_LX: what = "Linear"; break;
+        case EXE_W3: what = "W3"; break;
+        case EXE_W4: what = "W4"; break;
+        default:
+            oprintf(this->out, "\n\n");
+            oprintf(this->out, "Unknown next header type: %c%c/0x%04"PRIx16"\n", this->nextMagic[0], this->nextMagic[1], *((const uint16_t *) this->nextMagic));
+            return;
+    }
+    oprintf(this->out, "\n\n");
+    oprintf(this->out, "%s Executable header found at offset 0x%08"PRIx32"\n", what, this->mzx->nextHeader);
+    switch (this->kind) {
+        case EXE_NE: print_ne(this); break;
+        case EXE_LE:
+        case EXE_LX: print_le(this); break;
+        case EXE_W3: print_w3(this); break;
+        case EXE_W4: print_w4(this); break;
+        case EXE_PE: print_pe(this); break;
+        default: break;
+    }
+}
+
+void print_text(struct THIS *this) {
+    /* With -n the next header comes first, as that's what was asked for. */
+    if (this->opts->noffset != -1) print_next_header(this);
+    if (!this->mz) {
+        if (this->size >= sizeof(struct exe_mz_header)) oprintf(this->out, "Not a DOS/MZ executable: %s\n", this->fname);
+        return;
+    }
+    print_mz_header(this);
+    if (this->mz->relocationEntries) print_mz_relocs(this);
+    if (this->opts->noffset == -1 && this->mzx) {
+        oprintf(this->out, "Offset to next header:\t\t0x%08"PRIx32"\n", this->mzx->nextHeader);
+        print_next_header(this);
+    }
+    if (this->opts->verify) print_checksums(this);
+}
+
+/*
+ * JSON output. Field names follow the structure members in mz.h, ne.h,
+ * le.h and w3.h; numbers are decimal.
+ */
+
+void json_mz(struct THIS *this) {
+    struct outbuf *o = this->out;
+    const struct exe_mz_reloc *reloc = this->mzreltab;
+    uint16_t *segs;
+    int i, run;
+    char buf[32];
+
+    json_open(o, "mz", '{');
+    json_strn(o, "magic", this->mz->magic, 2);
+    json_uint(o, "lastPageSize", this->mz->lastPageSize);
+    json_uint(o, "pageCount", this->mz->pageCount);
+    json_uint(o, "relocationEntries", this->mz->relocationEntries);
+    json_uint(o, "hdrSize", this->mz->hdrSize);
+    json_uint(o, "minMemory", this->mz->minMemory);
+    json_uint(o, "maxMemory", this->mz->maxMemory);
+    json_uint(o, "stackSegment", this->mz->stackSegment);
+    json_uint(o, "stackPointer", this->mz->stackPointer);
+    json_uint(o, "checksum", this->mz->checksum);
+    json_uint(o, "initCodeSeg", this->mz->initCodeSeg);
+    json_uint(o, "initInstPtr", this->mz->initInstPtr);
+    json_uint(o, "relocationOffset", this->mz->relocationOffset);
+    json_uint(o, "overlayNumber", this->mz->overlayNumber);
+    json_uint(o, "imageSize", mz_image_size(this));
+    if (this->need & NEED_MZ_PACKER && mz_packer(this, NULL)) json_str(o, "packer", mz_packer_desc(this, buf));
+    if (this->mz_relocCount) {
+        json_open(o, "relocations", '{');
+        json_uint(o, "count", this->mz_relocCount);
+        json_uint(o, "duplicates", this->mz_relocDups);
+        json_uint(o, "outsideImage", this->mz_relocOutside);
+        if (!this->opts->summary) {
+            json_open(o, "entries", '[');
+            for (i = 0; i < this->mz_relocCount; i++) {
+                json_open(o, NULL, '{');
+                json_uint(o, "segment", reloc[i].segment);
+                json_uint(o, "offset", reloc[i].offset);
+                json_close(o, '}');
+            }
+            json_close(o, ']');
+        } else {
+            if (!(segs = malloc(sizeof(uint16_t) * this->mz_relocCount))) err(1, "Cannot allocate memory");
+            for (i = 0; i < this->mz_relocCount; i++)
+                segs[i] = reloc[i].segment;
+            qsort(segs, this->mz_relocCount, sizeof(uint16_t), compare_u16);
+            json_open(o, "segments", '[');
+            for (i = 0; i < this->mz_relocCount; i += run) {
+                for (run = 1; i + run < this->mz_relocCount && segs[i + run] == segs[i]; run++);
+                json_open(o, NULL, '{');
+                json_uint(o, "segment", segs[i]);
+                json_uint(o, "count", run);
+                json_close(o, '}');
+            }
+            json_close(o, ']');
+            free(segs);
+        }
+        json_close(o, '}');
+    }
+    json_close(o, '}');
+}
+
+void json_ne(struct THIS *this) {
+    struct outbuf *o = this->out;
+    const struct exe_ne_header *ne = this->ne;
+    const struct exe_ne_reloc *r;
+    struct ne_segrelocs *sr;
+    const struct ne_resource *res;
+    const struct exe_ne_export *exp;
+    char name[NE_IMPORT_REF_MAX];
+    int i, j;
+
+    json_open(o, "ne", '{');
+    json_strn(o, "magic", ne->magic, 2);
+    json_uint(o, "linkerMajor", ne->linkerMajor);
+    json_uint(o, "linkerMinor", ne->linkerMinor);
+    json_uint(o, "entryTableOffset", ne->entryTableOffset);
+    json_uint(o, "entryTableSize", ne->entryTableSize);
+    json_uint(o, "fileCrc", ne->fileCrc);
+    json_uint(o, "progFlags", ne->progFlags);
+    json_str(o, "dataType", ne_data_type_name(ne->dataType));
+    json_bool(o, "globalInit", ne->globalInit);
+    json_bool(o, "pmModeOnly", ne->pmModeOnly);
+    json_bool(o, "ops8086", ne->ops8086);
+    json_bool(o, "ops80286", ne->ops80286);
+    json_bool(o, "ops80386", ne->ops80386);
+    json_bool(o, "ops80x87", ne->ops80x87);
+    json_uint(o, "appFlags", ne->appFlags);
+    json_str(o, "appType", ne_app_type_name(ne->appType));
+    json_bool(o, "os2FamExec", ne->os2FamExec);
+    json_bool(o, "executable", ne->executable);
+    json_bool(o, "linkErrors", ne->linkErrors);
+    json_bool(o, "libraryBit", ne->libraryBit);
+    json_uint(o, "autoDataSegAddr", ne->autoDataSegAddr);
+    json_uint(o, "initHeapSize", ne->initHeapSize);
+    json_uint(o, "initStackSize", ne->initStackSize);
+    json_uint(o, "entryPointSegment", ne->entryPoint >> 16);
+    json_uint(o, "entryPointOffset", ne->entryPoint & 0xFFFF);
+    json_uint(o, "initStackSegment", ne->initStackPtr >> 16);
+    json_uint(o, "initStackOffset", ne->initStackPtr & 0xFFFF);
+    json_uint(o, "segmentCount", ne->segmentCount);
+    json_uint(o, "modRefCount", ne->modRefCount);
+    json_uint(o, "nonResidentTableSize", ne->nonResidentTableSize);
+    json_uint(o, "segmentTableOffset", ne->segmentTableOffset);
+    json_uint(o, "resourceTableOffset", ne->resourceTableOffset);
+    json_uint(o, "residentNamesTableOffset", ne->residentNamesTableOffset);
+    json_uint(o, "modulesTableOffset", ne->modulesTableOffset);
+    json_uint(o, "importedNamesTableOffset", ne->importedNamesTableOffset);
+    json_uint(o, "nonResidentTableOffset", ne->nonResidentTableOffset);
+    json_uint(o, "movableEntryPoints", ne->movableEntryPoints);
+    json_uint(o, "offsetShiftCount", ne->offsetShiftCount);
+    json_uint(o, "resourceTableSize", ne->resourceTableSize);
+    json_uint(o, "targetOS", ne->targetOS);
+    json_str(o, "targetOSName", ne_target_os_name(ne->targetOS));
+    json_uint(o, "exeFlags", ne->exeFlags);
+    json_bool(o, "os2LFN", ne->os2LFN);
+    json_bool(o, "os2PMode", ne->os2PMode);
+    json_bool(o, "os2Fonts", ne->os2Fonts);
+    json_bool(o, "fastLoad", ne->fastLoad);
+    json_uint(o, "returnThunksOffset", ne->returnThunksOffset);
+    json_uint(o, "segmentReferenceOffset", ne->segmentReferenceOffset);
+    json_uint(o, "windowsVersionMajor", ne->windowsVersionMajor);
+    json_uint(o, "windowsVersionMinor", ne->windowsVersionMinor);
+
+    json_open(o, "modules", '[');
+    for (i = 0; i < this->ne_moduleCount; i++)
+        json_strn(o, NULL, this->nemods[i].name, this->nemods[i].size);
+    json_close(o, ']');
+
+    json_open(o, "segments", '[');
+    for (i = 0; this->nesegs && i < ne->segmentCount; i++) {
+        json_open(o, NULL, '{');
+        json_uint(o, "segmentOffset", this->nesegs[i].segmentOffset);
+        json_uint(o, "fileOffset", ne_segment_offset(this, i));
+        json_uint(o, "segmentSize", this->nesegs[i].segmentSize ? this->nesegs[i].segmentSize : 0x10000);
+        json_uint(o, "minimumAllocation", this->nesegs[i].minimumAllocation ? this->nesegs[i].minimumAllocation : 0x10000);
+        json_uint(o, "segmentFlags", this->nesegs[i].segmentFlags);
+        json_str(o, "type", this->nesegs[i].segType ? "DATA" : "CODE");
+        json_bool(o, "iterated", this->nesegs[i].iterated);
+        json_bool(o, "allocated", this->nesegs[i].allocated);
+        json_bool(o, "loaded", this->nesegs[i].loaded);
+        json_bool(o, "moveable", this->nesegs[i].relocatable);
+        json_bool(o, "pure", this->nesegs[i].shared);
+        json_bool(o, "preload", this->nesegs[i].preload);
+        json_bool(o, "relocInfo", this->nesegs[i].relocations);
+        json_bool(o, "discardable", this->nesegs[i].discardable);
+        if (this->opts->hash) {
+            json_hash(this, ne_segment_hash, i);
+            if (!this->neimages) ne_load_segments(this, this->opts->jobs);
+            if (this->neimages) {
+                json_open(o, "loaded", '{');
+                json_uint(o, "size", this->neimages[i].size);
+                json_uint(o, "relocationsApplied", this->neimages[i].applied);
+                json_uint(o, "relocationsLeft", this->neimages[i].unresolved);
+                json_hash(this, ne_image_hash, i);
+                json_close(o, '}');
+            }
+        }
+        if (this->nerelocs && this->nerelocs[i].present) {
+            sr = &this->nerelocs[i];
+            json_open(o, "relocations", '{');
+            json_uint(o, "fileOffset", sr->fileOffset);
+            json_uint(o, "count", sr->count);
+            json_uint(o, "locations", sr->sites);
+            json_uint(o, "internal", sr->byType[RELTYPE_INTREF]);
+            json_uint(o, "byOrdinal", sr->byType[RELTYPE_IMPORD]);
+            json_uint(o, "byName", sr->byType[RELTYPE_IMPNAME]);
+            json_uint(o, "osFixups", sr->byType[RELTYPE_OSFIXUP]);
+            json_uint(o, "additive", sr->additive);
+            json_open(o, "topImports", '[');
+            for (j = 0; j < sr->ntop; j++) {
+                json_open(o, NULL, '{');
+                json_str(o, "name", ne_import_ref(this, NE_IMPORT_KEY_MODULE(sr->top[j]), NE_IMPORT_KEY_BYNAME(sr->top[j]), NE_IMPORT_KEY_VALUE(sr->top[j]), name));
+                json_uint(o, "count", sr->topcount[j]);
+                json_close(o, '}');
+            }
+            json_close(o, ']');
+            if (!this->opts->summary) {
+                json_open(o, "entries", '[');
+                for (j = 0; j < sr->count; j++) {
+                    r = &sr->relocs[j];
+                    json_open(o, NULL, '{');
+                    json_str(o, "addressType", ne_raddr_name(r->addressType));
+                    json_uint(o, "offset", r->offset);
+                    switch (r->relocationType & RELTYPE_MASK) {
+                        case RELTYPE_INTREF:
+                            if (r->segment == NE_MOVABLE_SEGMENT) {
+                                json_str(o, "target", "movable");
+                                json_uint(o, "entry", r->ordinal);
+                            } else {
+                                json_str(o, "target", "internal");
+                                json_uint(o, "segment", r->segment);
+                                json_uint(o, "segmentOffset", r->ordinal);
+                            }
+                            break;
+                        case RELTYPE_IMPORD:
+                            json_str(o, "target", "ordinal");
+                            json_str(o, "import", ne_import_ref(this, r->moduleReference, 0, r->importOrdinal, name));
+                            break;
+                        case RELTYPE_IMPNAME:
+                            json_str(o, "target", "name");
+                            json_str(o, "import", ne_import_ref(this, r->moduleReference, 1, r->importNameOffset, name));
+                            break;
+                        case RELTYPE_OSFIXUP:
+                            json_str(o, "target", "osfixup");
+                            json_str(o, "fixup", ne_osfixup_name(r->osFixupType));
+                            break;
+                    }
+                    json_bool(o, "additive", r->relocationType & RELFLAG_ADDITIVE);
+                    json_close(o, '}');
+                }
+                json_close(o, ']');
+            }
+            json_close(o, '}');
+        }
+        json_close(o, '}');
+    }
+    json_close(o, ']');
+
+    if (this->ne_moduleName.size) json_strn(o, "moduleName", this->ne_moduleName.name, this->ne_moduleName.size);
+    if (this->ne_description.size) json_strn(o, "description", this->ne_description.name, this->ne_description.size);
+    if (this->neexps) {
+        json_open(o, "entries", '[');
+        for (i = 0; i < this->ne_exportCount; i++) {
+            exp = &this->neexps[i];
+            if (!exp->segment) continue;
+            json_open(o, NULL, '{');
+            json_uint(o, "ordinal", exp->ordinal);
+            json_str(o, "type", ne_entry_kind(exp));
+            if (exp->segment != NE_BUNDLE_CONSTANT) json_uint(o, "segment", exp->segment);
+            json_uint(o, exp->segment == NE_BUNDLE_CONSTANT ? "value" : "offset", exp->offset);
+            json_bool(o, "exported", exp->flags & NE_ENTRY_EXPORTED);
+            json_bool(o, "shared", exp->flags & NE_ENTRY_SHARED);
+            json_uint(o, "parameterWords", exp->flags >> 3);
+            if (exp->size) {
+                json_strn(o, "name", exp->name, exp->size);
+                json_bool(o, "resident", exp->resident);
+            }
+            json_close(o, '}');
+        }
+        json_close(o, ']');
+    }
+
+    if (this->ne_resourceCount) {
+        json_uint(o, "resourceAlignShift", this->ne_resShift);
+        json_open(o, "resources", '[');
+        for (i = 0; i < this->ne_resourceCount; i++) {
+            res = &this->neres[i];
+            json_open(o, NULL, '{');
+            if (res->typeName) json_strn(o, "typeName", res->typeName, res->typeNameLen);
+            else {
+                json_uint(o, "type", res->type);
+                if (ne_resource_type_name(res->type)) json_str(o, "typeName", ne_resource_type_name(res->type));
+            }
+            if (res->name) json_strn(o, "name", res->name, res->nameLen);
+            else json_uint(o, "id", res->id);
+            json_uint(o, "fileOffset", res->fileOffset);
+            json_uint(o, "size", res->size);
+            json_uint(o, "flags", res->flags);
+            json_bool(o, "moveable", res->flags & NE_RES_MOVEABLE);
+            json_bool(o, "pure", res->flags & NE_RES_PURE);
+            json_bool(o, "preload", res->flags & NE_RES_PRELOAD);
+            json_close(o, '}');
+        }
+        json_close(o, ']');
+    }
+    json_close(o, '}');
+}
+
+static void json_le_names(struct outbuf *o, const char *key, const struct exe_le_name *names, int count, int ordinals) {
+    int i;
+
+    json_open(o, key, '[');
+    for (i = 0; i < count; i++) {
+        if (!ordinals) {
+            json_strn(o, NULL, names[i].name, names[i].size);
+            continue;
+        }
+        json_open(o, NULL, '{');
+        json_strn(o, "name", names[i].name, names[i].size);
+        json_uint(o, "ordinal", names[i].ordinal);
+        json_close(o, '}');
+    }
+    json_close(o, ']');
+}
+
+void json_le(struct THIS *this) {
+    struct outbuf *o = this->out;
+    const struct exe_le_header *le = this->le;
+    const struct exe_le_object *obj;
+    const struct exe_le_entry *ent;
+    const struct le_page *pg;
+    const struct le_fixups *fx;
+    char name[NE_IMPORT_REF_MAX];
+    uint32_t j, k;
+    int i, page, islx = this->kind == EXE_LX;
+
+    le_load(this, LE_HAVE_PAGES | LE_HAVE_ENTRIES | LE_HAVE_RESNAMES | LE_HAVE_NONRESNAMES | LE_HAVE_IMPORTS);
+    json_open(o, "le", '{');
+    json_strn(o, "magic", le->magic, 2);
+    json_uint(o, "byteOrder", le->byteOrder);
+    json_uint(o, "wordOrder", le->wordOrder);
+    json_uint(o, "level", le->level);
+    json_uint(o, "cpuType", le->cpuType);
+    json_str(o, "cpuName", le_cpu_name(le->cpuType));
+    json_uint(o, "osType", le->osType);
+    json_str(o, "osName", le_os_name(le->osType));
+    json_uint(o, "version", le->version);
+    json_uint(o, "flags", le->flags);
+    json_str(o, "moduleType", le_module_type_name(le->moduleType));
+    json_uint(o, "pages", le->pages);
+    json_uint(o, "startingObject", le->startingObject);
+    json_uint(o, "entryPoint", le->entryPoint);
+    json_uint(o, "stackObject", le->stackObject);
+    json_uint(o, "stackPointer", le->stackPointer);
+    json_uint(o, "pageSize", le->pageSize);
+    json_uint(o, islx ? "pageShift" : "lastPage", le->lastPage);
+    json_uint(o, "fixupSize", le->fixupSize);
+    json_uint(o, "fixupChecksum", le->fixupChecksum);
+    json_uint(o, "loaderSize", le->loaderSize);
+    json_uint(o, "loaderChecksum", le->loaderChecksum);
+    json_uint(o, "objectTableOffset", le->objectTableOffset);
+    json_uint(o, "objectCount", le->objectCount);
+    json_uint(o, "objectMapOffset", le->objectMapOffset);
+    json_uint(o, "idataMapOffset", le->idataMapOffset);
+    json_uint(o, "resourceOffset", le->resourceOffset);
+    json_uint(o, "resourceCount", le->resourceCount);
+    json_uint(o, "residentNameTableOffset", le->residentNameTableOffset);
+    json_uint(o, "entryTableOffset", le->entryTableOffset);
+    json_uint(o, "moduleDirectiveOffset", le->moduleDirectiveOffset);
+    json_uint(o, "moduleDirectiveCount", le->moduleDirectiveCount);
+    json_uint(o, "fixupPageTableOffset", le->fixupPageTableOffset);
+    json_uint(o, "fixupRecordTableOffset", le->fixupRecordTableOffset);
+    json_uint(o, "importModuleNameTableOffset", le->importModuleNameTableOffset);
+    json_uint(o, "importModuleNameTableCount", le->importModuleNameTableCount);
+    json_uint(o, "importProcNameTableOffset", le->importProcNameTableOffset);
+    json_uint(o, "pageChecksumTableOffset", le->pageChecksumTableOffset);
+    json_uint(o, "dataPagesOffset", le->dataPagesOffset);
+    json_uint(o, "preloadPageCount", le->preloadPageCount);
+    json_uint(o, "nonresidentNameTableOffset", le->nonresidentNameTableOffset);
+    json_uint(o, "nonresidentNameTableSize", le->nonresidentNameTableSize);
+    json_uint(o, "autodataObject", le->autodataObject);
+    json_uint(o, "heapSize", le->heapSize);
+    json_uint(o, "stackSize", le->stackSize);
+    if (!islx && le->osType == LE_OS_WINDOWS) {
+        json_uint(o, "windowsResourceOffset", le->windowsResourceOffset);
+        json_uint(o, "windowsResourceSize", le->windowsResourceSize);
+        json_uint(o, "windowsDeviceID", le->windowsDeviceID);
+        json_uint(o, "windowsDDKVersion", le->windowsDDKVersion);
+    }
+
+    json_open(o, "objects", '[');
+    for (i = 0; i < this->le_objectCount; i++) {
+        obj = &this->leobjs[i];
+        json_open(o, NULL, '{');
+        json_uint(o, "virtualSize", obj->virtualSize);
+        json_uint(o, "relocBase", obj->relocBase);
+        json_uint(o, "flags", obj->flags);
+        json_uint(o, "pageMapIndex", obj->pageMapIndex);
+        json_uint(o, "pageMapEntries", obj->pageMapEntries);
+        if (this->opts->hash) {
+            json_hash(this, le_object_hash, i);
+            le_expand_pages(this, this->opts->jobs);
+            if (this->leimage) {
+                json_open(o, "expanded", '{');
+                json_hash(this, le_image_hash, i);
+                json_close(o, '}');
+            }
+        }
+        if (!this->opts->summary) {
+            json_open(o, "pages", '[');
+            for (j = obj->pageMapIndex; j - obj->pageMapIndex < obj->pageMapEntries && j >= 1 && j <= (uint32_t) this->le_pageCount; j++) {
+                pg = &this->lepages[j - 1];
+                json_open(o, NULL, '{');
+                json_uint(o, "page", j);
+                json_uint(o, "fileOffset", pg->fileOffset);
+                json_uint(o, "size", pg->size);
+                json_str(o, "type", le_page_type_name(pg->flags));
+                json_close(o, '}');
+            }
+            json_close(o, ']');
+        }
+        json_close(o, '}');
+    }
+    json_close(o, ']');
+
+    json_le_names(o, "residentNames", this->leresnames, this->le_resnameCount, 1);
+    json_le_names(o, "nonResidentNames", this->lenonresnames, this->le_nonresnameCount, 1);
+    json_uint(o, "entryCount", this->le_entryCount);
+    json_open(o, "entries", '[');
+    for (i = 0; !this->opts->summary && i < this->le_entryCount; i++) {
+        ent = &this->leents[i];
+        json_open(o, NULL, '{');
+        json_uint(o, "ordinal", ent->ordinal);
+        json_str(o, "type", le_bundle_type_name(ent->type));
+        json_uint(o, "flags", ent->flags);
+        if (ent->type == LE_BUNDLE_FORWARDER) {
+            json_str(o, "forwarder", le_forwarder_ref(this, ent, name));
+        } else {
+            json_uint(o, "object", ent->object);
+            json_uint(o, "offset", ent->offset);
+            if (ent->type == LE_BUNDLE_GATE286) json_uint(o, "callgate", ent->callgate);
+        }
+        json_close(o, '}');
+    }
+    json_close(o, ']');
+    json_le_names(o, "importModules", this->leimpmods, this->le_impmodCount, 0);
+    json_le_names(o, "importProcs", this->leimpprocs, this->le_impprocCount, 0);
+
+    le_load_fixups(this, this->opts->jobs);
+    fx = &this->lefix;
+    json_open(o, "fixups", '{');
+    json_uint(o, "count", fx->count);
+    if (!this->opts->summary) {
+        json_open(o, "entries", '[');
+        for (k = 0, page = 0; k < fx->count; k++) {
+            while (fx->pageStart[page + 1] <= k) page++;
+            json_open(o, NULL, '{');
+            json_uint(o, "page", page + 1);
+            json_int(o, "offset", fx->source[k]);
+            json_str(o, "type", le_fixup_source_name(fx->sourceType[k]));
+            json_bool(o, "alias", fx->sourceType[k] & LE_FIXUP_ALIAS);
+            switch (fx->targetFlags[k] & LE_TARGET_MASK) {
+                case LE_TARGET_INTERNAL:
+                    json_str(o, "target", "internal");
+                    json_uint(o, "object", fx->target[k]);
+                    if ((fx->sourceType[k] & LE_FIXUP_SOURCE_MASK) != LE_FIXUP_SELECTOR16) json_uint(o, "objectOffset", fx->value[k]);
+                    break;
+                case LE_TARGET_IMPORD:
+                    json_str(o, "target", "ordinal");
+                    json_str(o, "import", le_fixup_ref(this, k, name));
+                    break;
+                case LE_TARGET_IMPNAME:
+                    json_str(o, "target", "name");
+                    json_str(o, "import", le_fixup_ref(this, k, name));
+                    break;
+                case LE_TARGET_ENTRY:
+                    json_str(o, "target", "entry");
+                    json_uint(o, "entry", fx->target[k]);
+                    break;
+            }
+            if (fx->targetFlags[k] & LE_TARGET_ADDITIVE) json_uint(o, "additive", fx->additive[k]);
+            json_close(o, '}');
+        }
+        json_close(o, ']');
+    }
+    json_close(o, '}');
+    json_close(o, '}');
+}
+
+void json_pe(struct THIS *this) {
+    struct outbuf *o = this->out;
+    const struct exe_pe_header *pe = this->pe;
+    const struct exe_pe_section *sec;
+    const struct exe_pe_module *mod;
+    const struct exe_pe_import *imp;
+    const struct exe_pe_export *exp;
+    int i, j;
+
+    pe_load(this, PE_HAVE_IMPORTS | PE_HAVE_EXPORTS);
+    json_open(o, "pe", '{');
+    json_uint(o, "machine", pe->machine);
+    json_str(o, "machineName", pe_machine_name(pe->machine));
+    json_uint(o, "numberOfSections", pe->numberOfSections);
+    json_uint(o, "timeDateStamp", pe->timeDateStamp);
+    json_uint(o, "pointerToSymbolTable", pe->pointerToSymbolTable);
+    json_uint(o, "numberOfSymbols", pe->numberOfSymbols);
+    json_uint(o, "sizeOfOptionalHeader", pe->sizeOfOptionalHeader);
+    json_uint(o, "characteristics", pe->characteristics);
+    if (this->pe32 || this->pe64) {
+#define PE_OPT(field) (this->pe32 ? (uint64_t) this->pe32->field : (uint64_t) this->pe64->field)
+        json_open(o, "optional", '{');
+        json_uint(o, "magic", PE_OPT(magic));
+        json_str(o, "format", this->pe32 ? "PE32" : "PE32+");
+        json_uint(o, "linkerMajor", PE_OPT(linkerMajor));
+        json_uint(o, "linkerMinor", PE_OPT(linkerMinor));
+        json_uint(o, "sizeOfCode", PE_OPT(sizeOfCode));
+        json_uint(o, "sizeOfInitializedData", PE_OPT(sizeOfInitializedData));
+        json_uint(o, "sizeOfUninitializedData", PE_OPT(sizeOfUninitializedData));
+        json_uint(o, "addressOfEntryPoint", PE_OPT(addressOfEntryPoint));
+        json_uint(o, "baseOfCode", PE_OPT(baseOfCode));
+        if (this->pe32) json_uint(o, "baseOfData", this->pe32->baseOfData);
+        json_uint(o, "imageBase", PE_OPT(imageBase));
+        json_uint(o, "sectionAlignment", PE_OPT(sectionAlignment));
+        json_uint(o, "fileAlignment", PE_OPT(fileAlignment));
+        json_uint(o, "osMajor", PE_OPT(osMajor));
+        json_uint(o, "osMinor", PE_OPT(osMinor));
+        json_uint(o, "imageMajor", PE_OPT(imageMajor));
+        json_uint(o, "imageMinor", PE_OPT(imageMinor));
+        json_uint(o, "subsystemMajor", PE_OPT(subsystemMajor));
+        json_uint(o, "subsystemMinor", PE_OPT(subsystemMinor));
+        json_uint(o, "win32VersionValue", PE_OPT(win32VersionValue));
+        json_uint(o, "sizeOfImage", PE_OPT(sizeOfImage));
+        json_uint(o, "sizeOfHeaders", PE_OPT(sizeOfHeaders));
+        json_uint(o, "checkSum", PE_OPT(checkSum));
+        json_uint(o, "subsystem", PE_OPT(subsystem));
+        json_str(o, "subsystemName", pe_subsystem_name((uint16_t) PE_OPT(subsystem)));
+        json_uint(o, "dllCharacteristics", PE_OPT(dllCharacteristics));
+        json_uint(o, "sizeOfStackReserve", PE_OPT(sizeOfStackReserve));
+        json_uint(o, "sizeOfStackCommit", PE_OPT(sizeOfStackCommit));
+        json_uint(o, "sizeOfHeapReserve", PE_OPT(sizeOfHeapReserve));
+        json_uint(o, "sizeOfHeapCommit", PE_OPT(sizeOfHeapCommit));
+        json_uint(o, "loaderFlags", PE_OPT(loaderFlags));
+        json_uint(o, "numberOfRvaAndSizes", PE_OPT(numberOfRvaAndSizes));
+        json_close(o, '}');
+#undef PE_OPT
+    }
+    json_open(o, "dataDirectories", '[');
+    for (i = 0; i < this->pe_dirCount; i++) {
+        json_open(o, NULL, '{');
+        json_str(o, "name", i < PE_DIR_COUNT ? pe_dir_names[i] : "");
+        json_uint(o, "virtualAddress", this->pedirs[i].virtualAddress);
+        json_uint(o, "size", this->pedirs[i].size);
+        json_close(o, '}');
+    }
+    json_close(o, ']');
+    json_open(o, "sections", '[');
+    for (i = 0; i < this->pe_sectionCount; i++) {
+        sec = &this->pesecs[i];
+        json_open(o, NULL, '{');
+        json_strn(o, "name", sec->name, pe_section_name_len(sec));
+        json_uint(o, "virtualSize", sec->virtualSize);
+        json_uint(o, "virtualAddress", sec->virtualAddress);
+        json_uint(o, "sizeOfRawData", sec->sizeOfRawData);
+        json_uint(o, "pointerToRawData", sec->pointerToRawData);
+        json_uint(o, "characteristics", sec->characteristics);
+        json_close(o, '}');
+    }
+    json_close(o, ']');
+    json_open(o, "imports", '[');
+    for (i = 0; i < this->pe_moduleCount; i++) {
+        mod = &this->pemods[i];
+        json_open(o, NULL, '{');
+        json_strn(o, "module", mod->name, mod->nameLen);
+        json_bool(o, "delay", mod->delay);
+        json_uint(o, "count", mod->count);
+        if (!this->opts->summary) {
+            json_open(o, "functions", '[');
+            for (j = 0; j < mod->count; j++) {
+                imp = &this->peimps[mod->first + j];
+                json_open(o, NULL, '{');
+                if (imp->name) {
+                    json_strn(o, "name", imp->name, imp->nameLen);
+                    json_uint(o, "hint", imp->hint);
+                } else json_uint(o, "ordinal", imp->hint);
+                json_close(o, '}');
+            }
+            json_close(o, ']');
+        }
+        json_close(o, '}');
+    }
+    json_close(o, ']');
+    if (this->peexpdir) {
+        json_open(o, "exports", '{');
+        json_strn(o, "name", this->pe_expName ? this->pe_expName : "", this->pe_expNameLen);
+        json_uint(o, "base", this->peexpdir->base);
+        json_uint(o, "numberOfFunctions", this->peexpdir->numberOfFunctions);
+        json_uint(o, "numberOfNames", this->peexpdir->numberOfNames);
+        if (!this->opts->summary) {
+            json_open(o, "entries", '[');
+            for (i = 0; i < this->pe_exportCount; i++) {
+                exp = &this->peexps[i];
+                json_open(o, NULL, '{');
+                json_uint(o, "ordinal", exp->ordinal);
+                json_uint(o, "rva", exp->rva);
+                if (exp->name) json_strn(o, "name", exp->name, exp->nameLen);
+                if (exp->forwarder) json_strn(o, "forwarder", exp->forwarder, exp->forwarderLen);
+                json_close(o, '}');
+            }
+            json_close(o, ']');
+        }
+        json_close(o, '}');
+    }
+    json_close(o, '}');
+}
+
+void json_w3(struct THIS *this) {
+    struct outbuf *o = this->out;
+    struct THIS *le;
+    int i, n;
+
+    w3_load_modules(this, this->opts->jobs);
+    if (this->w4) {
+        json_open(o, "w4", '{');
+        json_uint(o, "vmmVersion", this->w4->vmm_version);
+        json_uint(o, "chunkSize", this->w4->chunkSize);
+        json_uint(o, "chunkCount", this->w4_chunkCount);
+        json_uint(o, "expandedSize", this->wx_imageSize);
+        json_close(o, '}');
+    }
+    if (!this->w3) return;
+    json_open(o, "w3", '{');
+    json_uint(o, "vmmMajor", this->w3->vmm_major);
+    json_uint(o, "vmmMinor", this->w3->vmm_minor);
+    json_open(o, "modules", '[');
+    for (i = 0; i < this->wx_modcount; i++) {
+        /* Names are blank padded to eight characters. */
+        for (n = 8; n && (this->w3mods[i].name[n - 1] == ' ' || !this->w3mods[i].name[n - 1]); n--);
+        json_open(o, NULL, '{');
+        json_strn(o, "name", this->w3mods[i].name, n);
+        json_uint(o, "offset", this->w3mods[i].offset);
+        json_uint(o, "size", this->w3mods[i].size);
+        if (this->opts->hash) json_hash(this, w3_module_hash, i);
+        /* The VxD itself, as it would be for a file of its own */
+        if (this->wxles && (le = this->wxles[i]) && le->le) {
+            le->opts = this->opts;
+            le->out = o;
+            json_str(o, "format", exe_kind_names[le->kind]);
+            json_le(le);
+        }
+        json_close(o, '}');
+    }
+    json_close(o, ']');
+    json_close(o, '}');
+}
+
+void print_json(struct THIS *this) {
+    struct outbuf *o = this->out;
+
+    json_open(o, NULL, '{');
+    json_str(o, "file", this->fname);
+    json_str(o, "format", exe_kind_names[this->kind]);
+    if (this->mz) json_mz(this);
+    if (this->nextMagic) {
+        json_uint(o, "nextHeader", this->mzx->nextHeader);
+        json_strn(o, "nextMagic", this->nextMagic, 2);
+    }
+    if (this->ne) json_ne(this);
+    if (this->le) json_le(this);
+    if (this->w3 || this->w4) json_w3(this);
+    if (this->pe) json_pe(this);
+    if (this->opts->verify) json_checksums(this);
+    if (this->stats) json_stats(this);
+    json_close(o, '}');
+    oprintf(o, "\n");
+}
+
+/*
+ * --fields output. In text mode every value is a "file<TAB>field<TAB>value"
+ * line, and a list is one line per element, so the output can go straight
+ * into awk or a spreadsheet. In json and ndjson modes the values are
+ * members of one flat object per file, keyed by field name. Values are
+ * rendered the way the text report shows them.
+ */
+
+static void field_uint(struct THIS *this, const char *key, uint64_t value) {
+    if (this->opts->format == FORMAT_TEXT)
+        oprintf(this->out, "%s\t%s\t%"PRIu64"\n", this->fname, key, value);
+    else
+        json_uint(this->out, key, value);
+}
+
+static void field_strn(struct THIS *this, const char *key, const char *s, size_t len) {
+    if (this->opts->format == FORMAT_TEXT)
+        oprintf(this->out, "%s\t%s\t%.*s\n", this->fname, key, (int) len, s);
+    else
+        json_strn(this->out, key, s, len);
+}
+
+static void field_str(struct THIS *this, const char *key, const char *s) {
+    field_strn(this, key, s, strlen(s));
+}
+
+static void field_list(struct THIS *this, const char *key, char bracket) {
+    if (this->opts->format == FORMAT_TEXT) return;
+    if (bracket == '[') json_open(this->out, key, '['); else json_close(this->out, ']');
+}
+
+static void field_item(struct THIS *this, const char *key, const char *s, size_t len) {
+    if (this->opts->format == FORMAT_TEXT)
+        oprintf(this->out, "%s\t%s\t%.*s\n", this->fname, key, (int) len, s);
+    else
+        json_strn(this->out, NULL, s, len);
+}
+
+static void field_format(struct THIS *this, const char *key) {
+    field_str(this, key, exe_kind_names[this->kind]);
+}
+
+static void field_mz_entry(struct THIS *this, const char *key) {
+    char buf[10];
+
+    sprintf(buf, "%04"PRIx16":%04"PRIx16, this->mz->initCodeSeg, this->mz->initInstPtr);
+    field_str(this, key, buf);
+}
+
+static void field_mz_packer(struct THIS *this, const char *key) {
+    char buf[32];
+
+    field_str(this, key, mz_packer_desc(this, buf));
+}
+
+static void field_mz_stack(struct THIS *this, const char *key) {
+    char buf[10];
+
+    sprintf(buf, "%04"PRIx16":%04"PRIx16, this->mz->stackSegment, this->mz->stackPointer);
+    field_str(this, key, buf);
+}
+
+static void field_mz_reloc_entries(struct THIS *this, const char *key) {
+    field_uint(this, key, this->mz->relocationEntries);
+}
+
+static void field_mz_image_size(struct THIS *this, const char *key) {
+    field_uint(this, key, mz_image_size(this));
+}
+
+static void field_mz_reloc_dups(struct THIS *this, const char *key) {
+    field_uint(this, key, this->mz_relocDups);
+}
+
+static void field_mz_reloc_outside(struct THIS *this, const char *key) {
+    field_uint(this, key, this->mz_relocOutside);
+}
+
+static void field_next_header(struct THIS *this, const char *key) {
+    if (this->mzx) field_uint(this, key, this->mzx->nextHeader);
+}
+
+static void field_ne_target_os(struct THIS *this, const char *key) {
+    field_str(this, key, ne_target_os_name(this->ne->targetOS));
+}
+
+static void field_ne_windows_version(struct THIS *this, const char *key) {
+    char buf[8];
+
+    sprintf(buf, "%"PRIu8".%02"PRIu8, this->ne->windowsVersionMajor, this->ne->windowsVersionMinor);
+    field_str(this, key, buf);
+}
+
+static void field_ne_linker(struct THIS *this, const char *key) {
+    char buf[8];
+
+    sprintf(buf, "%"PRIu8".%"PRIu8, this->ne->linkerMajor, this->ne->linkerMinor);
+    field_str(this, key, buf);
+}
+
+static void field_ne_app_type(struct THIS *this, const char *key) {
+    field_str(this, key, ne_app_type_name(this->ne->appType));
+}
+
+static void field_ne_data_type(struct THIS *this, const char *key) {
+    field_str(this, key, ne_data_type_name(this->ne->dataType));
+}
+
+static void field_ne_library(struct THIS *this, const char *key) {
+    field_uint(this, key, this->ne->libraryBit);
+}
+
+static void field_ne_entry(struct THIS *this, const char *key) {
+    char buf[10];
+
+    sprintf(buf, "%04"PRIx32":%04"PRIx32, this->ne->entryPoint >> 16, this->ne->entryPoint & 0xFFFF);
+    field_str(this, key, buf);
+}
+
+static void field_ne_segment_count(struct THIS *this, const char *key) {
+    field_uint(this, key, this->ne->segmentCount);
+}
+
+static void field_ne_imports(struct THIS *this, const char *key) {
+    int i;
+
+    field_list(this, key, '[');
+    for (i = 0; i < this->ne_moduleCount; i++)
+        field_item(this, key, this->nemods[i].name, this->nemods[i].size);
+    field_list(this, key, ']');
+}
+
+static void field_ne_import_names(struct THIS *this, const char *key) {
+    int i;
+
+    field_list(this, key, '[');
+    for (i = 0; i < this->ne_importCount; i++)
+        field_item(this, key, this->neimps[i].name, this->neimps[i].size);
+    field_list(this, key, ']');
+}
+
+static void field_ne_segments(struct THIS *this, const char *key) {
+    char buf[40];
+    int i, n;
+
+    field_list(this, key, '[');
+    for (i = 0; this->nesegs && i < this->ne->segmentCount; i++) {
+        n = sprintf(buf, "%s 0x%08"PRIx32" %"PRIu32, this->nesegs[i].segType ? "DATA" : "CODE", ne_segment_offset(this, i), ne_segment_size(this, i));
+        field_item(this, key, buf, n);
+    }
+    field_list(this, key, ']');
+}
+
+static void field_ne_relocations(struct THIS *this, const char *key) {
+    unsigned long total = 0;
+    int i;
+
+    for (i = 0; this->nerelocs && i < this->ne->segmentCount; i++)
+        total += this->nerelocs[i].count;
+    field_uint(this, key, total);
+}
+
+static void field_ne_resources(struct THIS *this, const char *key) {
+    const struct ne_resource *r;
+    char buf[560];
+    int i, n;
+
+    field_list(this, key, '[');
+    for (i = 0; i < this->ne_resourceCount; i++) {
+        r = &this->neres[i];
+        n = ne_resource_label(buf, r->type, r->typeName, r->typeNameLen, 1);
+        buf[n++] = ' ';
+        n += ne_resource_label(buf + n, r->id, r->name, r->nameLen, 0);
+        n += sprintf(buf + n, " 0x%08"PRIx32" %"PRIu32, r->fileOffset, r->size);
+        field_item(this, key, buf, n);
+    }
+    field_list(this, key, ']');
+}
+
+static void field_ne_module_name(struct THIS *this, const char *key) {
+    if (this->ne_moduleName.size) field_strn(this, key, this->ne_moduleName.name, this->ne_moduleName.size);
+}
+
+/* One "NAME @ordinal" per entry in use, as in a .DEF file; "@ordinal" alone for an entry with no name. */
+static void field_ne_exports(struct THIS *this, const char *key) {
+    const struct exe_ne_export *exp;
+    char buf[270];
+    int i, n;
+
+    field_list(this, key, '[');
+    for (i = 0; i < this->ne_exportCount; i++) {
+        exp = &this->neexps[i];
+        if (!exp->segment) continue;
+        n = exp->size ? sprintf(buf, "%.*s @%"PRIu16, (int) exp->size, exp->name, exp->ordinal) : sprintf(buf, "@%"PRIu16, exp->ordinal);
+        field_item(this, key, buf, n);
+    }
+    field_list(this, key, ']');
+}
+
+static void field_le_cpu(struct THIS *this, const char *key) {
+    field_str(this, key, le_cpu_name(this->le->cpuType));
+}
+
+static void field_le_os(struct THIS *this, const char *key) {
+    field_str(this, key, le_os_name(this->le->osType));
+}
+
+static void field_le_module_type(struct THIS *this, const char *key) {
+    field_str(this, key, le_module_type_name(this->le->moduleType));
+}
+
+static void field_le_object_count(struct THIS *this, const char *key) {
+    field_uint(this, key, this->le_objectCount);
+}
+
+static void field_le_entry_count(struct THIS *this, const char *key) {
+    le_load(this, LE_HAVE_ENTRIES);
+    field_uint(this, key, this->le_entryCount);
+}
+
+static void field_le_names(struct THIS *this, const char *key, const struct exe_le_name *names, int count) {
+    int i;
+
+    field_list(this, key, '[');
+    for (i = 0; i < count; i++)
+        field_item(this, key, names[i].name, names[i].size);
+    field_list(this, key, ']');
+}
+
+static void field_le_imports(struct THIS *this, const char *key) {
+    le_load(this, LE_HAVE_IMPORTS);
+    field_le_names(this, key, this->leimpmods, this->le_impmodCount);
+}
+
+static void field_le_resident_names(struct THIS *this, const char *key) {
+    le_load(this, LE_HAVE_RESNAMES);
+    field_le_names(this, key, this->leresnames, this->le_resnameCount);
+}
+
+static void field_w3_modules(struct THIS *this, const char *key) {
+    int i, n;
+
+    w3_load_modules(this, this->opts->jobs);
+    field_list(this, key, '[');
+    for (i = 0; i < this->wx_modcount; i++) {
+        for (n = 8; n && (this->w3mods[i].name[n - 1] == ' ' || !this->w3mods[i].name[n - 1]); n--);
+        field_item(this, key, this->w3mods[i].name, n);
+    }
+    field_list(this, key, ']');
+}
+
+static void field_pe_machine(struct THIS *this, const char *key) {
+    field_str(this, key, pe_machine_name(this->pe->machine));
+}
+
+static void field_pe_timestamp(struct THIS *this, const char *key) {
+    field_uint(this, key, this->pe->timeDateStamp);
+}
+
+static void field_pe_format(struct THIS *this, const char *key) {
+    if (this->pe32 || this->pe64) field_str(this, key, this->pe32 ? "PE32" : "PE32+");
+}
+
+static void field_pe_subsystem(struct THIS *this, const char *key) {
+    if (this->pe32 || this->pe64) field_str(this, key, pe_subsystem_name(this->pe32 ? this->pe32->subsystem : this->pe64->subsystem));
+}
+
+static void field_pe_image_base(struct THIS *this, const char *key) {
+    if (this->pe32 || this->pe64) field_uint(this, key, this->pe32 ? this->pe32->imageBase : this->pe64->imageBase);
+}
+
+static void field_pe_entry(struct THIS *this, const char *key) {
+    if (this->pe32 || this->pe64) field_uint(this, key, this->pe32 ? this->pe32->addressOfEntryPoint : this->pe64->addressOfEntryPoint);
+}
+
+static void field_pe_section_count(struct THIS *this, const char *key) {
+    field_uint(this, key, this->pe_sectionCount);
+}
+
+static void field_pe_imports(struct THIS *this, const char *key) {
+    int i;
+
+    pe_load(this, PE_HAVE_IMPORTS);
+    field_list(this, key, '[');
+    for (i = 0; i < this->pe_moduleCount; i++)
+        field_item(this, key, this->pemods[i].name, this->pemods[i].nameLen);
+    field_list(this, key, ']');
+}
+
+static void field_pe_exports(struct THIS *this, const char *key) {
+    int i;
+
+    pe_load(this, PE_HAVE_EXPORTS);
+    field_list(this, key, '[');
+    for (i = 0; i < this->pe_exportCount; i++)
+        if (this->peexps[i].name) field_item(this, key, this->peexps[i].name, this->peexps[i].nameLen);
+    field_list(this, key, ']');
+}
+
+static const struct field field_table[] = {
+    { "format",             FIELD_FILE, NEED_NEXT,          field_format },
+    { "nextHeader",         FIELD_MZ,   0,                  field_next_header },
+    { "mz.entry",           FIELD_MZ,   0,                  field_mz_entry },
+    { "mz.packer",          FIELD_MZ,   NEED_MZ_PACKER,     field_mz_packer },
+    { "mz.stack",           FIELD_MZ,   0,                  field_mz_stack },
+    { "mz.relocationEntries", FIELD_MZ, 0,                  field_mz_reloc_entries },
+    { "mz.imageSize",       FIELD_MZ,   0,                  field_mz_image_size },
+    { "mz.relocDuplicates", FIELD_MZ,   NEED_MZ_RELOCS,     field_mz_reloc_dups },
+    { "mz.relocOutside",    FIELD_MZ,   NEED_MZ_RELOCS,     field_mz_reloc_outside },
+    { "ne.targetOS",        FIELD_NE,   NEED_NEXT,          field_ne_target_os },
+    { "ne.windowsVersion",  FIELD_NE,   NEED_NEXT,          field_ne_windows_version },
+    { "ne.linker",          FIELD_NE,   NEED_NEXT,          field_ne_linker },
+    { "ne.appType",         FIELD_NE,   NEED_NEXT,          field_ne_app_type },
+    { "ne.dataType",        FIELD_NE,   NEED_NEXT,          field_ne_data_type },
+    { "ne.library",         FIELD_NE,   NEED_NEXT,          field_ne_library },
+    { "ne.entry",           FIELD_NE,   NEED_NEXT,          field_ne_entry },
+    { "ne.segmentCount",    FIELD_NE,   NEED_NEXT,          field_ne_segment_count },
+    { "ne.imports",         FIELD_NE,   NEED_NEXT | NEED_NE_NAMES, field_ne_imports },
+    { "ne.importNames",     FIELD_NE,   NEED_NEXT | NEED_NE_NAMES, field_ne_import_names },
+    { "ne.segments",        FIELD_NE,   NEED_NEXT | NEED_NE_SEGMENTS, field_ne_segments },
+    { "ne.relocations",     FIELD_NE,   NEED_NEXT | NEED_NE_RELOCS, field_ne_relocations },
+    { "ne.resources",       FIELD_NE,   NEED_NEXT | NEED_NE_RESOURCES, field_ne_resources },
+    { "ne.moduleName",      FIELD_NE,   NEED_NEXT | NEED_NE_EXPORTS, field_ne_module_name },
+    { "ne.exports",         FIELD_NE,   NEED_NEXT | NEED_NE_EXPORTS, field_ne_exports },
+    { "le.cpu",             FIELD_LE,   NEED_NEXT,          field_le_cpu },
+    { "le.os",              FIELD_LE,   NEED_NEXT,          field_le_os },
+    { "le.moduleType",      FIELD_LE,   NEED_NEXT,          field_le_module_type },
+    { "le.objectCount",     FIELD_LE,   NEED_NEXT,          field_le_object_count },
+    { "le.entryCount",      FIELD_LE,   NEED_NEXT,          field_le_entry_count },
+    { "le.imports",         FIELD_LE,   NEED_NEXT,          field_le_imports },
+    { "le.residentNames",   FIELD_LE,   NEED_NEXT,          field_le_resident_names },
+    { "w3.modules",         FIELD_W3,   NEED_NEXT,          field_w3_modules },
+    { "pe.machine",         FIELD_PE,   NEED_NEXT,          field_pe_machine },
+    { "pe.timeDateStamp",   FIELD_PE,   NEED_NEXT,          field_pe_timestamp },
+    { "pe.format",          FIELD_PE,   NEED_NEXT,          field_pe_format },
+    { "pe.subsystem",       FIELD_PE,   NEED_NEXT,          field_pe_subsystem },
+    { "pe.imageBase",       FIELD_PE,   NEED_NEXT,          field_pe_image_base },
+    { "pe.entry",           FIELD_PE,   NEED_NEXT,          field_pe_entry },
+    { "pe.sectionCount",    FIELD_PE,   NEED_NEXT,          field_pe_section_count },
+    { "pe.imports",         FIELD_PE,   NEED_NEXT,          field_pe_imports },
+    { "pe.exports",         FIELD_PE,   NEED_NEXT,          field_pe_exports }
 };
 
-void read_ne_exe(struct THIS *this);
-void read_ne_segments(struct THIS *this);
-void read_ne_modules_import(struct THIS *this);
-void read_next_header(struct THIS *this);
-void read_ne_header(struct THIS *this);
-void get_ne_modules_count(struct THIS *this);
-void read_le_header(struct THIS *this);
-void read_le_exe(struct THIS *this);
-void read_w3_exe(struct THIS *this);
-void read_mz_reloc(struct THIS *this);
-
-struct THIS *init_this(void);
-void destroy_this(struct THIS *this);
-void display_help(struct THIS *this);
-int main(int argc, char *argv[]);
+#define FIELD_COUNT ((int) (sizeof(field_table) / sizeof(field_table[0])))
 
-void read_ne_exe(struct THIS *this) {
-    if ((this->ne = (struct exe_ne_header *) malloc(sizeof(struct exe_ne_header)))) { 
-        fseek(this->fd, this->mzx->nextHeader, SEEK_SET);
-        if (fread(this->ne, 1, sizeof(struct exe_ne_header), this->fd)!= sizeof(struct exe_ne_header)) {
-            if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-            if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-        } else {
-            read_ne_header(this);
-            read_ne_modules_import(this);
-            read_ne_segments(this);
+/*
+ * Turns "ne.targetOS,ne.imports,mz.entry" into a plan. Unknown names are
+ * fatal, with the list of known ones, so typos don't silently produce
+ * empty columns.
+ */
+struct field_plan *compile_fields(const char *spec) {
+    struct field_plan *plan;
+    const char *p = spec;
+    size_t len;
+    int i, j, max = 1;
+
+    for (i = 0; spec[i]; i++)
+        if (spec[i] == ',') max++;
+    if (!(plan = calloc(1, sizeof(struct field_plan)))
+        || !(plan->fields = malloc(sizeof(struct field *) * max))) err(1, "Cannot allocate memory");
+    for (;;) {
+        len = strcspn(p, ",");
+        if (len) {
+            for (i = 0; i < FIELD_COUNT; i++)
+                if (strlen(field_table[i].name) == len && !strncmp(field_table[i].name, p, len)) break;
+            if (i == FIELD_COUNT) {
+                warnx("Unknown field: %.*s", (int) len, p);
+                fprintf(stderr, "Known fields:");
+                for (i = 0; i < FIELD_COUNT; i++)
+                    fprintf(stderr, "%s%s", i % 6 ? " " : "\n  ", field_table[i].name);
+                fprintf(stderr, "\n");
+                exit(1);
+            }
+            for (j = 0; j < plan->count && plan->fields[j] != &field_table[i]; j++);
+            if (j == plan->count) {
+                plan->fields[plan->count++] = &field_table[i];
+                plan->need |= field_table[i].need;
+            }
         }
-    } else err(1, "Cannot allocate memory");
-    return;
+        if (!p[len]) break;
+        p += len + 1;
+    }
+    if (!plan->count) errx(1, "No fields given");
+    return plan;
 }
 
-void read_ne_segments(struct THIS *this) {
-    uint32_t seg, segsz, minalloc;
+void free_fields(struct field_plan *plan) {
+    if (!plan) return;
+    free(plan->fields);
+    free(plan);
+}
 
-    printf("\n\n");
-    if ((this->nesegs = (struct exe_ne_segment *) malloc(sizeof(struct exe_ne_segment) * this->ne->segmentCount))) {
-        fseek(this->fd, this->mzx->nextHeader + this->ne->segmentTableOffset, SEEK_SET);
+/* Prints the fields selected with --fields for whichever headers this file has. */
+void print_fields(struct THIS *this) {
+    const struct field *f;
+    int i, have;
 
-        if (fread(this->nesegs, 1, (sizeof(struct exe_ne_segment) * this->ne->segmentCount), this->fd) != (sizeof(struct exe_ne_segment) * this->ne->segmentCount)) {
-            if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-            if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-        } else {
-            for(int i = 0; i < this->ne->segmentCount; i++) {
-                printf("Segment %d: %s%s%s%s%s%s%s%s\n", i, 
-                    this->nesegs[i].segType ? "DATA " : "CODE ",
-                    this->nesegs[i].allocated ? "ALLOCATED " : "",
-                    this->nesegs[i].loaded ? "LOADED " : "",
-                    this->nesegs[i].relocatable ? "MOVEABLE " : "",
-                    this->nesegs[i].shared ? "PURE " : "IMPURE ",
-                    this->nesegs[i].preload ? "PRELOAD " : "",
-                    this->nesegs[i].relocations ? "RELOCINFO " : "",
-                    this->nesegs[i].discardable ? "DISCARD " : ""
-                );
-                printf("  Offset      (file)   Length   (dec)     Mem \n");
-                /* While the underlying structures contain 16-bit values, 32-bit values are used in RAM to account for the case of a value of zero, equal to 0x10000. */
-                seg = this->nesegs[i].segmentOffset; 
-                segsz = (uint32_t) this->nesegs[i].segmentSize ? this->nesegs[i].segmentSize : 0x10000;
-                minalloc = (uint32_t) this->nesegs[i].minimumAllocation ? this->nesegs[i].minimumAllocation : 0x10000;
-                printf("  0x%04"PRIx32"  0x%08"PRIx32"   0x%04"PRIx32"   %5"PRIu32"  0x%04"PRIx32"\n\n", 
-                    seg, 
-                    seg << this->ne->offsetShiftCount, 
-                    segsz, 
-                    segsz,
-                    minalloc);
-            }
+    if (this->opts->format != FORMAT_TEXT) {
+        json_open(this->out, NULL, '{');
+        json_str(this->out, "file", this->fname);
+    }
+    for (i = 0; i < this->opts->fields->count; i++) {
+        f = this->opts->fields->fields[i];
+        switch (f->header) {
+            case FIELD_MZ:  have = this->mz != NULL; break;
+            case FIELD_NE:  have = this->ne != NULL; break;
+            case FIELD_LE:  have = this->le != NULL; break;
+            case FIELD_W3:  have = this->w3 || this->w4; break;
+            case FIELD_PE:  have = this->pe != NULL; break;
+            default:        have = 1; break;
         }
-    } else err(1, "Cannot allocate memory");
-}
-
-void read_ne_relocs(struct THIS *this) {
-    uint16_t segmentRelocationEntries, i, j;
-    off_t oldoffset = ftell(this->fd);
-    struct exe_ne_reloc *relocentry = malloc(sizeof(struct exe_ne_reloc));;
-    
-    if(!relocentry) err(1, "Cannot allocate memory");
-    for(i=0;i<this->ne->segmentCount;i++) {
-        fseek(this->fd, this->nesegs[i].segmentOffset << this->ne->offsetShiftCount, SEEK_SET);
-        printf("Relocation table for segment %d:\n", i);
-        fread(&segmentRelocationEntries, 2, 1, this->fd);
-        if (segmentRelocationEntries) {
-            for(j=0;j<segmentRelocationEntries;j++){
-                fread(relocentry, 1, sizeof(struct exe_ne_reloc), this->fd);
-                printf(" [%3d] ", j);
-                switch(relocentry->relocationType){
-                    case RELTYPE_INTREF:
-                        printf(" [%3d] ");
-                        break;
-                };    
-            }
-        } else 
-            printf("No relocations for segment.\n");
-        printf("\n");
+        if (have) f->emit(this, f->name);
+    }
+    if (this->stats) {
+        if (this->opts->format == FORMAT_TEXT) print_stats(this); else json_stats(this);
+    }
+    if (this->opts->format != FORMAT_TEXT) {
+        json_close(this->out, '}');
+        oprintf(this->out, "\n");
     }
-    fseek(this->fd, oldoffset, SEEK_SET);
-    free(relocentry);
 }
 
-char *get_ne_import_module_name(struct THIS *this, int module) {
-    int i = module * 2;
-    off_t oldoffset = ftell(this->fd), soff;
-    uint16_t loff;
-    uint8_t size;
-    char *name;
+/*
+ * --stats. Each phase's costs are as charged up to the point the report
+ * is written, so a file's own report leaves out the rest of the output
+ * and the unmapping; the totals at the end of a multi-file run have them.
+ */
+static const char *const stat_names[] = { "entered", "views", "bytes", "allocs", "syscalls", "ns" };
 
-    fseek(this->fd, (this->ne->modulesTableOffset + this->mzx->nextHeader + i), SEEK_SET);
-    if (fread(&loff, 1, sizeof(uint16_t), this->fd)!= sizeof(uint16_t)) {
-        if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-        if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-    } else {
-        soff = (this->ne->importedNamesTableOffset + this->mzx->nextHeader) + loff;
-        fseek(this->fd, soff, SEEK_SET);
-        size = fgetc(this->fd);
-        if (((int8_t) size != -1) && !ferror(this->fd)) {
-            if (name = malloc(size + 1)) { 
-                memset(name, 0, size + 1);
-                if (fread(name, 1, size, this->fd)!= size) {
-                    if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-                    if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-                } else {
-                    fseek(this->fd, oldoffset, SEEK_SET);
-                    return name;
-                }
-            } else err(1, "Cannot allocate memory");
-        } else warnx("Unexpected end of file: %s", this->fname);
+static uint64_t stat_value(const struct exe_phase_stats *s, int i) {
+    switch (i) {
+        case 0: return s->entered;
+        case 1: return s->views;
+        case 2: return s->bytes;
+        case 3: return s->allocs;
+        case 4: return s->syscalls;
+        default: return s->ns;
     }
-    /* we should never return NULL or even get here; either we have a valid malloc()'d string pointer or execution cannot continue.*/
-    fprintf(stderr, "Reached end of get_ne_import_module_name()!");
-    abort();
-    return NULL; 
 }
 
-void read_ne_modules_import(struct THIS *this) {
-    int i;
-    char *name;
+static int stat_used(const struct exe_phase_stats *s) {
+    return s->entered || s->views || s->allocs || s->syscalls || s->ns;
+}
 
-    printf(
-        "\n\n"
-        "Imported modules:\n"
-        "-----------------\n"
-    );
-    for(i=0;i<this->ne->modRefCount;i++) {
-        if(name = get_ne_import_module_name(this, i)) {
-            printf("  [%2d]: %s\n", i+1, name);
-            free(name);
-        } else errx(1, "Cannot read file: ", this->fname);
-    }
-}
-
-void read_ne_header(struct THIS *this) {
-    char *msg;
-
-    printf("New Executable with magic:\t%c%c\n", this->ne->magic[0], this->ne->magic[1]);
-    printf("Linker version:\t\t\t%"PRIu8".%"PRIu8"\n", this->ne->linkerMajor, this->ne->linkerMinor);
-    printf("Entry table offset:\t\t0x%04" PRIx16 " (File offset 0x%08" PRIx32 ")\n", this->ne->entryTableOffset, ((uint32_t) this->ne->entryTableOffset + this->mzx->nextHeader));
-    printf("Entry table size:\t\t0x%04"PRIx16" (%"PRIu16" bytes)\n", this->ne->entryTableSize, this->ne->entryTableSize);
-    printf("Header CRC:\t\t\t0x%08"PRIx32"\n", this->ne->fileCrc);
-    printf(".EXE Flags:\t\t\t0x%02"PRIx8"\n", this->ne->progFlags);
-    switch(this->ne->dataType) {
-        case DATA_NONE:
-            msg = "Not indicated";
-            break;
-        case DATA_SINGLEDATA:
-            msg = "SINGLEDATA";
-            break;
-        case DATA_MULTIPLEDATA:
-            msg = "MULTIPLEDATA";
-            break;
-        case DATA_AUTODATA:
-            msg = "AUTODATA";
-            break;
-    }
-    printf(" - Data Segment Model:\t\t%s\n", msg);
-    printf(" - Global initialization:\t%s\n", this->ne->globalInit ? "true" : "false");
-    printf(" - Protected Mode only:\t\t%s\n", this->ne->pmModeOnly ? "true" : "false");
-    printf(" - 8086 opcodes used:\t\t%s\n", this->ne->ops8086 ? "true" : "false");
-    printf(" - 80286 opcodes used:\t\t%s\n", this->ne->ops80286 ? "true" : "false");
-    printf(" - 80386 opcodes used:\t\t%s\n", this->ne->ops80386 ? "true" : "false");
-    printf(" - FPU/80x87 opcodes used:\t%s\n", this->ne->ops80x87 ? "true" : "false");
-    printf("Application flags:\t\t0x%02"PRIx8"\n", this->ne->appFlags);
-    switch(this->ne->appType) {
-        case APP_NONE:
-            msg = "Not indicated";
-            break;
-        case APP_FULLSCREEN:
-            msg = "OS/2 Fullscreen CUI application";
-            break;
-        case APP_COMPATIBLE:
-            msg = "OS/2 Presentation Manager compatible CUI application";
-            break;
-        case APP_WINPM:
-            msg = "Windows or Presentation Manager GUI application";
-            break;
-    }
-    printf(" - Application type:\t\t%s\n", msg);
-    printf(" - OS/2 Family executable:\t%s\n", this->ne->os2FamExec ? "true" : "false");
-    printf(" - Is executable:\t\t%s\n", this->ne->executable ? "true" : "false");
-    printf(" - Generated with link errors:\t%s\n", this->ne->linkErrors ? "true" : "false");
-    printf(" - Is library (DLL or driver):\t%s\n", this->ne->libraryBit ? "true" : "false");
-    printf("AUTODATA segment address:\t0x%04"PRIx16"\n", this->ne->autoDataSegAddr);
-    printf("Initial heap size:\t\t0x%04"PRIx16"\n", this->ne->initHeapSize);
-    printf("Initial stack size:\t\t0x%04"PRIx16"\n", this->ne->initStackSize);
-    printf("Initial CS:IP (entrypoint):\t%04"PRIx16":%04"PRIx16"\n", (this->ne->entryPoint >> 16), (this->ne->entryPoint & 0xFFFF));
-    printf("Initial SS:SP (stack):\t\t%04"PRIx16":%04"PRIx16"\n", (this->ne->initStackPtr >> 16), (this->ne->initStackPtr & 0xFFFF));
-    printf("Segment count:\t\t\t0x%04"PRIx16" (%"PRIu16")\n", this->ne->segmentCount, this->ne->segmentCount);
-    printf("Module reference count:\t\t%04"PRIx16" (%"PRIu16")\n", this->ne->modRefCount, this->ne->modRefCount);
-    printf("Non-resident name table size:\t0x%04"PRIx16" (%"PRIu16" bytes)\n", this->ne->nonResidentTableSize, this->ne->nonResidentTableSize);
-    printf("Offset of segment table:\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->segmentTableOffset, (this->ne->segmentTableOffset + this->mzx->nextHeader));
-    printf("Offset of resource table:\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->resourceTableOffset, (this->ne->resourceTableOffset + this->mzx->nextHeader));
-    printf("Offset of resident name table:\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->residentNamesTableOffset, (this->ne->residentNamesTableOffset + this->mzx->nextHeader));
-    printf("Offset of module table:\t\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->modulesTableOffset, (this->ne->modulesTableOffset + this->mzx->nextHeader));
-    printf("Offset of imported names table:\t0x%04"PRIx16" (File offset 0x%08"PRIx32")\n", this->ne->importedNamesTableOffset, (this->ne->importedNamesTableOffset + this->mzx->nextHeader));
-    printf("Non-resident names table:\t0x%08"PRIx32" (File offset)\n", this->ne->nonResidentTableOffset);
-    printf("Movable entry points:\t\t0x%08"PRIx32" (%"PRIu32")\n", this->ne->movableEntryPoints, this->ne->movableEntryPoints);
-    printf("Offset shift count:\t\t0x%04"PRIx16" (%"PRIu16")\n", this->ne->offsetShiftCount, this->ne->offsetShiftCount);
-    printf("Resource table size:\t\t0x%04"PRIx16" (%"PRIu16")\n", this->ne->offsetShiftCount, this->ne->offsetShiftCount);
-    switch(this->ne->targetOS) {
-        case OS_UNKNOWN:
-            msg = "Unknown";
-            break;
-        case OS_OS2:
-            msg = "OS/2";
-            break;
-        case OS_WINDOWS:
-            msg = "Windows";
-            break;
-        case OS_MSDOS:
-            msg = "MT MS-DOS 4.0";
-            break;
-        case OS_WIN386:
-            msg = "Windows/386";
-            break;
-        case OS_BOSS:
-            msg = "Borland Operating System Services or HX Extender DPMI-16";
-            break;
-        case OS_HX:
-            msg = "HX Extender DPMI-32";
-            break;
-        case OS_PHARLAP286OS2:
-            msg = "Phar Lap 286|DOS-Extender (OS/2)";
-            break;
-        case OS_PHARLAP286WIN:
-            msg = "Phar Lap 286|DOS-Extender (Windows)";
-            break;
-    }
-    printf("Target operating system:\t%s (0x%02"PRIx8")\n", msg, this->ne->targetOS);
-    printf("Executable flags:\t\t%s%s%s%s\n", 
-        this->ne->os2LFN ? "LONGFILENAME " : "",
-        this->ne->os2PMode ? "PROTECTEDMODE " : "",
-        this->ne->os2Fonts ? "PROPORTIONALFONTS " : "",
-        this->ne->fastLoad ? "GANGLOADAREA " : ""); 
-    if(this->ne->fastLoad) { 
-        printf("GangLoad/FastLoad area offset:\t0x%04"PRIx16"\n", this->ne->returnThunksOffset);
-        printf("GangLoad/FastLoad area size:\t0x%04"PRIx16"\n", this->ne->segmentReferenceOffset);        
+static void stats_add(struct exe_stats *to, const struct exe_stats *from) {
+    int p;
+
+    for (p = 0; p < EXE_PHASE_COUNT; p++) {
+        to->phase[p].entered += from->phase[p].entered;
+        to->phase[p].views += from->phase[p].views;
+        to->phase[p].bytes += from->phase[p].bytes;
+        to->phase[p].allocs += from->phase[p].allocs;
+        to->phase[p].syscalls += from->phase[p].syscalls;
+        to->phase[p].ns += from->phase[p].ns;
+    }
+}
+
+static void stats_table(struct outbuf *out, const char *title, const struct exe_stats *st) {
+    struct exe_phase_stats total;
+    const struct exe_phase_stats *s;
+    int p;
+
+    memset(&total, 0, sizeof(total));
+    oprintf(out, "%s\n", title);
+    oprintf(out, "  %-12s %10s %10s %14s %8s %9s %12s\n", "Phase", "Entered", "Views", "Bytes", "Allocs", "Syscalls", "Time (us)");
+    for (p = 0; p <= EXE_PHASE_COUNT; p++) {
+        if (p < EXE_PHASE_COUNT) {
+            s = &st->phase[p];
+            if (!stat_used(s)) continue;
+            total.entered += s->entered;
+            total.views += s->views;
+            total.bytes += s->bytes;
+            total.allocs += s->allocs;
+            total.syscalls += s->syscalls;
+            total.ns += s->ns;
+        } else s = &total;
+        oprintf(out, "  %-12s %10lu %10lu %14"PRIu64" %8lu %9lu %12.1f\n", p < EXE_PHASE_COUNT ? exe_phase_names[p] : "total",
+            s->entered, s->views, s->bytes, s->allocs, s->syscalls, s->ns / 1000.0);
     }
-    printf("Windows version:\t\t%"PRIu8".%"PRIu8" (0x%04"PRIx16")\n", this->ne->windowsVersionMajor, this->ne->windowsVersionMinor, this->ne->windowsVersion);
 }
 
-void read_le_header(struct THIS *this) {
-    char *msg = "";
+void print_stats(struct THIS *this) {
+    const struct exe_phase_stats *s;
+    int p, i;
+
+    exe_phase(this, this->phase);
+    if (!this->opts->fields) {
+        oprintf(this->out, "\n");
+        stats_table(this->out, "Parser statistics:", this->stats);
+        return;
+    }
+    for (p = 0; p < EXE_PHASE_COUNT; p++) {
+        s = &this->stats->phase[p];
+        if (!stat_used(s)) continue;
+        for (i = 0; i < (int) (sizeof(stat_names) / sizeof(stat_names[0])); i++)
+            oprintf(this->out, "%s\tstats.%s.%s\t%"PRIu64"\n", this->fname, exe_phase_names[p], stat_names[i], stat_value(s, i));
+    }
 }
 
-void read_le_exe(struct THIS *this) {
-    if ((this->le = (struct exe_le_header *) malloc(sizeof(struct exe_le_header)))) { 
-        fseek(this->fd, this->mzx->nextHeader, SEEK_SET);
-        if (fread(this->le, 1, sizeof(struct exe_le_header), this->fd)!= sizeof(struct exe_le_header)) {
-            if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-            if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-        } else
-            printf("Linear Executable format is a WIP. No output code yet.\n");
-    } else err(1, "Cannot allocate memory");
-    return;
+void json_stats(struct THIS *this) {
+    const struct exe_phase_stats *s;
+    int p, i;
+
+    exe_phase(this, this->phase);
+    json_open(this->out, "stats", '{');
+    for (p = 0; p < EXE_PHASE_COUNT; p++) {
+        s = &this->stats->phase[p];
+        if (!stat_used(s)) continue;
+        json_open(this->out, exe_phase_names[p], '{');
+        for (i = 0; i < (int) (sizeof(stat_names) / sizeof(stat_names[0])); i++)
+            json_uint(this->out, stat_names[i], stat_value(s, i));
+        json_close(this->out, '}');
+    }
+    json_close(this->out, '}');
 }
 
-void read_w3_exe(struct THIS *this) {
-    struct exe_w3_modentry mod;
-    
-    if ((this->w3 = (struct exe_w3_header *) malloc(sizeof(struct exe_w3_header)))) { 
-        fseek(this->fd, this->mzx->nextHeader, SEEK_SET);
-        if (fread(this->w3, 1, sizeof(struct exe_w3_header), this->fd)!= sizeof(struct exe_w3_header)) {
-            if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-            if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-        } else {
-            printf("VMM version: %"PRIu8".%"PRIu8" (0x%04"PRIx16")\n", this->w3->vmm_major, this->w3->vmm_minor, this->w3->vmm_version);
-            printf(
-                "VxD Module Table:\n"
-                "   ID   Name          Offset      Size       (dec)\n"
-                "------------------------------------------------------\n"
-            );
-            this->wx_modcount = this->w3->modcount;
-            for(int i=0; i<this->wx_modcount; i++)  
-                if (fread(&mod, 1, sizeof(struct exe_w3_modentry), this->fd)!= sizeof(struct exe_w3_modentry)) {
-                    if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-                    if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-                } else 
-                    printf("  [%02x] \"%s\"     0x%08"PRIx32"  0x%08"PRIx32" (%"PRIu32" bytes)\n", i, mod.name, mod.offset, mod.size, mod.size);
+/* Maps this->fname, or reads standard input forward only if that is "-". */
+static int open_exe(struct THIS *this) {
+    return strcmp(this->fname, "-") ? map_file(this) : map_stream(this, stdin);
+}
+
+/*
+ * Prints everything we know about one file into out. Returns the kind of
+ * executable, or -1 if it cannot be opened. With --stats, what the file
+ * cost is added to total if that is not NULL. With --cache, an unchanged
+ * file's report comes from the cache, and a new report is stored there
+ * unless the file had problems worth warning about again next time.
+ */
+int scan_file(const char *fname, const struct options *opts, struct outbuf *out, struct exe_stats *total, int worker) {
+    const struct exe_diag *d;
+    struct exe_stats stats;
+    struct cache_probe probe;
+    struct THIS *this;
+    const char *report;
+    size_t start = out->len, len;
+    int kind, cache = opts->cache && strcmp(fname, "-");
+
+    if (cache && (report = cache_lookup(opts->cache, worker, fname, &probe, &len, &kind))) {
+        oprintf(out, "%.*s", (int) len, report);
+        return kind;
+    }
+    if (!(this = init_this())) err(1, "Cannot allocate memory");
+    this->fname = fname;
+    this->opts = opts;
+    this->out = out;
+    this->noffset = opts->noffset;
+    this->need = opts->need;
+    if (opts->stats) {
+        memset(&stats, 0, sizeof(stats));
+        this->stats = &stats;
+        exe_phase(this, EXE_PHASE_OTHER);
+    }
+    if (open_exe(this)) {
+        warn("Cannot open %s", this->fname);
+        destroy_this(this);
+        return -1;
+    }
+    read_exe(this);
+    exe_phase(this, EXE_PHASE_OUTPUT);
+    if (opts->fields)
+        print_fields(this);
+    else if (opts->format == FORMAT_TEXT) {
+        print_text(this);
+        if (opts->stats) print_stats(this);
+    } else
+        print_json(this);
+    exe_phase(this, EXE_PHASE_OTHER);
+    /* Tables loaded while printing may have added to these. */
+    for (d = this->diags; d; d = d->next)
+        warnx("%s", d->msg);
+    kind = this->kind;
+    if (cache && !this->diags) cache_store(opts->cache, worker, fname, &probe, this->base, this->size, out->buf + start, out->len - start, kind);
+    destroy_this(this);
+    if (opts->stats && total) stats_add(total, &stats);
+    return kind;
+}
+
+/*
+ * --extract-resource: writes the data of the NE resources matching spec,
+ * TYPE or TYPE:NAME, to standard output straight from the file image.
+ * Returns the exit status.
+ */
+static int extract_resource(const char *fname, const struct options *opts, const char *spec) {
+    const struct exe_diag *d;
+    const struct ne_resource *res = NULL;
+    struct ne_reskey type, name;
+    struct THIS *this;
+    const char *sep = strchr(spec, ':');
+    const void *p;
+    int count = 0, i, ret = 0;
+
+    if (ne_resource_key(spec, sep ? (size_t) (sep - spec) : strlen(spec), &type) || (sep && ne_resource_key(sep + 1, strlen(sep + 1), &name)))
+        errx(1, "Invalid resource: %s", spec);
+    if (!(this = init_this())) err(1, "Cannot allocate memory");
+    this->fname = fname;
+    this->noffset = opts->noffset;
+    this->need = NEED_NEXT | NEED_NE_RESOURCES | NEED_FILE;
+    if (open_exe(this)) {
+        warn("Cannot open %s", fname);
+        destroy_this(this);
+        return 1;
+    }
+    read_exe(this);
+    if (!this->ne) {
+        warnx("Not an NE executable: %s", fname);
+        ret = 1;
+    } else if (!(res = ne_find_resources(this, &type, sep ? &name : NULL, &count))) {
+        warnx("No %s resource in %s", spec, fname);
+        ret = 1;
+    }
+#ifdef NEED_SETMODE
+    setmode(fileno(stdout), O_BINARY);
+#endif
+    for (i = 0; i < count && !ret; i++) {
+        if (!(p = ne_resource_data(this, &res[i]))) ret = 1;
+        else if (fwrite(p, 1, res[i].size, stdout) != res[i].size) {
+            warn("Cannot write resource");
+            ret = 1;
         }
-    } else err(1, "Cannot allocate memory");
-    return; 
+    }
+    for (d = this->diags; d; d = d->next)
+        warnx("%s", d->msg);
+    destroy_this(this);
+    return ret;
 }
 
-void read_next_header(struct THIS *this) {
-    char next_magic[2];
+/*
+ * --load-image: writes the DOS load module relocated to segment seg to
+ * standard output, or with --hash prints its hashes instead. Returns the
+ * exit status.
+ */
+static int load_image(const char *fname, const struct options *opts, uint16_t seg) {
+    const struct exe_diag *d;
+    struct outbuf out = { 0 };
+    struct THIS *this;
+    const uint8_t *img = NULL;
+    uint32_t size;
+    int ret = 0;
 
-    if(fseek(this->fd, this->mzx->nextHeader, SEEK_SET)) {
-        if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-        if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
+    if (!(this = init_this())) err(1, "Cannot allocate memory");
+    this->fname = fname;
+    this->opts = opts;
+    this->out = &out;
+    this->need = NEED_MZ_RELOCS | NEED_FILE;
+    if (open_exe(this)) {
+        warn("Cannot open %s", fname);
+        destroy_this(this);
+        return 1;
+    }
+    read_exe(this);
+    if (!this->mz) {
+        warnx("Not a DOS/MZ executable: %s", fname);
+        ret = 1;
+    } else if (!(img = mz_load_image(this, seg, &size))) {
+        warnx("No load module in %s", fname);
+        ret = 1;
+    } else if (opts->hash) {
+        oprintf(&out, "%s: load module at %04"PRIx16"\n", fname, seg);
+        print_hash(this, mz_image_hash, seg);
+        out_flush(&out, stdout);
     } else {
-        if (fread(&next_magic, 1, sizeof(next_magic), this->fd) != sizeof(next_magic)) {
-            if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-            if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-        } else {
-            if (((next_magic[0] == 'N') && (next_magic[1] == 'E'))) {
-                printf("\n\n");
-                printf("New Executable header found at offset 0x%08"PRIx32"\n", this->mzx->nextHeader);
-                read_ne_exe(this);
-            } else if (((next_magic[0] == 'P') && (next_magic[1] == 'E'))) {
-                printf("\n\n");
-                printf("Portable Executable header found at offset 0x%08"PRIx32"\n", this->mzx->nextHeader);
-                // read_pe_exe(this);
-            } else if (((next_magic[0] == 'L') && (next_magic[1] == 'E')) ||
-                       ((next_magic[0] == 'L') && (next_magic[1] == 'X'))) {
-                printf("\n\n");
-                printf("Linear Executable header found at offset 0x%08"PRIx32"\n", this->mzx->nextHeader);
-                read_le_exe(this);
-            } else if ((next_magic[0] == 'W') && (next_magic[1] == '3')) {
-                printf("\n\n");
-                printf("W3 Executable header found at offset 0x%08"PRIx32"\n", this->mzx->nextHeader);
-                read_w3_exe(this);                           
-            } else {
-                printf("\n\n");
-                printf("Unknown next header type: %c%c/0x%04"PRIx16"\n", next_magic[0], next_magic[1], *((uint16_t *) &next_magic));
-            }
+#ifdef NEED_SETMODE
+        setmode(fileno(stdout), O_BINARY);
+#endif
+        if (fwrite(img, 1, size, stdout) != size) {
+            warn("Cannot write load module");
+            ret = 1;
         }
     }
+    for (d = this->diags; d; d = d->next)
+        warnx("%s", d->msg);
+    destroy_this(this);
+    free(out.buf);
+    return ret;
 }
 
-struct THIS *init_this(void) {
-    struct THIS *this;
+/* Everything besides the files themselves that a cached report depends on. */
+static uint64_t cache_optkey(const struct options *opts) {
+    uint64_t h = cache_hash(0, VERSION, strlen(VERSION));
+    int i;
 
-    if (!(this = malloc(sizeof(struct THIS)))) err(1, "Cannot allocate memory");
-    memset(this, 0, sizeof(struct THIS));
-    return this;
+    h = cache_hash(h, &opts->noffset, sizeof(opts->noffset));
+    h = cache_hash(h, &opts->summary, sizeof(opts->summary));
+    h = cache_hash(h, &opts->format, sizeof(opts->format));
+    h = cache_hash(h, &opts->hash, sizeof(opts->hash));
+    h = cache_hash(h, &opts->verify, sizeof(opts->verify));
+    for (i = 0; opts->fields && i < opts->fields->count; i++)
+        h = cache_hash(h, opts->fields->fields[i]->name, strlen(opts->fields->fields[i]->name) + 1);
+    return h;
 }
 
-void destroy_this(struct THIS *this) {
-    if (this->w3) free(this->w3);
-        if (this->le) free(this->le);
-    if (this->nemods) free(this->nemods);
-    if (this->nesegs) free(this->nesegs);
-    if (this->ne) free(this->ne);
-    if (this->mzx) free(this->mzx);
-    if (this->mz) free(this->mz);
-    if (this->fd) if ((fclose(this->fd))) err(1, "Cannot close %s", this->fname);
-    free(this);
+/* The list of files to scan, after expanding directories given with -r. */
+struct filelist {
+    char **names;
+    int count;
+    int cap;
+};
+
+static void filelist_add(struct filelist *list, const char *name) {
+    if (list->count == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 64;
+        if (!(list->names = realloc(list->names, sizeof(char *) * list->cap))) err(1, "Cannot allocate memory");
+    }
+    if (!(list->names[list->count] = malloc(strlen(name) + 1))) err(1, "Cannot allocate memory");
+    strcpy(list->names[list->count++], name);
 }
 
-void read_mz_reloc(struct THIS *this) {
-    struct exe_mz_reloc reloc;
-    off_t oldoffset = ftell(this->fd);
+static void filelist_walk(struct filelist *list, const char *path, int recursive) {
+#ifdef USE_DIRENT
+    struct stat st;
+    struct dirent *de;
+    DIR *dir;
+    char *child;
+    size_t len;
 
-    printf("MZ EXE relocaton table\n"
-           "Number of relocations: %d\n", this->mz->relocationEntries);
-    fseek(this->fd, this->mz->relocationOffset, SEEK_SET);
-    for(int i=0; i<this->mz->relocationEntries; i++)
-        if (fread(&reloc, 1, sizeof(struct exe_mz_reloc), this->fd)!= sizeof(struct exe_mz_reloc)) {
-            if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-            if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-        } else
-            printf("  [%d] %04x:%04x\n", i, reloc.segment, reloc.offset);
-    fseek(this->fd, oldoffset, SEEK_SET);
-    return;
-}
-
-void display_help(struct THIS *this) { 
+    /* Don't follow symlinks to directories; archives love making loops out of those. */
+    if (recursive && !lstat(path, &st) && S_ISDIR(st.st_mode)) {
+        if (!(dir = opendir(path))) {
+            warn("Cannot open %s", path);
+            return;
+        }
+        len = strlen(path);
+        while ((de = readdir(dir))) {
+            if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) continue;
+            if (!(child = malloc(len + strlen(de->d_name) + 2))) err(1, "Cannot allocate memory");
+            sprintf(child, "%s%s%s", path, (len && path[len - 1] == '/') ? "" : "/", de->d_name);
+            if (!lstat(child, &st) && S_ISDIR(st.st_mode))
+                filelist_walk(list, child, recursive);
+            else if (!stat(child, &st) && S_ISREG(st.st_mode))
+                filelist_add(list, child);
+            free(child);
+        }
+        closedir(dir);
+        return;
+    }
+#else
+    (void) recursive;
+#endif
+    filelist_add(list, path);
+}
+
+/* Per-thread state for a multi-file scan. */
+struct scan_worker {
+    struct outbuf out;
+    unsigned long counts[EXE_KIND_COUNT];
+    unsigned long failed;
+    struct exe_stats stats;                 /* --stats totals for this worker's files */
+};
+
+struct scan {
+    const struct options *opts;
+    struct filelist *files;
+    struct scan_worker *workers;
+};
+
+static void scan_one(void *ctx, int index, int worker) {
+    struct scan *scan = ctx;
+    struct scan_worker *w = &scan->workers[worker];
+    int kind;
+
+    kind = scan_file(scan->files->names[index], scan->opts, &w->out, &w->stats, worker);
+    if (kind < 0) w->failed++; else w->counts[kind]++;
+    if (scan->opts->format == FORMAT_TEXT && !scan->opts->fields) oprintf(&w->out, "\n");
+    out_flush(&w->out, stdout);
+}
+
+static double now(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_MONOTONIC, &ts)) return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+    return (double) time(NULL);
+}
+
+/*
+ * --unpack: writes the program an EXEPACK or LZEXE packed file holds, as
+ * the EXE it was before packing, to standard output. Returns the exit
+ * status.
+ */
+static int unpack(const char *fname, const struct options *opts) {
+    const struct exe_diag *d;
+    struct outbuf out = { 0 };
+    struct THIS *this;
+    const uint8_t *exe;
+    uint32_t size;
+    int ret = 0, packer;
+
+    if (!(this = init_this())) err(1, "Cannot allocate memory");
+    this->fname = fname;
+    this->opts = opts;
+    this->out = &out;
+    this->need = NEED_MZ_PACKER | NEED_FILE;
+    if (open_exe(this)) {
+        warn("Cannot open %s", fname);
+        destroy_this(this);
+        return 1;
+    }
+    read_exe(this);
+    if (!this->mz) {
+        warnx("Not a DOS/MZ executable: %s", fname);
+        ret = 1;
+    } else if (!(packer = mz_packer(this, NULL))) {
+        warnx("Not packed with EXEPACK, LZEXE or PKLITE: %s", fname);
+        ret = 1;
+    } else if (packer == MZ_PACKER_PKLITE) {
+        warnx("Cannot unpack %s files: %s", mz_packer_names[packer], fname);
+        ret = 1;
+    } else if (!(exe = mz_unpack(this, &size))) {
+        ret = 1;
+    } else {
+#ifdef NEED_SETMODE
+        setmode(fileno(stdout), O_BINARY);
+#endif
+        if (fwrite(exe, 1, size, stdout) != size) {
+            warn("Cannot write unpacked file");
+            ret = 1;
+        }
+    }
+    for (d = this->diags; d; d = d->next)
+        warnx("%s", d->msg);
+    destroy_this(this);
+    free(out.buf);
+    return ret;
+}
+
+void display_help(void) { 
     printf(
         "readexe: Displays information on various Microsoft EXE formats.\n"
         "Version "VERSION"\n\n"
-        "  Usage: readexe [-h] [-n offset] EXEFILE.EXE\n\n"
+        "  Usage: readexe [-h] [-r] [-s] [-j jobs] [-n offset] [--format=fmt] [--fields=list] [--stats] [--hash[=alg]] [--verify] [--cache=file]\n"
+        "                 [--extract-resource=type[:name]] [--load-image=seg] [--unpack] [--graph[=fmt]] EXEFILE.EXE...\n\n"
+        "  A file named - is read from standard input, forward only and only as far\n"
+        "  as the tables of an NE or LE/LX file go, so it can come from a pipe.\n\n"
         "  -n\tManually specify offset to next header.\n"
             "\toffset is read as decimal unless prefixed 0x/0X.\n"
-        "  -h\tDisplay this help.\n\n"
+        "  -r\tScan directories recursively.\n"
+        "  -s\tSummarise relocation tables instead of listing every entry.\n"
+        "  -j\tNumber of worker threads for multi-file scans (default: one per core).\n"
+        "  -h\tDisplay this help.\n"
+        "  --format=text|json|ndjson\n"
+            "\tOutput format. json writes an indented object per file, ndjson\n"
+            "\twrites each file's object on a single line.\n"
+        "  --fields=field,...\n"
+            "\tPrint only the named fields, e.g. ne.targetOS,ne.imports,mz.entry,\n"
+            "\tand skip reading tables none of them need. Text output is one\n"
+            "\tfile<TAB>field<TAB>value line per value.\n"
+        "  --stats\n"
+            "\tReport the time, file views, bytes, allocations and system calls\n"
+            "\tspent in each parser phase, per file and over the whole run.\n"
+        "  --hash[=xxh64|sha256|all]\n"
+            "\tShow a hash of each NE segment, LE object and W3 module, over its\n"
+            "\tdata as stored in the file (default xxh64). NE segments are also\n"
+            "\tloaded, relocations applied with values that do not depend on\n"
+            "\twhere they would be loaded, and hashed again; LE and LX objects\n"
+            "\tare hashed again with their iterated and compressed pages expanded.\n"
+        "  --verify\n"
+            "\tCheck the DOS header checksum, the NE file CRC and LE/LX per-page\n"
+            "\tchecksums, and report each as valid, invalid or absent.\n"
+        "  --extract-resource=type[:name]\n"
+            "\tWrite the data of an NE file's resources of that type (and name)\n"
+            "\tto standard output, e.g. RT_VERSION or RT_STRING:7. Types and\n"
+            "\tnames are numbers, names or the RT_ names of standard types.\n"
+        "  --load-image=seg\n"
+            "\tWrite the DOS load module to standard output as DOS would load it\n"
+            "\tat segment seg, every relocation applied. With --hash, print its\n"
+            "\thashes instead. seg is decimal unless prefixed 0x/0X.\n"
+        "  --unpack\n"
+            "\tWrite the program in a file packed with EXEPACK or LZEXE 0.90 or\n"
+            "\t0.91 to standard output, as the EXE it was before packing. Reports\n"
+            "\tname the packer, PKLITE included, but PKLITE files are not unpacked.\n"
+        "  --graph[=dot|edges]\n"
+            "\tInstead of reports, resolve the imports of every file against the\n"
+            "\texports of the others and write the dependency graph, with the\n"
+            "\timports nothing provides: a Graphviz digraph (the default), or\n"
+            "\t\"edge\" and \"unresolved\" lines of tab-separated fields.\n"
+        "  --cache=file\n"
+            "\tKeep reports in file and reuse them for files whose device, inode,\n"
+            "\tsize and modification time have not changed. A cache holds reports\n"
+            "\tmade with one set of options; use one cache per set.\n\n"
+        "With more than one file, or with -r, a summary is printed at the end\n"
+        "(on standard error with json and ndjson).\n\n"
         "Report bugs at https://github.com/segin/readexe\n"
     );
-    destroy_this(this);
     exit(0);
 }
 
 int main(int argc, char *argv[]) {
-    const uint32_t mz_page_size = 512;
-    const uint32_t mz_paragraph_size = 16;
-    struct THIS *this;
-    uint32_t memuse;
-    int option;
+    static const struct option longopts[] = {
+        { "format", required_argument, NULL, 'F' },
+        { "fields", required_argument, NULL, 'f' },
+        { "stats", no_argument, NULL, 'S' },
+        { "cache", required_argument, NULL, 'C' },
+        { "hash", optional_argument, NULL, 'H' },
+        { "verify", no_argument, NULL, 'V' },
+        { "extract-resource", required_argument, NULL, 'X' },
+        { "load-image", required_argument, NULL, 'L' },
+        { "unpack", no_argument, NULL, 'U' },
+        { "graph", optional_argument, NULL, 'G' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    struct options opts = { -1, 0, 0, 0, FORMAT_TEXT, NULL, NEED_ALL, 0, NULL, 0, 0 };
+    struct field_plan *plan = NULL;
+    struct filelist files = { NULL, 0, 0 };
+    struct scan scan;
+    struct outbuf out = { 0 };
+    unsigned long counts[EXE_KIND_COUNT] = { 0 }, failed = 0;
+    unsigned long hits, stored;
+    struct exe_stats stats;
+    double start, elapsed;
+    FILE *summary;
+    struct graph_counts gc;
+    int option, i, k, nthreads, graph = -1, unpacking = 0;
+    long loadseg = -1;
     char *endptr;
-    long int noffset = -1;
+    const char *cachefile = NULL, *extract = NULL;
 
 #ifdef NEED_ERR
     setprogname(argv[0]);
 #endif
-    this = init_this();
     if (argc < 2) { 
         warnx("Not enough arguments.");
-        display_help(this);
+        display_help();
     }
-    while((option = getopt(argc, argv, "hn:")) != -1) {
+    while((option = getopt_long(argc, argv, "hn:rj:s", longopts, NULL)) != -1) {
         switch(option) {
             case 'h':
             case '?':
-                display_help(this);
+                display_help();
                 break;
             case 'n':
-                noffset = strtoul(optarg, &endptr, 0);
-                if (*endptr != '\0' || (noffset == ULONG_MAX && errno == ERANGE)) err(1, "Invalid value: %s\n", optarg);
+                opts.noffset = strtoul(optarg, &endptr, 0);
+                if (*endptr != '\0' || ((unsigned long) opts.noffset == ULONG_MAX && errno == ERANGE)) err(1, "Invalid value: %s\n", optarg);
+                break;
+            case 'r':
+                opts.recursive = 1;
+                break;
+            case 's':
+                opts.summary = 1;
+                break;
+            case 'j':
+                opts.jobs = strtoul(optarg, &endptr, 0);
+                if (*endptr != '\0' || opts.jobs < 0) errx(1, "Invalid value: %s", optarg);
+                break;
+            case 'F':
+                if (!strcmp(optarg, "text")) opts.format = FORMAT_TEXT;
+                else if (!strcmp(optarg, "json")) opts.format = FORMAT_JSON;
+                else if (!strcmp(optarg, "ndjson")) opts.format = FORMAT_NDJSON;
+                else errx(1, "Unknown format: %s", optarg);
+                break;
+            case 'f':
+                free_fields(plan);
+                plan = compile_fields(optarg);
+                opts.fields = plan;
+                opts.need = plan->need;
+                break;
+            case 'S':
+                opts.stats = 1;
+                break;
+            case 'C':
+                cachefile = optarg;
+                break;
+            case 'H':
+                if (!optarg || !strcmp(optarg, "xxh64")) opts.hash = HASH_XXH64;
+                else if (!strcmp(optarg, "sha256")) opts.hash = HASH_SHA256;
+                else if (!strcmp(optarg, "all")) opts.hash = HASH_XXH64 | HASH_SHA256;
+                else errx(1, "Unknown hash: %s", optarg);
+                break;
+            case 'V':
+                opts.verify = 1;
+                break;
+            case 'X':
+                extract = optarg;
+                break;
+            case 'L':
+                loadseg = strtol(optarg, &endptr, 0);
+                if (*endptr != '\0' || loadseg < 0 || loadseg > 0xFFFF) errx(1, "Invalid segment: %s", optarg);
+                break;
+            case 'U':
+                unpacking = 1;
+                break;
+            case 'G':
+                if (!optarg || !strcmp(optarg, "dot")) graph = GRAPH_DOT;
+                else if (!strcmp(optarg, "edges")) graph = GRAPH_EDGES;
+                else errx(1, "Unknown graph format: %s", optarg);
                 break;
             default:
                 abort();
         }
     }
-    if(optind < argc) this->fname = argv[optind]; else display_help(this);
-    if (!(this->fd = fopen(this->fname, "rb"))) err(1, "Cannot open %s", this->fname);
-    if (noffset != -1) { 
-        if (!(this->mzx = malloc(sizeof(struct exe_mz_new_header)))) err(1, "Cannot allocate memory");
-        this->mzx->nextHeader = noffset;
-        read_next_header(this);
-    }
-    if (!(this->mz = malloc(sizeof(struct exe_mz_header)))) err(1, "Cannot allocate memory");
-    if (fread(this->mz, 1, sizeof(struct exe_mz_header), this->fd) != sizeof(struct exe_mz_header)) {
-        if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-        if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-    } else {
-        if (    ((this->mz->magic[0] == 'M') && (this->mz->magic[1] == 'Z')) 
-            ||  ((this->mz->magic[1] == 'M') && (this->mz->magic[0] == 'Z')) ) {
-            printf("%s:\n", argv[1]);
-            printf("DOS executable with magic:\t%c%c (0x%"PRIx8"%"PRIx8")\n", this->mz->magic[0], this->mz->magic[1], this->mz->magic[1], this->mz->magic[0]);
-            printf("Number of executable pages:\t0x%04"PRIx16" (%"PRIu32"+ bytes)\n", this->mz->pageCount, ((this->mz->pageCount - 1) * mz_page_size));
-            printf("Size of final page:\t\t0x%08"PRIx16" (%"PRIu16" bytes)\n", this->mz->lastPageSize, this->mz->lastPageSize);
-            memuse = (((this->mz->pageCount - 1) * mz_page_size) + this->mz->lastPageSize);
-            printf("Total code size:\t\t0x%08"PRIx32" (%"PRIu32" bytes)\n", memuse, memuse);
-            printf("Total relocation entries:\t0x%04"PRIx16"\n", this->mz->relocationEntries);
-            printf("Header size in paragraphs:\t0x%04"PRIx16" (%"PRIu32" bytes)\n", this->mz->hdrSize, (this->mz->hdrSize * mz_paragraph_size));
-            printf("Minimum heap in paragraphs:\t0x%04"PRIx16" (%"PRIu32" bytes)\n", this->mz->minMemory, (this->mz->minMemory * mz_paragraph_size));
-            printf("Maximum heap in paragraphs:\t0x%04"PRIx16" (%"PRIu32" bytes)\n", this->mz->maxMemory, (this->mz->maxMemory * mz_paragraph_size));
-            memuse += (this->mz->minMemory * mz_paragraph_size);
-            printf("Minimum memory to load:\t\t%"PRIu32" bytes\n", memuse);
-            printf("Initial CS:IP (entrypoint):\t%04"PRIx16":%04"PRIx16"\n", this->mz->initCodeSeg, this->mz->initInstPtr);
-            printf("Initial SS:SP (stack):\t\t%04"PRIx16":%04"PRIx16"\n", this->mz->stackSegment, this->mz->stackPointer);
-            printf("Checksum:\t\t\t0x%04"PRIx16"\n", this->mz->checksum);
-            printf("Relocation table offset:\t0x%04"PRIx16"\n", this->mz->relocationOffset);
-            printf("Overlay:\t\t\t0x%04"PRIx16"\n\n", this->mz->overlayNumber);
-            if (this->mz->relocationEntries) read_mz_reloc(this);
-            /* check for next header */
-            if(this->mz->relocationOffset >= 0x40) {
-                if (!(this->mzx = malloc(sizeof(struct exe_mz_new_header)))) err(1, "Cannot allocate memory");
-                if (fread(this->mzx, 1, sizeof(struct exe_mz_new_header), this->fd) != sizeof(struct exe_mz_new_header)) {
-                    if (ferror(this->fd)) warn("Cannot read %s", this->fname);
-                    if (feof(this->fd)) warnx("Unexpected end of file: %s", this->fname);
-                } else {
-                    printf("Offset to next header:\t\t0x%08"PRIx32"\n", this->mzx->nextHeader);
-                    read_next_header(this);
-                }
-            }
-        } else
-            fprintf(stdout, "Not a DOS/MZ executable: %s\n", this->fname);
+    if (optind >= argc) display_help();
+    for (i = optind, k = 0; i < argc; i++)
+        if (!strcmp(argv[i], "-") && k++) errx(1, "Standard input can only be read once");
+#ifdef NEED_SETMODE
+    if (k) setmode(fileno(stdin), O_BINARY);
+#endif
+    /* Only hashes and checksums look at more than the tables, and a stream need not be read any further. */
+    if (opts.hash || opts.verify) opts.need |= NEED_FILE; else opts.need &= ~NEED_FILE;
+    if (extract) {
+        if (optind != argc - 1 || opts.recursive) errx(1, "--extract-resource takes a single file");
+        return extract_resource(argv[optind], &opts, extract);
     }
-    destroy_this(this);
-    return(0);
+    if (loadseg >= 0) {
+        if (optind != argc - 1 || opts.recursive) errx(1, "--load-image takes a single file");
+        return load_image(argv[optind], &opts, (uint16_t) loadseg);
+    }
+    if (unpacking) {
+        if (optind != argc - 1 || opts.recursive) errx(1, "--unpack takes a single file");
+        return unpack(argv[optind], &opts);
+    }
+    out.pretty = opts.format == FORMAT_JSON;
+    nthreads = opts.jobs ? opts.jobs : pool_default_threads();
+    if (graph >= 0) {
+        for (i = optind; i < argc; i++)
+            filelist_walk(&files, argv[i], opts.recursive);
+        start = now();
+        k = graph_run(files.names, files.count, nthreads, graph, stdout, &gc);
+        elapsed = now() - start;
+        fprintf(stderr, "Resolved %lu imports (%lu unresolved) over %lu edges between %lu modules in %.3f seconds\n",
+            gc.imports, gc.unresolved, gc.edges, gc.files, elapsed);
+        if (gc.missing) fprintf(stderr, "  %lu edges to modules no file provides\n", gc.missing);
+        if (gc.duplicates) fprintf(stderr, "  %lu files named after a module already seen\n", gc.duplicates);
+        if (gc.failed) fprintf(stderr, "  %lu files could not be read\n", gc.failed);
+        for (i = 0; i < files.count; i++) free(files.names[i]);
+        free(files.names);
+        free_fields(plan);
+        return k ? 1 : 0;
+    }
+    if (cachefile) {
+        /* A cached report would carry the statistics of the run that made it. */
+        if (opts.stats) errx(1, "--cache cannot be used with --stats");
+        if (!(opts.cache = cache_open(cachefile, cache_optkey(&opts), nthreads))) err(1, "Cannot allocate memory");
+    }
+
+    /* The plain old single file case. */
+    if (optind == argc - 1 && !opts.recursive) {
+        if ((k = scan_file(argv[optind], &opts, &out, NULL, 0)) >= 0) out_flush(&out, stdout);
+        if (opts.cache && cache_close(opts.cache)) warn("Cannot write %s", cachefile);
+        free(out.buf);
+        free_fields(plan);
+        return k < 0 ? 1 : 0;
+    }
+
+    for (i = optind; i < argc; i++)
+        filelist_walk(&files, argv[i], opts.recursive);
+    scan.opts = &opts;
+    scan.files = &files;
+    if (!(scan.workers = calloc(nthreads, sizeof(struct scan_worker)))) err(1, "Cannot allocate memory");
+    for (i = 0; i < nthreads; i++) scan.workers[i].out.pretty = out.pretty;
+    start = now();
+    pool_run(files.count, nthreads, scan_one, &scan);
+    elapsed = now() - start;
+
+    memset(&stats, 0, sizeof(stats));
+    for (i = 0; i < nthreads; i++) {
+        for (k = 0; k < EXE_KIND_COUNT; k++) counts[k] += scan.workers[i].counts[k];
+        failed += scan.workers[i].failed;
+        stats_add(&stats, &scan.workers[i].stats);
+        free(scan.workers[i].out.buf);
+    }
+    /* Keep machine readable output machine readable. */
+    summary = opts.format == FORMAT_TEXT ? stdout : stderr;
+    fprintf(summary, "Scanned %d files in %.3f seconds (%.1f files/sec)\n", files.count, elapsed, elapsed > 0 ? files.count / elapsed : 0.0);
+    for (k = EXE_MZ; k < EXE_KIND_COUNT; k++)
+        fprintf(summary, "  %-8s%lu\n", exe_kind_names[k], counts[k]);
+    fprintf(summary, "  %-8s%lu\n", exe_kind_names[EXE_UNKNOWN], counts[EXE_UNKNOWN]);
+    if (failed) fprintf(summary, "  %-8s%lu\n", "failed", failed);
+    if (opts.cache) {
+        cache_counts(opts.cache, &hits, &stored);
+        fprintf(summary, "  %-8s%lu (%lu added)\n", "cached", hits, stored);
+        if (cache_close(opts.cache)) warn("Cannot write %s", cachefile);
+    }
+    if (opts.stats) {
+        /* Times are summed over the workers, so they can add up to more than the wall clock. */
+        out.len = 0;
+        stats_table(&out, "Parser statistics, all files:", &stats);
+        out_flush(&out, summary);
+    }
+    free(out.buf);
+
+    for (i = 0; i < files.count; i++) free(files.names[i]);
+    free(files.names);
+    free(scan.workers);
+    free_fields(plan);
+    return(failed ? 1 : 0);
 }
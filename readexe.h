@@ -0,0 +1,470 @@
+/* readexe - Prints EXE info a la objdump/dumpbin/efd 
+ * readexe.h - libreadexe, the parsers behind readexe
+ * Copyright © 2019-2024 Kirn Gill II <segin2005@gmail.com>
+ * 
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE 
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY 
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER 
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING 
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Usage:
+ *
+ *     struct THIS *this;
+ *
+ *     if (!(this = init_this())) return EXE_ERR_NOMEM;
+ *     this->fname = "FOO.EXE";
+ *     if (!map_file(this)) {
+ *         read_exe(this);
+ *         ... look at this->ne, this->nemods, le_load(), pe_load() ...
+ *     }
+ *     destroy_this(this);
+ *
+ * Everything the parser builds comes out of a per-file arena, so
+ * destroy_this() is the only call needed to release it. Nothing is
+ * printed and nothing exits: problems are recorded in this->diags and
+ * the first one's code is kept in this->status. Tables that could not
+ * be read are left NULL with a count of zero.
+ */
+
+#ifndef READEXE_H
+#define READEXE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Big assumptions on little-endianiness here */
+
+#include "mz.h"
+#include "ne.h"
+#include "le.h"
+#include "w3.h"
+#include "pe.h"
+#include "hash.h"
+
+enum exe_kind {
+    EXE_UNKNOWN,
+    EXE_MZ,
+    EXE_NE,
+    EXE_LE,
+    EXE_LX,
+    EXE_W3,
+    EXE_PE,
+    EXE_W4,
+    EXE_KIND_COUNT
+};
+
+/* DOS packers mz_packer() recognises from the unpacker in front of the program */
+enum exe_mz_packer {
+    MZ_PACKER_NONE,
+    MZ_PACKER_EXEPACK,
+    MZ_PACKER_LZEXE090,
+    MZ_PACKER_LZEXE091,
+    MZ_PACKER_PKLITE,
+    MZ_PACKER_COUNT
+};
+
+enum exe_status {
+    EXE_OK,
+    EXE_ERR_OPEN,                           /* the file could not be read; errno says why */
+    EXE_ERR_NOMEM,
+    EXE_ERR_TRUNCATED,                      /* a header or table runs past the end of the file */
+    EXE_ERR_MALFORMED                       /* a header or table makes no sense */
+};
+
+/* One problem found while parsing */
+struct exe_diag {
+    struct exe_diag *next;
+    int code;                               /* EXE_ERR_* */
+    char msg[1];                            /* "Unexpected end of file: FOO.EXE" and the like */
+};
+
+struct arena_chunk;
+
+/* Bump allocator that hands out memory until it is freed all at once */
+struct arena {
+    struct arena_chunk *head;
+    unsigned long allocs;                   /* malloc() calls made for this file */
+};
+
+/*
+ * Parser phases that costs are charged to when this->stats is set. Each
+ * phase gets only what it does itself: time spent in a phase it calls is
+ * charged to that one.
+ */
+enum exe_phase {
+    EXE_PHASE_OTHER,                        /* setup, teardown and anything outside the phases below */
+    EXE_PHASE_MAP,                          /* map_file() and unmap_file() */
+    EXE_PHASE_MZ,
+    EXE_PHASE_MZ_RELOCS,
+    EXE_PHASE_NEXT,                         /* finding what the MZ header points at */
+    EXE_PHASE_NE,
+    EXE_PHASE_NE_SEGMENTS,
+    EXE_PHASE_NE_IMPORTS,                   /* module reference and imported names tables */
+    EXE_PHASE_NE_RELOCS,
+    EXE_PHASE_NE_RESOURCES,
+    EXE_PHASE_NE_EXPORTS,                   /* entry table and resident and non-resident names */
+    EXE_PHASE_LE,                           /* read_le_exe() and le_load() */
+    EXE_PHASE_LE_FIXUPS,
+    EXE_PHASE_W3,                           /* W3 and W4 headers, decompression and the VxDs inside */
+    EXE_PHASE_PE,                           /* read_pe_exe() and pe_load() */
+    EXE_PHASE_OUTPUT,                       /* for the caller's own use */
+    EXE_PHASE_COUNT
+};
+
+/*
+ * What a phase cost. The file is one mapped image, so the parser never
+ * seeks or reads as such: a "view" is one bounds-checked look at part of
+ * the image (what would otherwise have been a seek and a read) and bytes
+ * are what those views covered.
+ */
+struct exe_phase_stats {
+    unsigned long entered;
+    unsigned long views;
+    uint64_t bytes;
+    unsigned long allocs;
+    unsigned long syscalls;
+    uint64_t ns;
+};
+
+struct exe_stats {
+    struct exe_phase_stats phase[EXE_PHASE_COUNT];
+};
+
+/*
+ * Tables the parser reads only when something is going to look at them.
+ * By default everything is needed; readexe --fields asks for just what
+ * the selected fields use. LE and PE tables are loaded lazily by
+ * le_load() and pe_load() anyway, so they have no bits of their own.
+ */
+#define NEED_NEXT           0x01            /* the header the MZ header points at */
+#define NEED_MZ_RELOCS      0x02
+#define NEED_NE_NAMES       0x04            /* module reference and imported names tables */
+#define NEED_NE_SEGMENTS    0x08
+#define NEED_NE_RELOCS      0x10            /* implies NEED_NE_SEGMENTS */
+#define NEED_NE_RESOURCES   0x20
+#define NEED_NE_EXPORTS     0x40
+#define NEED_FILE           0x80            /* the data as well as the tables, for map_stream(): hashes, checksums, resources */
+#define NEED_MZ_PACKER      0x100           /* the unpacker at CS:0, for mz_packer() */
+#define NEED_ALL            (~0U)
+
+/*
+ * Imports are keyed as module << 17 | byname << 16 | ordinal or name
+ * offset, so that equal references sort together.
+ */
+#define NE_TOP_IMPORTS 5
+#define NE_IMPORT_KEY(module, byname, value) (((uint32_t) (module) << 17) | ((uint32_t) ((byname) != 0) << 16) | (value))
+#define NE_IMPORT_KEY_MODULE(key) ((uint16_t) ((key) >> 17))
+#define NE_IMPORT_KEY_BYNAME(key) ((int) ((key) >> 16) & 1)
+#define NE_IMPORT_KEY_VALUE(key) ((uint16_t) ((key) & 0xFFFF))
+#define NE_IMPORT_REF_MAX 528                 /* MODULE.NAME, both up to 255 characters */
+
+/* The relocation block that follows an NE segment's data */
+struct ne_segrelocs {
+    const struct exe_ne_reloc *relocs;      /* points into the file image */
+    uint16_t count;
+    unsigned long byType[4];                /* indexed by RELTYPE_* */
+    unsigned long additive;
+    unsigned long sites;                    /* locations patched, counting every link of each chain */
+    int present;                            /* the segment has a relocation block we could read */
+    uint32_t fileOffset;                    /* where the block starts */
+    uint32_t top[NE_TOP_IMPORTS];           /* most referenced imports, as NE_IMPORT_KEY()s */
+    unsigned long topcount[NE_TOP_IMPORTS];
+    int ntop;
+};
+
+/* An NE segment as ne_load_segments() builds it */
+struct ne_segimage {
+    uint8_t *data;
+    const uint8_t *src;                     /* the segment's data in the file, NULL if it has none or is cut short */
+    uint32_t srcSize;
+    uint32_t size;                          /* the data or the minimum allocation, whichever is larger */
+    uint32_t dataSize;                      /* bytes from the file, after expanding iterated data */
+    unsigned long applied;                  /* locations patched */
+    unsigned long unresolved;               /* relocations left alone: OS fixups and references to nothing */
+    int bad;                                /* iterated data or a relocation ran past the end */
+};
+
+/*
+ * An NE resource. Types and resources are each either a number or a name;
+ * names point into the file image and are not NUL-terminated.
+ */
+struct ne_resource {
+    uint16_t type;                          /* RESTYPE_* or another number, or 0 if typeName is set */
+    uint16_t id;                            /* or 0 if name is set */
+    const char *typeName;
+    const char *name;
+    uint8_t typeNameLen;
+    uint8_t nameLen;
+    uint16_t flags;                         /* NE_RES_* */
+    uint32_t fileOffset;                    /* already shifted by the alignment shift */
+    uint32_t size;
+};
+
+/* A resource type or name to look up: a number, or a name matched without regard to case */
+struct ne_reskey {
+    uint16_t id;                            /* 0 for a name */
+    const char *name;
+    size_t len;
+};
+
+/* An LE/LX object page map entry, whichever flavour it came from */
+struct le_page {
+    uint32_t fileOffset;
+    uint32_t size;                          /* bytes in the file */
+    uint16_t flags;                         /* LE_PAGE_* */
+};
+
+/* LE/LX tables that le_load() decodes on request */
+#define LE_HAVE_PAGES       0x01
+#define LE_HAVE_ENTRIES     0x02
+#define LE_HAVE_RESNAMES    0x04
+#define LE_HAVE_NONRESNAMES 0x08
+#define LE_HAVE_IMPORTS     0x10
+#define LE_HAVE_FIXUPS      0x20            /* le_load_fixups() only */
+#define LE_HAVE_IMAGE       0x40            /* le_expand_pages() only */
+
+/*
+ * LE/LX fixups, one per location patched (a record with a list of source
+ * offsets counts once for each), as parallel arrays indexed from 0 to
+ * count - 1 in page order.
+ */
+struct le_fixups {
+    uint32_t count;
+    uint32_t *pageStart;                    /* page i's (from 0) are pageStart[i] up to pageStart[i + 1] */
+    int16_t *source;                        /* offset of the location in its page; may be negative for one that spans pages */
+    uint8_t *sourceType;                    /* LE_FIXUP_* and flags, as stored */
+    uint8_t *targetFlags;                   /* LE_TARGET_* and flags, as stored */
+    uint16_t *target;                       /* object, module ordinal or entry ordinal */
+    uint32_t *value;                        /* offset in the object, imported ordinal or procedure name offset */
+    uint32_t *additive;
+};
+
+/* Files with at least this many pages have their fixups decoded on several threads */
+#define LE_FIXUP_PARALLEL   64
+
+/* ... and their pages expanded on several threads */
+#define LE_EXPAND_PARALLEL  16
+
+/* A PE section's place in the image and in the file */
+struct pe_secmap {
+    uint32_t rva;
+    uint32_t vsize;
+    uint32_t rawOffset;
+    uint32_t rawSize;
+};
+
+/* PE tables that pe_load() decodes on request */
+#define PE_HAVE_IMPORTS     0x01            /* both import and delay import directories */
+#define PE_HAVE_EXPORTS     0x02
+
+/* Content hashes of an NE segment, LE object or W3 module */
+#define HASH_XXH64          0x01
+#define HASH_SHA256         0x02
+
+struct exe_hash {
+    unsigned what;                          /* HASH_* computed */
+    uint32_t bytes;                         /* bytes of file data hashed */
+    uint64_t xxh64;
+    uint8_t sha256[SHA256_SIZE];
+};
+
+/* What a stored checksum turned out to be */
+enum exe_check {
+    EXE_CHECK_ABSENT,                       /* none was stored */
+    EXE_CHECK_VALID,
+    EXE_CHECK_INVALID                       /* wrong, or what it covers runs past the end of the file */
+};
+
+struct exe_checksum {
+    int status;                             /* EXE_CHECK_* */
+    uint32_t stored;
+    uint32_t computed;
+};
+
+/* Files at least this big have their LE/LX page checksums checked on several threads */
+#define LE_CHECKSUM_PARALLEL 0x100000
+
+struct options;
+struct outbuf;
+
+struct THIS {
+    const struct options *opts;             /* for the caller; the library never looks at these two */
+    struct outbuf *out;
+    struct arena arena;                     /* this and everything hanging off it */
+    long int noffset;                       /* offset to the next header, or -1 to read it from the MZ header */
+    unsigned need;                          /* NEED_* tables to read */
+    int status;                             /* first EXE_ERR_* recorded, or EXE_OK */
+    struct exe_diag *diags;                 /* every problem found, in order */
+    struct exe_diag **diagTail;
+    unsigned long syscalls;                 /* system calls made by map_file() and unmap_file() */
+    struct exe_stats *stats;                /* where to add up costs by phase, or NULL not to */
+    int phase;                              /* EXE_PHASE_* being charged */
+    uint64_t phaseStart;                    /* clock, allocs and syscalls when it was last charged */
+    unsigned long phaseAllocs;
+    unsigned long phaseSyscalls;
+    enum exe_kind kind;                     /* what we decided the file is */
+    const uint8_t *base;                    /* Whole file image, either mmap()'d or read into memory */
+    size_t size;                            /* Size of the file image in bytes */
+    int mapped;                             /* base came from mmap() rather than malloc() */
+    const char *fname;                      /* File name of the executable we're inspecting; must outlive this */
+    const struct exe_mz_header *mz;         /* DOS (MZ) header */
+    const struct exe_mz_new_header *mzx;    /* eXtended DOS (MZ) header */
+    uint32_t *mzrelocs;                     /* MZ relocations as linear addresses, sorted */
+    int mz_relocCount;                      /* number of entries in mzrelocs */
+    const struct exe_mz_reloc *mzreltab;    /* MZ relocation table, in file order */
+    unsigned long mz_relocDups;             /* relocations patching an address already patched */
+    unsigned long mz_relocOutside;          /* relocations patching outside the load module */
+    uint8_t *mzimage;                       /* the relocated load module, once mz_load_image() has built it */
+    uint32_t mz_imageSize;
+    uint8_t *mzunpacked;                    /* the program as it was before packing, once mz_unpack() has rebuilt it */
+    uint32_t mz_unpackedSize;
+    const char *nextMagic;                  /* signature of the header mzx points at */
+    struct exe_mz_new_header mzx_user;      /* backing store for mzx when the offset is given with -n */
+    const struct exe_ne_header *ne;         /* New Executable (NE) header */
+    const struct exe_ne_segment *nesegs;    /* NE segments */
+    int ne_importCount;                     /* number of entries in NE imported names table  */
+    struct exe_ne_import *neimps;           /* NE imported names, sorted by table offset */
+    int ne_moduleCount;                     /* number of module references in modules table */
+    struct exe_ne_module *nemods;           /* NE imported modules */
+    struct ne_segrelocs *nerelocs;          /* NE relocations, one block per segment */
+    struct ne_segimage *neimages;           /* loaded segments, once ne_load_segments() has built them */
+    struct ne_resource *neres;              /* NE resources, sorted by type and then name, for ne_find_resources() */
+    int ne_resourceCount;
+    uint16_t ne_resShift;                   /* resource alignment shift */
+    struct exe_ne_export *neexps;           /* NE entry table, indexed by ordinal - 1 */
+    int ne_exportCount;                     /* highest ordinal in the entry table */
+    struct exe_ne_name *nenames;            /* NE resident then non-resident names, less the first of each */
+    int ne_nameCount;
+    uint32_t *ne_nameHash;                  /* index of nenames by name: open addressed, index + 1 or 0 if empty */
+    uint32_t ne_nameHashMask;
+    struct exe_ne_name ne_moduleName;       /* first resident name; size 0 if there is none */
+    struct exe_ne_name ne_description;      /* first non-resident name; likewise */
+    const struct exe_le_header *le;         /* Linear Executable (LE/LX) header */
+    uint32_t le_offset;                     /* file offset of the LE/LX header */
+    const uint8_t *leldr;                   /* LE header, loader and fixup sections */
+    uint32_t le_ldrSize;                    /* bytes at leldr */
+    const struct exe_le_object *leobjs;     /* LE object table */
+    int le_objectCount;
+    unsigned le_done;                       /* LE_HAVE_* tables decoded so far */
+    struct le_page *lepages;                /* LE object page map */
+    int le_pageCount;
+    struct exe_le_entry *leents;            /* LE entry table, one per ordinal in use */
+    int le_entryCount;
+    struct exe_le_name *leresnames;         /* LE resident names */
+    int le_resnameCount;
+    struct exe_le_name *lenonresnames;      /* LE non-resident names */
+    int le_nonresnameCount;
+    struct exe_le_name *leimpmods;          /* LE imported modules */
+    int le_impmodCount;
+    struct exe_le_name *leimpprocs;         /* LE imported procedure names, sorted by table offset */
+    int le_impprocCount;
+    struct le_fixups lefix;                 /* LE/LX fixups, once le_load_fixups() has run */
+    uint8_t *leimage;                       /* every page expanded to pageSize bytes, once le_expand_pages() has run */
+    struct exe_checksum *lesums;            /* LE/LX page checksums, once le_page_checksums() has run */
+    int le_sumStatus;                       /* EXE_CHECK_* over all pages */
+    const struct exe_w3_header *w3;         /* W3 header; for W4, in wximage once w3_load_modules() has run */
+    int wx_modcount;                        /* W3/W4 LE module count */
+    const struct exe_w3_modentry *w3mods;   /* W3 module table */
+    const struct exe_w4_header *w4;         /* W4 header */
+    const uint32_t *w4chunks;               /* W4 chunk offsets */
+    int w4_chunkCount;
+    const uint8_t *wximage;                 /* the W3 image module offsets count from: the file, or the decompressed W4 */
+    size_t wx_imageSize;
+    int wx_loaded;                          /* w3_load_modules() has run */
+    struct THIS **wxles;                    /* each module parsed as an LE file of its own, or NULL if it is not one */
+    const struct THIS *container;           /* the W3/W4 file this VxD was found in, or NULL; base belongs to it */
+    const struct exe_pe_header *pe;         /* Portable Executable (PE) COFF header */
+    const struct exe_pe_optional32 *pe32;   /* PE32 optional header, or */
+    const struct exe_pe_optional64 *pe64;   /* PE32+ optional header */
+    const struct exe_pe_datadir *pedirs;    /* PE data directories */
+    int pe_dirCount;
+    const struct exe_pe_section *pesecs;    /* PE section table */
+    int pe_sectionCount;
+    struct pe_secmap *pesecmap;             /* PE sections sorted by RVA, for pe_rva_offset() */
+    uint32_t pe_sizeOfHeaders;
+    unsigned pe_done;                       /* PE_HAVE_* tables decoded so far */
+    struct exe_pe_module *pemods;           /* PE imported modules, delay loaded ones last */
+    int pe_moduleCount;
+    struct exe_pe_import *peimps;           /* PE imported functions, grouped by module */
+    int pe_importCount;
+    const struct exe_pe_export_dir *peexpdir; /* PE export directory */
+    const char *pe_expName;                 /* module name from the export directory */
+    uint32_t pe_expNameLen;
+    struct exe_pe_export *peexps;           /* PE exports, by ordinal */
+    int pe_exportCount;
+};
+
+struct THIS *init_this(void);
+void destroy_this(struct THIS *this);
+int map_file(struct THIS *this);
+int map_stream(struct THIS *this, FILE *fp);
+void unmap_file(struct THIS *this);
+int read_exe(struct THIS *this);
+void *arena_alloc(struct arena *arena, size_t size);
+void *arena_calloc(struct arena *arena, size_t count, size_t size);
+void arena_free(struct arena *arena);
+const void *view_at(struct THIS *this, uint32_t offset, size_t len);
+int exe_phase(struct THIS *this, int phase);
+extern const char *const exe_phase_names[EXE_PHASE_COUNT];
+extern const char *const mz_packer_names[MZ_PACKER_COUNT];
+
+void read_mz_exe(struct THIS *this);
+void read_mz_reloc(struct THIS *this);
+uint32_t mz_image_size(struct THIS *this);
+const uint8_t *mz_load_image(struct THIS *this, uint16_t seg, uint32_t *size);
+int mz_packer(struct THIS *this, uint16_t *version);
+const uint8_t *mz_unpack(struct THIS *this, uint32_t *size);
+void read_next_header(struct THIS *this);
+void read_ne_exe(struct THIS *this);
+void read_ne_segments(struct THIS *this);
+void read_ne_names(struct THIS *this);
+void read_ne_relocs(struct THIS *this);
+uint32_t ne_segment_offset(struct THIS *this, int i);
+uint32_t ne_segment_size(struct THIS *this, int i);
+const char *ne_import_ref(struct THIS *this, uint16_t module, int byname, uint16_t value, char *buf);
+const struct exe_ne_import *get_ne_import(struct THIS *this, uint16_t offset);
+void read_ne_resources(struct THIS *this);
+void read_ne_exports(struct THIS *this);
+const struct exe_ne_export *ne_export(struct THIS *this, uint16_t ordinal);
+const struct exe_ne_name *ne_export_name(struct THIS *this, const char *name, size_t len);
+const char *ne_resource_type_name(uint16_t type);
+int ne_resource_key(const char *spec, size_t len, struct ne_reskey *key);
+const struct ne_resource *ne_find_resources(struct THIS *this, const struct ne_reskey *type, const struct ne_reskey *name, int *count);
+const void *ne_resource_data(struct THIS *this, const struct ne_resource *res);
+void read_le_exe(struct THIS *this);
+const void *le_at(struct THIS *this, uint32_t offset, size_t len);
+int le_load(struct THIS *this, unsigned what);
+const struct exe_le_name *le_import_proc(struct THIS *this, uint32_t offset);
+uint32_t le_page_object(struct THIS *this, uint32_t page);
+int le_load_fixups(struct THIS *this, int nthreads);
+int le_expand_pages(struct THIS *this, int nthreads);
+void read_w3_exe(struct THIS *this);
+void read_w4_exe(struct THIS *this);
+int w3_load_modules(struct THIS *this, int nthreads);
+void read_pe_exe(struct THIS *this);
+uint32_t pe_rva_offset(struct THIS *this, uint32_t rva, uint32_t *avail);
+const void *pe_at(struct THIS *this, uint32_t rva, size_t len);
+const char *pe_string(struct THIS *this, uint32_t rva, uint32_t *len);
+int pe_load(struct THIS *this, unsigned what);
+int ne_segment_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash);
+int le_object_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash);
+int le_image_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash);
+int w3_module_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash);
+int mz_image_hash(struct THIS *this, int seg, unsigned what, struct exe_hash *hash);
+int ne_load_segments(struct THIS *this, int nthreads);
+int ne_image_hash(struct THIS *this, int i, unsigned what, struct exe_hash *hash);
+int mz_checksum(struct THIS *this, struct exe_checksum *sum);
+int ne_checksum(struct THIS *this, struct exe_checksum *sum);
+int le_page_checksums(struct THIS *this, int nthreads);
+
+#endif /* READEXE_H */
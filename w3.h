@@ -37,4 +37,20 @@ struct exe_w3_modentry {
     uint32_t    size;
 };
 
+/*
+ * W4 is the compressed form of W3 that Windows 95 ships VMM32.VXD in. The
+ * W3 image from the W4 header onwards is cut into chunks of chunkSize
+ * bytes, each compressed on its own with the DoubleSpace ("DS") scheme,
+ * and a table of chunkCount file offsets, one per chunk, follows the
+ * header. A chunk whose compressed size is the chunk size is stored.
+ */
+struct exe_w4_header {
+    char        magic[2];
+    uint16_t    vmm_version;
+    uint16_t    chunkSize;
+    uint16_t    chunkCount;
+    char        dsMagic[2];                 /* "DS" */
+    char        _unknown2[6];
+};
+
 #endif /* W3_H */